@@ -80,6 +80,12 @@ static void SetupBenchArgs() {
                   "default: %d). Currently only affects the CCheckQueue_RealBlock_32MB* benches.",
                   DEFAULT_SCRIPTCHECK_THREADS),
         ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg(
+        "-parworkstealing",
+        strprintf("Run the script verification threads in work-stealing mode (default: %d). Currently only affects "
+                  "the CCheckQueue_RealBlock_32MB* benches.",
+                  DEFAULT_SCRIPTCHECK_WORK_STEALING),
+        ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
 }
 
 int main(int argc, char **argv) {
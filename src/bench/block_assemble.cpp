@@ -3,12 +3,16 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <arith_uint256.h>
 #include <bench/bench.h>
 #include <config.h>
 #include <consensus/validation.h>
+#include <miner.h>
 #include <script/standard.h>
+#include <test/setup_common.h>
 #include <test/util.h>
 #include <txmempool.h>
+#include <util/defer.h>
 #include <validation.h>
 
 #include <vector>
@@ -56,3 +60,60 @@ static void AssembleBlock(benchmark::State &state) {
 }
 
 BENCHMARK(AssembleBlock, 700);
+
+/**
+ * Assemble a block from a mempool of chains of unconfirmed transactions, each
+ * paying more than its parent, which only half fit in the block.
+ */
+static void AssembleBlockDeepChains(benchmark::State &state, bool packageSelection) {
+    const Config &config = GetConfig();
+    const CScript SCRIPT_PUB = CScript() << OP_TRUE;
+    // Pads the transactions to the minimum size
+    const CScript SCRIPT_SIG = CScript() << std::vector<uint8_t>(100, 0xff);
+
+    constexpr size_t NUM_CHAINS{100};
+    constexpr size_t CHAIN_LENGTH{100};
+
+    const Defer d([] { WITH_LOCK(g_mempool.cs, g_mempool.clear()); });
+
+    uint64_t nTotalSize = 0;
+    {
+        LOCK2(::cs_main, g_mempool.cs);
+        TestMemPoolEntryHelper entry;
+        for (size_t c = 0; c < NUM_CHAINS; ++c) {
+            // The chains spend made-up coins: the block is not checked.
+            COutPoint prevout(TxId(ArithToUint256(arith_uint256(c + 1))), 0);
+            for (size_t i = 0; i < CHAIN_LENGTH; ++i) {
+                CMutableTransaction tx;
+                tx.vin.emplace_back(prevout, SCRIPT_SIG);
+                tx.vout.emplace_back(COIN, SCRIPT_PUB);
+                const CTransactionRef rtx = MakeTransactionRef(tx);
+                g_mempool.addUnchecked(entry.Fee(int64_t(100 * (i + 1) + c) * SATOSHI).FromTx(rtx));
+                nTotalSize += rtx->GetTotalSize();
+                prevout = COutPoint(rtx->GetId(), 0);
+            }
+        }
+    }
+
+    BlockAssembler::Options options;
+    options.blockMinFeeRate = CFeeRate(Amount::zero());
+    options.nMaxGeneratedBlockSize = 1000 + nTotalSize / 2;
+    options.fPackageSelection = packageSelection;
+    BlockAssembler assembler(config, g_mempool, options);
+    assert(assembler.CreateNewBlock(SCRIPT_PUB, 0., false)->block.vtx.size() > NUM_CHAINS * CHAIN_LENGTH / 4);
+
+    BENCHMARK_LOOP {
+        assembler.CreateNewBlock(SCRIPT_PUB, 0. /* timeLimitSecs */, false /* checkValidity */);
+    }
+}
+
+static void AssembleBlockDeepChains_Feerate(benchmark::State &state) {
+    AssembleBlockDeepChains(state, false);
+}
+
+static void AssembleBlockDeepChains_Package(benchmark::State &state) {
+    AssembleBlockDeepChains(state, true);
+}
+
+BENCHMARK(AssembleBlockDeepChains_Feerate, 10);
+BENCHMARK(AssembleBlockDeepChains_Package, 10);
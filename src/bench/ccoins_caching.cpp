@@ -8,8 +8,10 @@
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
 #include <policy/policy.h>
+#include <random.h>
 #include <wallet/crypter.h>
 
+#include <unordered_map>
 #include <vector>
 
 // FIXME: Dedup with SetupDummyInputs in test/transaction_tests.cpp.
@@ -129,5 +131,112 @@ static void CheckTxInputs(benchmark::State &state) {
     }
 }
 
+static constexpr size_t N_CACHED_COINS = 100000;
+
+static std::vector<COutPoint> MakeOutPoints(size_t n) {
+    FastRandomContext rng(true);
+    std::vector<COutPoint> outpoints;
+    outpoints.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        outpoints.emplace_back(TxId(rng.rand256()), rng.randrange(4));
+    }
+    return outpoints;
+}
+
+static Coin MakeCoin() {
+    CScript script;
+    script << OP_DUP << OP_HASH160 << std::vector<uint8_t>(20, 0)
+           << OP_EQUALVERIFY << OP_CHECKSIG;
+    return Coin(CTxOut(1 * COIN, script), 1, false);
+}
+
+/** A CCoinsView which accepts anything written to it, like a database. */
+class CCoinsViewSink : public CCoinsView {
+public:
+    bool BatchWrite(CCoinsMap &mapCoins, const BlockHash &) override {
+        mapCoins.clear();
+        return true;
+    }
+};
+
+// Adding new coins to the UTXO cache, as when connecting blocks.
+static void CCoinsCacheInsert(benchmark::State &state) {
+    const std::vector<COutPoint> outpoints = MakeOutPoints(N_CACHED_COINS);
+    const Coin coin = MakeCoin();
+    CCoinsView coinsDummy;
+    BENCHMARK_LOOP {
+        CCoinsViewCache coins(&coinsDummy);
+        for (const COutPoint &outpoint : outpoints) {
+            coins.AddCoin(outpoint, coin, false);
+        }
+        assert(coins.GetCacheSize() == N_CACHED_COINS);
+    }
+}
+
+// Looking up coins in a large UTXO cache, about half of which are misses.
+static void CCoinsCacheLookup(benchmark::State &state) {
+    const std::vector<COutPoint> outpoints = MakeOutPoints(2 * N_CACHED_COINS);
+    const Coin coin = MakeCoin();
+    CCoinsView coinsDummy;
+    CCoinsViewCache coins(&coinsDummy);
+    for (size_t i = 0; i < N_CACHED_COINS; ++i) {
+        coins.AddCoin(outpoints[2 * i], coin, false);
+    }
+    BENCHMARK_LOOP {
+        size_t nFound = 0;
+        for (const COutPoint &outpoint : outpoints) {
+            nFound += coins.HaveCoinInCache(outpoint);
+        }
+        assert(nFound == N_CACHED_COINS);
+    }
+}
+
+// Filling the UTXO cache and flushing it to its backing view.
+static void CCoinsCacheFlush(benchmark::State &state) {
+    const std::vector<COutPoint> outpoints = MakeOutPoints(N_CACHED_COINS);
+    const Coin coin = MakeCoin();
+    CCoinsViewSink sink;
+    CCoinsViewCache coins(&sink);
+    coins.SetBestBlock(BlockHash(uint256S("01")));
+    BENCHMARK_LOOP {
+        for (const COutPoint &outpoint : outpoints) {
+            coins.AddCoin(outpoint, coin, false);
+        }
+        bool success = coins.Flush();
+        assert(success);
+    }
+}
+
+// The same inserts and erases on the bare CCoinsMap, and on the same map with
+// the standard allocator, to compare the cost of the node allocations.
+template <typename Map> static void CoinsMapInsertErase(benchmark::State &state, Map &map) {
+    const std::vector<COutPoint> outpoints = MakeOutPoints(N_CACHED_COINS);
+    const Coin coin = MakeCoin();
+    BENCHMARK_LOOP {
+        for (const COutPoint &outpoint : outpoints) {
+            map.emplace(outpoint, CCoinsCacheEntry(coin));
+        }
+        for (auto it = map.begin(); it != map.end();) {
+            it = map.erase(it);
+        }
+    }
+}
+
+static void CoinsMapPoolAllocator(benchmark::State &state) {
+    CCoinsMapMemoryResource resource;
+    CCoinsMap map{0, CCoinsMap::hasher{}, CCoinsMap::key_equal{}, &resource};
+    CoinsMapInsertErase(state, map);
+}
+
+static void CoinsMapStdAllocator(benchmark::State &state) {
+    std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> map;
+    CoinsMapInsertErase(state, map);
+}
+
 BENCHMARK(CCoinsCaching, 170 * 1000);
+BENCHMARK(CCoinsCacheInsert, 10);
+BENCHMARK(CCoinsCacheLookup, 10);
+BENCHMARK(CCoinsCacheFlush, 10);
+BENCHMARK(CoinsMapPoolAllocator, 10);
+BENCHMARK(CoinsMapStdAllocator, 10);
 BENCHMARK(CheckTxInputs, 1000);
@@ -6,6 +6,7 @@
 #include <bench/bench.h>
 #include <bench/data.h>
 #include <checkqueue.h>
+#include <hash.h>
 #include <logging.h>
 #include <policy/policy.h>
 #include <prevector.h>
@@ -61,6 +62,75 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State &state) {
     queue.StopWorkerThreads();
 }
 
+// This Benchmark measures the throughput of the CheckQueue with a fixed number
+// of worker threads, in either the shared queue or the work-stealing mode. The
+// checks are added a few at a time, like validation.cpp does per transaction,
+// and each of them does a little bit of hashing to stand in for a signature
+// check.
+static void CCheckQueueThroughput(benchmark::State &state, int nThreads,
+                                  bool work_stealing) {
+    static constexpr size_t TXS = 20000;
+    static constexpr size_t HASH_ROUNDS = 16;
+
+    struct HashJob {
+        uint256 hash;
+        HashJob() {}
+        explicit HashJob(FastRandomContext &insecure_rand)
+            : hash(insecure_rand.rand256()) {}
+        bool operator()() {
+            for (size_t i = 0; i < HASH_ROUNDS; ++i) {
+                hash = Hash(hash);
+            }
+            return true;
+        }
+    };
+    CCheckQueue<HashJob> queue{QUEUE_BATCH_SIZE};
+    // Account for the master thread, which also processes checks in Wait()
+    queue.StartWorkerThreads(nThreads - 1, work_stealing);
+    Defer d([&queue] { queue.StopWorkerThreads(); });
+    BENCHMARK_LOOP {
+        // Make insecure_rand here so that each iteration is identical.
+        FastRandomContext insecure_rand(true);
+        CCheckQueueControl<HashJob> control(&queue);
+        std::vector<HashJob> vChecks;
+        for (size_t tx = 0; tx < TXS; ++tx) {
+            vChecks.clear();
+            const size_t nInputs = 1 + insecure_rand.randrange(3);
+            for (size_t x = 0; x < nInputs; ++x) {
+                vChecks.emplace_back(insecure_rand);
+            }
+            control.Add(vChecks);
+        }
+        bool result = control.Wait();
+        assert(result);
+    }
+}
+
+static void CCheckQueueThroughput_8Threads(benchmark::State &state) {
+    CCheckQueueThroughput(state, 8, false);
+}
+static void CCheckQueueThroughput_16Threads(benchmark::State &state) {
+    CCheckQueueThroughput(state, 16, false);
+}
+static void CCheckQueueThroughput_32Threads(benchmark::State &state) {
+    CCheckQueueThroughput(state, 32, false);
+}
+static void CCheckQueueThroughput_64Threads(benchmark::State &state) {
+    CCheckQueueThroughput(state, 64, false);
+}
+static void CCheckQueueThroughput_WorkStealing_8Threads(benchmark::State &state) {
+    CCheckQueueThroughput(state, 8, true);
+}
+static void CCheckQueueThroughput_WorkStealing_16Threads(benchmark::State &state) {
+    CCheckQueueThroughput(state, 16, true);
+}
+static void CCheckQueueThroughput_WorkStealing_32Threads(benchmark::State &state) {
+    CCheckQueueThroughput(state, 32, true);
+}
+static void CCheckQueueThroughput_WorkStealing_64Threads(benchmark::State &state) {
+    CCheckQueueThroughput(state, 64, true);
+}
+
 static void CCheckQueue_RealData32MB(bool cacheSigs, benchmark::State &state) {
     // This 32MB block has 166943 non-coinbase txins
     const CBlock block = []{
@@ -116,13 +186,15 @@ static void CCheckQueue_RealData32MB(bool cacheSigs, benchmark::State &state) {
 
     // Step 3: Setup threads for our CCheckQueue
     CCheckQueue<CScriptCheck> queue{QUEUE_BATCH_SIZE};
+    const bool work_stealing = gArgs.GetBoolArg("-parworkstealing", DEFAULT_SCRIPTCHECK_WORK_STEALING);
     int nThreads = gArgs.GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
     const int nCores = std::max(GetNumCores(), 1);
     if (!nThreads) nThreads = nCores;
     else if (nThreads < 0) nThreads = std::max(1, nCores + nThreads); // negative means leave n cores free
-    LogPrintf("%s: Using %d thread%s for signature verification\n", __func__, nThreads, nThreads != 1 ? "s" : "");
+    LogPrintf("%s: Using %d thread%s for signature verification%s\n", __func__, nThreads, nThreads != 1 ? "s" : "",
+              work_stealing ? " (work stealing)" : "");
     --nThreads; // account for the fact that this main thread also does processing in .Wait() below
-    queue.StartWorkerThreads(nThreads);
+    queue.StartWorkerThreads(nThreads, work_stealing);
     Defer d([&queue]{
         queue.StopWorkerThreads();
     });
@@ -162,5 +234,13 @@ static void CCheckQueue_RealBlock_32MB_WithCacheStore(benchmark::State &state) {
 }
 
 BENCHMARK(CCheckQueueSpeedPrevectorJob, 1400);
+BENCHMARK(CCheckQueueThroughput_8Threads, 10);
+BENCHMARK(CCheckQueueThroughput_16Threads, 10);
+BENCHMARK(CCheckQueueThroughput_32Threads, 10);
+BENCHMARK(CCheckQueueThroughput_64Threads, 10);
+BENCHMARK(CCheckQueueThroughput_WorkStealing_8Threads, 10);
+BENCHMARK(CCheckQueueThroughput_WorkStealing_16Threads, 10);
+BENCHMARK(CCheckQueueThroughput_WorkStealing_32Threads, 10);
+BENCHMARK(CCheckQueueThroughput_WorkStealing_64Threads, 10);
 BENCHMARK(CCheckQueue_RealBlock_32MB_NoCacheStore, 5);
 BENCHMARK(CCheckQueue_RealBlock_32MB_WithCacheStore, 5);
@@ -0,0 +1,144 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <coins.h>
+#include <config.h>
+#include <consensus/validation.h>
+#include <key.h>
+#include <primitives/transaction.h>
+#include <script/script.h>
+#include <script/sighashtype.h>
+#include <script/standard.h>
+#include <test/setup_common.h>
+#include <test/util.h>
+#include <txmempool.h>
+#include <validation.h>
+
+#include <cassert>
+#include <vector>
+
+/// This file contains benchmarks flooding AcceptToMemoryPool with independent
+/// signed transactions, as relayed by peers.
+
+static const CScript REDEEM_SCRIPT = CScript() << OP_DROP << OP_TRUE;
+
+static const CScript SCRIPT_PUB_KEY =
+    GetScriptForDestination(ScriptID(REDEEM_SCRIPT, false /* p2sh_20 */));
+
+static const CScript SCRIPT_SIG = CScript() << std::vector<uint8_t>(100, 0xff)
+                                            << ToByteVector(REDEEM_SCRIPT);
+
+/// Number of transactions accepted per iteration, each spending its own coin
+static constexpr size_t BATCH_SIZE = 10'000;
+
+/// Mine a block with a transaction splitting a coinbase into BATCH_SIZE coins
+/// paying to `key`
+static std::vector<CTxOut> createCoins(const Config &config, const CKey &key,
+                                       std::vector<COutPoint> &outpoints) {
+    const CTxIn coinbase = MineBlock(config, SCRIPT_PUB_KEY);
+    for (int i = 0; i < COINBASE_MATURITY; ++i) {
+        MineBlock(config, SCRIPT_PUB_KEY);
+    }
+
+    const Amount value = WITH_LOCK(
+        cs_main,
+        return pcoinsTip->AccessCoin(coinbase.prevout).GetTxOut().nValue);
+    CMutableTransaction fanout;
+    fanout.vin.emplace_back(coinbase.prevout, SCRIPT_SIG);
+    const CTxOut txout(value / int64_t(BATCH_SIZE + 1),
+                       GetScriptForDestination(key.GetPubKey().GetID()));
+    fanout.vout.assign(BATCH_SIZE, txout);
+    const CTransactionRef tx = MakeTransactionRef(fanout);
+
+    // The fanout is too big to be standard, add it directly.
+    TestMemPoolEntryHelper entry;
+    entry.nFee = value - tx->GetValueOut();
+    entry.spendsCoinbase = true;
+    {
+        LOCK2(cs_main, g_mempool.cs);
+        g_mempool.addUnchecked(entry.FromTx(tx));
+    }
+    MineBlock(config, SCRIPT_PUB_KEY);
+    assert(g_mempool.size() == 0);
+
+    outpoints.clear();
+    for (uint32_t i = 0; i < BATCH_SIZE; ++i) {
+        outpoints.emplace_back(tx->GetId(), i);
+    }
+    return fanout.vout;
+}
+
+/// Sign a batch of BATCH_SIZE transactions spending the coins, made distinct
+/// from the other batches by their fee
+static std::vector<CTransactionRef>
+signBatch(const CKey &key, const std::vector<COutPoint> &outpoints,
+          const std::vector<CTxOut> &coins, const Amount fee) {
+    std::vector<CTransactionRef> batch;
+    batch.reserve(outpoints.size());
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        CMutableTransaction mtx;
+        mtx.vin.emplace_back(outpoints[i]);
+        mtx.vout.emplace_back(coins[i].nValue - fee, coins[i].scriptPubKey);
+        std::vector<uint8_t> vchSig;
+        const uint256 hash = SignatureHash(
+            coins[i].scriptPubKey, ScriptExecutionContext{0, coins[i], mtx},
+            SigHashType().withFork(), nullptr, STANDARD_SCRIPT_VERIFY_FLAGS);
+        bool ok = key.SignECDSA(hash, vchSig);
+        assert(ok);
+        vchSig.push_back(uint8_t(SIGHASH_ALL | SIGHASH_FORKID));
+        mtx.vin[0].scriptSig = CScript()
+                               << vchSig << ToByteVector(key.GetPubKey());
+        batch.push_back(MakeTransactionRef(mtx));
+    }
+    return batch;
+}
+
+/// Accept a batch of BATCH_SIZE transactions per iteration, 1M transactions
+/// for 100 iterations. If `precheck` is set, the scripts of each batch are
+/// checked in parallel first, as for the transactions queued from a peer.
+static void benchMempoolAccept(benchmark::State &state, bool precheck) {
+    const Config &config = GetConfig();
+    CKey key;
+    key.MakeNewKey(true);
+    std::vector<COutPoint> outpoints;
+    const std::vector<CTxOut> coins = createCoins(config, key, outpoints);
+
+    // The batches must be different for their scripts not to be cached.
+    std::vector<std::vector<CTransactionRef>> batches;
+    batches.reserve(state.m_num_iters);
+    for (uint64_t i = 0; i < state.m_num_iters; ++i) {
+        batches.push_back(signBatch(key, outpoints, coins,
+                                    int64_t(1000 + i) * SATOSHI));
+    }
+
+    auto batch = batches.begin();
+    BENCHMARK_LOOP {
+        if (precheck) {
+            PrecheckTransactionsForMempool(config, g_mempool, *batch);
+        }
+        LOCK(cs_main);
+        for (const CTransactionRef &tx : *batch) {
+            CValidationState vstate;
+            bool ok = AcceptToMemoryPool(config, g_mempool, vstate, tx,
+                                         nullptr /* pfMissingInputs */,
+                                         false /* bypass_limits */,
+                                         Amount::zero() /* nAbsurdFee */);
+            assert(ok);
+        }
+        g_mempool.clear();
+        ++batch;
+    }
+}
+
+static void MempoolAcceptFlood(benchmark::State &state) {
+    benchMempoolAccept(state, false);
+}
+
+static void MempoolAcceptFloodPrecheck(benchmark::State &state) {
+    benchMempoolAccept(state, true);
+}
+
+BENCHMARK(MempoolAcceptFlood, 100);
+BENCHMARK(MempoolAcceptFloodPrecheck, 100);
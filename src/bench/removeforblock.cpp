@@ -124,11 +124,16 @@ static void benchRemoveForBlock(const Config& config, benchmark::State& state,
 
     LogPrint(BCLog::MEMPOOL, "(%s 3) mempool size: %i\n",  __func__, g_mempool.size());
 
+    // Blocks larger than the configured maximum are still assembled, without
+    // checking their validity, as only their transactions matter here.
+    const bool oversized = blockMB * ONE_MEGABYTE > config.GetConfiguredMaxBlockSize();
     BlockAssembler::Options opts;
     opts.blockMinFeeRate = CFeeRate{Amount::zero()};
-    opts.nConsensusCurrentBlockSizeLimit = config.GetConfiguredMaxBlockSize();
+    opts.nConsensusCurrentBlockSizeLimit = oversized ? (blockMB + 1) * ONE_MEGABYTE
+                                                     : config.GetConfiguredMaxBlockSize();
     opts.nMaxGeneratedBlockSize = blockMB * ONE_MEGABYTE;
-    const auto pblktemplate = BlockAssembler{config, ::g_mempool, opts}.CreateNewBlock(SCRIPT_PUB_KEY);
+    const auto pblktemplate = BlockAssembler{config, ::g_mempool, opts}.CreateNewBlock(
+        SCRIPT_PUB_KEY, 0. /* timeLimitSecs */, !oversized /* checkValidity */);
     const auto &block = pblktemplate->block;
 
     std::list<CTxMemPool> pools;
@@ -157,6 +162,18 @@ static void benchRemoveForBlock(const Config& config, benchmark::State& state,
     }
 }
 
+/// Fill a mempool with 900k txs, then repeatedly test removeForBlock with a 128MB block of ~680k small-sized txs
+static void RemoveForBlock128MB(benchmark::State& state) {
+    const Config& config = GetConfig();
+    benchRemoveForBlock(config, state, 900'000, 128, false);
+}
+
+/// Fill a mempool with 450k txs, then repeatedly test removeForBlock with a 64MB block of ~340k small-sized txs
+static void RemoveForBlock64MB(benchmark::State& state) {
+    const Config& config = GetConfig();
+    benchRemoveForBlock(config, state, 450'000, 64, false);
+}
+
 /// Fill a mempool with 450k txs, then repeatedly test removeForBlock with a 32MB block of ~170k small-sized txs
 static void RemoveForBlock32MB(benchmark::State& state) {
     const Config& config = GetConfig();
@@ -169,6 +186,13 @@ static void RemoveForBlock8MB(benchmark::State& state) {
     benchRemoveForBlock(config, state, 450'000, 8, false);
 }
 
+/// Fill a mempool with ~900k txs, then repeatedly test removeForBlock with a 128MB block of mixed-sized txs,
+/// leaving some unconfirmed chains in mempool too so that the parentSet for some txs is larger
+static void RemoveForBlock128MB_UnconfChains(benchmark::State& state) {
+    const Config& config = GetConfig();
+    benchRemoveForBlock(config, state, 900'000, 128, true);
+}
+
 /// Fill a mempool with ~450k txs, then repeatedly test removeForBlock with a 32MB block of ~93k mixed-sized txs,
 /// leaving some unconfirmed chains in mempool too so that the parentSet for some txs is larger
 static void RemoveForBlock32MB_UnconfChains(benchmark::State& state) {
@@ -183,7 +207,10 @@ static void RemoveForBlock8MB_UnconfChains(benchmark::State& state) {
     benchRemoveForBlock(config, state, 450'000, 8, true);
 }
 
+BENCHMARK(RemoveForBlock128MB, 1);
+BENCHMARK(RemoveForBlock64MB, 1);
 BENCHMARK(RemoveForBlock32MB, 1);
 BENCHMARK(RemoveForBlock8MB, 1);
+BENCHMARK(RemoveForBlock128MB_UnconfChains, 1);
 BENCHMARK(RemoveForBlock32MB_UnconfChains, 1);
 BENCHMARK(RemoveForBlock8MB_UnconfChains, 1);
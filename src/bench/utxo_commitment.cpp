@@ -0,0 +1,85 @@
+// Copyright (c) 2026 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bench/data.h>
+#include <checkqueue.h>
+#include <coins.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <streams.h>
+#include <undo.h>
+#include <util/defer.h>
+#include <util/system.h>
+#include <utxo_commitment.h>
+#include <version.h>
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <map>
+#include <vector>
+
+/// This file contains benchmarks of updating the UTXO commitment of a block
+/// (see -utxocommitment), which hashes each coin the block creates or spends.
+
+static void UTXOCommitmentConnectBlock(benchmark::State &state,
+                                       bool fParallel) {
+    CBlock block;
+    VectorReader(SER_NETWORK, PROTOCOL_VERSION,
+                 benchmark::data::Get_block413567(), 0) >>
+        block;
+    std::map<COutPoint, Coin> coinsMap;
+    VectorReader(SER_NETWORK, PROTOCOL_VERSION,
+                 benchmark::data::Get_coins_spent_413567(), 0) >>
+        coinsMap;
+    CBlockUndo blockundo;
+    for (const auto &ptx : block.vtx) {
+        if (ptx->IsCoinBase()) {
+            continue;
+        }
+        CTxUndo &txundo = blockundo.vtxundo.emplace_back();
+        for (const CTxIn &txin : ptx->vin) {
+            txundo.vprevout.push_back(coinsMap.at(txin.prevout));
+        }
+    }
+
+    // As ConnectBlock runs the tasks, on the queue it farms out its other
+    // work to.
+    CCheckQueue<std::function<bool()>> queue{16};
+    queue.StartWorkerThreads(std::max(2, GetNumCores()) - 1);
+    Defer d([&queue] { queue.StopWorkerThreads(); });
+    UTXOCommitmentTaskRunner runTasks;
+    if (fParallel) {
+        runTasks = [&queue](std::vector<std::function<void()>> &tasks) {
+            std::vector<std::function<bool()>> vChecks;
+            for (std::function<void()> &task : tasks) {
+                vChecks.emplace_back([&task] {
+                    task();
+                    return true;
+                });
+            }
+            CCheckQueueControl<std::function<bool()>> control(&queue);
+            control.Add(vChecks);
+            control.Wait();
+        };
+    }
+
+    const UTXOCommitment prev;
+    BENCHMARK_LOOP {
+        const UTXOCommitment commitment = ConnectBlockToUTXOCommitment(
+            prev, block, blockundo, 413567, {}, runTasks);
+        assert(commitment.multiset != prev.multiset);
+    }
+}
+
+static void UTXOCommitmentConnectBlock_Serial(benchmark::State &state) {
+    UTXOCommitmentConnectBlock(state, false);
+}
+static void UTXOCommitmentConnectBlock_Parallel(benchmark::State &state) {
+    UTXOCommitmentConnectBlock(state, true);
+}
+
+BENCHMARK(UTXOCommitmentConnectBlock_Serial, 5);
+BENCHMARK(UTXOCommitmentConnectBlock_Parallel, 5);
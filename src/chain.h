@@ -18,8 +18,10 @@
 #include <sync.h>
 #include <tinyformat.h>
 #include <uint256.h>
+#include <utxo_commitment.h>
 
 #include <ios>
+#include <memory>
 #include <string_view>
 #include <type_traits>
 #include <unordered_map>
@@ -166,6 +168,10 @@ public:
     //! (memory only) Maximum nTime in the chain up to and including this block.
     unsigned int nTimeMax = 0;
 
+    //! Commitment to the UTXO set after connecting this block, if known (see
+    //! -utxocommitment). Guarded by cs_main.
+    std::shared_ptr<const UTXOCommitment> utxoCommitment;
+
     explicit CBlockIndex() = default;
 
     explicit CBlockIndex(const CBlockHeader &block) : CBlockIndex() {
@@ -389,6 +395,21 @@ public:
                 ablaStateOpt.reset();
             }
             SER_READ(obj, obj.SetAblaStateOpt(ablaStateOpt));
+
+            // UTXO commitment -- missing if not known, or if written by an older version
+            std::optional<UTXOCommitment> utxoCommitmentOpt;
+            SER_WRITE(obj, if (obj.utxoCommitment) utxoCommitmentOpt = *obj.utxoCommitment);
+            try {
+                READWRITE(utxoCommitmentOpt);
+            } catch (const std::ios_base::failure &e) {
+                if (!ser_action.ForRead() || std::string_view{e.what()}.find("end of data") == std::string_view::npos) {
+                    throw;
+                }
+                utxoCommitmentOpt.reset();
+            }
+            SER_READ(obj, obj.utxoCommitment = utxoCommitmentOpt
+                                                   ? std::make_shared<const UTXOCommitment>(*utxoCommitmentOpt)
+                                                   : nullptr);
         } else {
             // old serialized data, indicate missing data.
             SER_READ(obj, obj.SetAblaStateOpt(std::nullopt));
@@ -1152,6 +1152,12 @@ public:
                                        "36012afca590b1a11466e2206")},
             }};
 
+        // The chain of 110 blocks mined by feature_assumeutxo.py
+        m_assumeutxo_data = {
+            {110, {uint256S("dc7c025ca749acd6dabb28a3c6ffa5703204946bb030119c"
+                            "13e0c91f12848b69")}},
+        };
+
         chainTxData = ChainTxData{0, 0, 0};
 
         base58Prefixes[PUBKEY_ADDRESS] = std::vector<uint8_t>(1, 111);
@@ -12,6 +12,7 @@
 #include <protocol.h>
 
 #include <array>
+#include <map>
 #include <memory>
 #include <type_traits>
 #include <vector>
@@ -62,6 +63,17 @@ struct ChainTxData {
     double dTxRate;
 };
 
+/**
+ * Holds the expected hash of the UTXO set at a given height, which a UTXO
+ * snapshot made at that height must match to be loaded (see loadtxoutset).
+ */
+struct AssumeutxoData {
+    //! The ECMultiSet hash of the coins of the UTXO set (see ApplyCoinHash in utxo_commitment.h)
+    uint256 hash_serialized;
+};
+
+typedef std::map<int, const AssumeutxoData> MapAssumeutxo;
+
 /**
  * CChainParams defines various tweakable parameters of a given instance of the
  * Bitcoin system. There are three: the main network on which people trade goods
@@ -116,6 +128,11 @@ public:
     const std::vector<SeedSpec6> &FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData &Checkpoints() const { return checkpointData; }
     const ChainTxData &TxData() const { return chainTxData; }
+    //! Get the assumed hash of the UTXO set at the given height, if any
+    const AssumeutxoData *AssumeutxoForHeight(int height) const {
+        const auto it = m_assumeutxo_data.find(height);
+        return it != m_assumeutxo_data.end() ? &it->second : nullptr;
+    }
 
 protected:
     CChainParams() {}
@@ -138,6 +155,7 @@ protected:
     bool m_is_test_chain;
     CCheckpointData checkpointData;
     ChainTxData chainTxData;
+    MapAssumeutxo m_assumeutxo_data;
 };
 
 /**
@@ -10,6 +10,11 @@
 #include <util/threadnames.h>
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -25,6 +30,12 @@ template <typename T> class CCheckQueueControl;
  * queue, where they are processed by N-1 worker threads. When the master is
  * done adding work, it temporarily joins the worker pool as an N'th worker,
  * until all jobs are done.
+ *
+ * Optionally (see StartWorkerThreads) the queue runs in work-stealing mode:
+ * every worker, and the master, owns a deque of checks. Add() spreads the
+ * checks round-robin over the deques, workers drain their own deque and steal
+ * from the other ones once it runs dry. Each deque has its own mutex, so that
+ * the workers no longer contend on a single lock for every batch.
  */
 template <typename T> class CCheckQueue {
 private:
@@ -60,9 +71,164 @@ private:
     //! The maximum number of elements to be processed in one batch
     const unsigned int nBatchSize;
 
+    //! Prefix of the worker thread names
+    const std::string m_thread_name;
+
+    /**
+     * If set, called by a thread after it ran a batch of checks, with whether
+     * they all succeeded. Its result replaces that of the batch, which lets
+     * the checks defer part of their work to the end of the batch.
+     */
+    const std::function<bool(bool)> m_batch_finisher;
+
     std::vector<std::thread> m_worker_threads;
     bool m_request_stop GUARDED_BY(m_mutex){false};
 
+    //! Whether the worker threads run in work-stealing mode
+    bool m_work_stealing{false};
+
+    //! Checks owned by a single thread, which other threads may steal from
+    struct WorkerDeque {
+        Mutex mutex;
+        std::deque<T> checks GUARDED_BY(mutex);
+    };
+
+    //! Per-thread deques in work-stealing mode, the master uses index 0
+    std::vector<std::unique_ptr<WorkerDeque>> m_deques;
+
+    //! Number of checks sitting in one of the deques (work-stealing mode)
+    std::atomic<unsigned int> m_queued{0};
+
+    //! Number of checks not completed yet (work-stealing mode)
+    std::atomic<unsigned int> m_todo{0};
+
+    //! Number of worker threads waiting for work (work-stealing mode)
+    std::atomic<int> m_idle{0};
+
+    //! The temporary evaluation result (work-stealing mode)
+    std::atomic<bool> m_all_ok{true};
+
+    //! Deque the next batch added by the master goes to
+    size_t m_next_deque{0};
+
+    /**
+     * Move a batch of checks from one of the deques into vChecks, looking at
+     * the thread's own deque first. Returns false if all deques are empty.
+     */
+    bool TakeWork(size_t idx, std::vector<T> &vChecks) {
+        const size_t nDeques = m_deques.size();
+        for (size_t i = 0; i < nDeques; ++i) {
+            WorkerDeque &wd = *m_deques[(idx + i) % nDeques];
+            LOCK(wd.mutex);
+            const size_t nSize = wd.checks.size();
+            if (nSize == 0) {
+                continue;
+            }
+            // Take at most half of what is left so that other threads can
+            // keep stealing from this deque, but never more than nBatchSize.
+            const size_t nNow =
+                std::max<size_t>(1, std::min<size_t>(nBatchSize, nSize / 2));
+            for (size_t n = 0; n < nNow; ++n) {
+                if (i == 0) {
+                    // Own deque: take the most recently added checks
+                    vChecks.push_back(std::move(wd.checks.back()));
+                    wd.checks.pop_back();
+                } else {
+                    // Stealing: take the oldest checks
+                    vChecks.push_back(std::move(wd.checks.front()));
+                    wd.checks.pop_front();
+                }
+            }
+            m_queued -= nNow;
+            return true;
+        }
+        return false;
+    }
+
+    /** Work-stealing counterpart of Loop(). */
+    bool LoopWorkStealing(size_t idx, bool fMaster) {
+        std::vector<T> vChecks;
+        vChecks.reserve(nBatchSize);
+        while (true) {
+            if (TakeWork(idx, vChecks)) {
+                bool fOk = m_all_ok;
+                for (T &check : vChecks) {
+                    if (fOk) {
+                        fOk = check();
+                    }
+                }
+                if (m_batch_finisher) {
+                    fOk = m_batch_finisher(fOk);
+                }
+                const unsigned int nNow = vChecks.size();
+                // Destroy the checks before they are accounted as done
+                vChecks.clear();
+                if (!fOk) {
+                    m_all_ok = false;
+                }
+                if (m_todo.fetch_sub(nNow) == nNow && !fMaster) {
+                    // We processed the last element; inform the master it
+                    // can exit and return the result
+                    LOCK(m_mutex);
+                    m_master_cv.notify_one();
+                }
+                continue;
+            }
+
+            WAIT_LOCK(m_mutex, lock);
+            if (fMaster) {
+                // Only the master adds work, so nothing is left to take:
+                // wait for the workers to finish their batches.
+                while (m_todo > 0) {
+                    m_master_cv.wait(lock);
+                }
+                // return the current status and reset it for new work later
+                return m_all_ok.exchange(true);
+            }
+            if (m_request_stop) {
+                return false;
+            }
+            ++m_idle;
+            if (m_queued == 0) {
+                m_worker_cv.wait(lock);
+            }
+            --m_idle;
+            if (m_request_stop) {
+                return false;
+            }
+        }
+    }
+
+    //! Add checks in work-stealing mode
+    void AddWorkStealing(std::vector<T> &vChecks) {
+        if (vChecks.empty()) {
+            return;
+        }
+        m_todo += vChecks.size();
+        for (size_t nDone = 0; nDone < vChecks.size();) {
+            const size_t nNow =
+                std::min<size_t>(nBatchSize, vChecks.size() - nDone);
+            WorkerDeque &wd = *m_deques[m_next_deque];
+            m_next_deque = (m_next_deque + 1) % m_deques.size();
+            LOCK(wd.mutex);
+            for (size_t n = 0; n < nNow; ++n) {
+                wd.checks.push_back(std::move(vChecks[nDone + n]));
+            }
+            m_queued += nNow;
+            nDone += nNow;
+        }
+        // Idle workers check m_queued under m_mutex before waiting, so taking
+        // the lock here guarantees the notification is not lost.
+        if (m_idle > 0) {
+            LOCK(m_mutex);
+            if (vChecks.size() == 1) {
+                m_worker_cv.notify_one();
+            } else {
+                m_worker_cv.notify_all();
+            }
+        }
+    }
+
     /** Internal function that does bulk of the verification work. */
     bool Loop(bool fMaster) {
         std::condition_variable& cond = fMaster ? m_master_cv : m_worker_cv;
@@ -132,6 +298,9 @@ private:
                     fOk = check();
                 }
             }
+            if (m_batch_finisher) {
+                fOk = m_batch_finisher(fOk);
+            }
             vChecks.clear();
         } while (true);
     }
@@ -141,11 +310,18 @@ public:
     Mutex m_control_mutex;
 
     //! Create a new check queue
-    explicit CCheckQueue(unsigned int nBatchSizeIn)
-        : nBatchSize(nBatchSizeIn) {}
+    explicit CCheckQueue(unsigned int nBatchSizeIn,
+                         std::string thread_name = "scriptch",
+                         std::function<bool(bool)> batch_finisher = {})
+        : nBatchSize(nBatchSizeIn), m_thread_name(std::move(thread_name)),
+          m_batch_finisher(std::move(batch_finisher)) {}
 
-    //! Create a pool of new worker threads.
-    void StartWorkerThreads(const int threads_num)
+    /**
+     * Create a pool of new worker threads. If work_stealing is set, each
+     * thread gets its own deque of checks and steals from the others when it
+     * runs out of work, instead of sharing a single queue.
+     */
+    void StartWorkerThreads(const int threads_num, bool work_stealing = false)
     {
         {
              LOCK(m_mutex);
@@ -154,20 +330,46 @@ public:
              fAllOk = true;
          }
          assert(m_worker_threads.empty());
+         m_work_stealing = work_stealing;
+         m_deques.clear();
+         if (m_work_stealing) {
+             // One deque per worker thread, plus one for the master
+             for (int n = 0; n <= threads_num; ++n) {
+                 m_deques.push_back(std::make_unique<WorkerDeque>());
+             }
+             m_queued = 0;
+             m_todo = 0;
+             m_idle = 0;
+             m_all_ok = true;
+             m_next_deque = 0;
+         }
          for (int n = 0; n < threads_num; ++n) {
              m_worker_threads.emplace_back([this, n]() {
-                 util::ThreadRename(strprintf("scriptch.%i", n));
-                 Loop(false /* worker thread */);
+                 util::ThreadRename(strprintf("%s.%i", m_thread_name, n));
+                 if (m_work_stealing) {
+                     LoopWorkStealing(n + 1, false /* worker thread */);
+                 } else {
+                     Loop(false /* worker thread */);
+                 }
              });
          }
     }
 
     //! Wait until execution finishes, and return whether all evaluations were
     //! successful.
-    bool Wait() { return Loop(true /* master thread */); }
+    bool Wait() {
+        if (m_work_stealing) {
+            return LoopWorkStealing(0, true /* master thread */);
+        }
+        return Loop(true /* master thread */);
+    }
 
     //! Add a batch of checks to the queue
     void Add(std::vector<T> &vChecks) {
+        if (m_work_stealing) {
+            AddWorkStealing(vChecks);
+            return;
+        }
         LOCK(m_mutex);
         for (T &check : vChecks) {
             queue.push_back(std::move(check));
@@ -190,6 +392,8 @@ public:
         }
         m_worker_threads.clear();
         WITH_LOCK(m_mutex, m_request_stop = false);
+        m_work_stealing = false;
+        m_deques.clear();
     }
 
     ~CCheckQueue() { assert(m_worker_threads.empty()); }
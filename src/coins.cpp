@@ -60,7 +60,10 @@ size_t CCoinsViewBacked::EstimateSize() const {
 }
 
 CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn)
-    : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
+    : CCoinsViewBacked(baseIn),
+      cacheCoins(0, SaltedOutpointHasher(), CCoinsMap::key_equal(),
+                 &m_cache_coins_memory_resource),
+      cachedCoinsUsage(0) {}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
     return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
@@ -180,6 +183,48 @@ bool CCoinsViewCache::HaveCoinInCache(const COutPoint &outpoint) const {
     return (it != cacheCoins.end() && !it->second.coin.IsSpent());
 }
 
+const Coin *CCoinsViewCache::PeekCoinInCache(const COutPoint &outpoint) const {
+    CCoinsMap::const_iterator it = cacheCoins.find(outpoint);
+    return it != cacheCoins.end() ? &it->second.coin : nullptr;
+}
+
+void CCoinsViewCache::EmplaceFetchedCoin(const COutPoint &outpoint, Coin coin) {
+    assert(!coin.IsSpent());
+    CCoinsMap::iterator it;
+    bool inserted;
+    std::tie(it, inserted) =
+        cacheCoins.emplace(std::piecewise_construct,
+                           std::forward_as_tuple(outpoint),
+                           std::forward_as_tuple(std::move(coin)));
+    if (inserted) {
+        cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
+    }
+}
+
+bool CCoinsViewCache::TakeDirtyCoins(
+    std::vector<std::pair<COutPoint, Coin>> &coins, size_t &cursor,
+    size_t maxCoins, size_t maxScan) {
+    const size_t nBuckets = cacheCoins.bucket_count();
+    const size_t nTaken = coins.size();
+    size_t nScanned = 0;
+    for (; cursor < nBuckets; ++cursor) {
+        if (coins.size() - nTaken >= maxCoins || nScanned >= maxScan) {
+            return false;
+        }
+        ++nScanned;
+        for (auto it = cacheCoins.begin(cursor); it != cacheCoins.end(cursor);
+             ++it) {
+            ++nScanned;
+            if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+                coins.emplace_back(it->first, it->second.coin);
+                it->second.flags = 0;
+            }
+        }
+    }
+    cursor = 0;
+    return true;
+}
+
 BlockHash CCoinsViewCache::GetBestBlock() const {
     if (hashBlock.IsNull()) {
         hashBlock = base->GetBestBlock();
@@ -259,6 +304,7 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins,
 bool CCoinsViewCache::Flush() {
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
     cacheCoins.clear();
+    ReallocateCache();
     cachedCoinsUsage = 0;
     return fOk;
 }
@@ -275,6 +321,17 @@ unsigned int CCoinsViewCache::GetCacheSize() const {
     return cacheCoins.size();
 }
 
+void CCoinsViewCache::ReallocateCache() {
+    // Cache should be empty when we're calling this.
+    assert(cacheCoins.size() == 0);
+    cacheCoins.~CCoinsMap();
+    m_cache_coins_memory_resource.~CCoinsMapMemoryResource();
+    ::new (&m_cache_coins_memory_resource) CCoinsMapMemoryResource{};
+    ::new (&cacheCoins)
+        CCoinsMap{0, SaltedOutpointHasher(), CCoinsMap::key_equal(),
+                  &m_cache_coins_memory_resource};
+}
+
 const CTxOut &CCoinsViewCache::GetOutputFor(const CTxIn &input) const {
     const Coin &coin = AccessCoin(input.prevout);
     assert(!coin.IsSpent());
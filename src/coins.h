@@ -11,11 +11,15 @@
 #include <memusage.h>
 #include <primitives/blockhash.h>
 #include <serialize.h>
+#include <support/allocators/pool.h>
 #include <util/saltedhashers.h>
 
 #include <cassert>
 #include <cstdint>
+#include <functional>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 /**
  * A UTXO entry.
@@ -91,8 +95,23 @@ struct CCoinsCacheEntry {
         : coin(std::move(coinIn)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher>
-    CCoinsMap;
+/**
+ * PoolAllocator's MAX_BLOCK_SIZE_BYTES parameter here uses sizeof the data,
+ * and adds the size of 4 pointers. We do not know the exact node size used in
+ * the std::unordered_node implementation because it is implementation
+ * defined. Most implementations have an overhead of 1 or 2 pointers, so
+ * nodes can be connected in a linked list, and in some cases the hash value
+ * is stored as well. Using an additional sizeof(void*)*4 for
+ * MAX_BLOCK_SIZE_BYTES should thus be sufficient so that all implementations
+ * can allocate the nodes from the PoolAllocator.
+ */
+using CCoinsMap = std::unordered_map<
+    COutPoint, CCoinsCacheEntry, SaltedOutpointHasher, std::equal_to<COutPoint>,
+    PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>,
+                  sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) +
+                      sizeof(void *) * 4>>;
+
+using CCoinsMapMemoryResource = CCoinsMap::allocator_type::ResourceType;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor {
@@ -163,6 +182,7 @@ public:
     BlockHash GetBestBlock() const override;
     std::vector<BlockHash> GetHeadBlocks() const override;
     void SetBackend(CCoinsView &viewIn);
+    CCoinsView *GetBackend() const { return base; }
     bool BatchWrite(CCoinsMap &mapCoins, const BlockHash &hashBlock) override;
     CCoinsViewCursor *Cursor(bool snapshot = false) const override;
     size_t EstimateSize() const override;
@@ -178,6 +198,8 @@ protected:
      * declared as "const".
      */
     mutable BlockHash hashBlock;
+    /* The memory resource must outlive cacheCoins, which allocates from it. */
+    mutable CCoinsMapMemoryResource m_cache_coins_memory_resource{};
     mutable CCoinsMap cacheCoins;
 
     /* Cached dynamic memory usage for the inner Coin objects. */
@@ -210,6 +232,41 @@ public:
      */
     bool HaveCoinInCache(const COutPoint &outpoint) const;
 
+    /**
+     * Return a pointer to the cached Coin for the given outpoint, or nullptr
+     * if this cache holds no entry for it. The returned Coin may be spent,
+     * which means the outpoint is known to be spent in this view.
+     *
+     * No calls to the backing CCoinsView are made and the cache is not
+     * modified, so concurrent calls are safe as long as no other thread is
+     * modifying this cache.
+     */
+    const Coin *PeekCoinInCache(const COutPoint &outpoint) const;
+
+    /**
+     * Insert a coin that was read from the backing view by other means (e.g.
+     * from the database by a prefetching thread), exactly as FetchCoin would
+     * have. Nothing happens if the cache already holds an entry for the
+     * outpoint. The caller is responsible for `coin` being the current state
+     * of the backing view.
+     */
+    void EmplaceFetchedCoin(const COutPoint &outpoint, Coin coin);
+
+    /**
+     * Append copies of dirty entries to `coins` and mark these entries as
+     * neither dirty nor fresh, as if they had been written to the backing
+     * view, which is up to the caller. The entries stay in the cache.
+     *
+     * The scan starts at bucket `cursor` of the map and stops once `maxCoins`
+     * dirty entries were taken or `maxScan` buckets and entries were looked
+     * at, leaving `cursor` where the next call should resume. Returns true if
+     * the scan went past the last bucket, in which case `cursor` is reset to
+     * 0. The cursor is only a hint: it remains valid if the map is modified
+     * in between calls, but the next scan may then skip or revisit entries.
+     */
+    bool TakeDirtyCoins(std::vector<std::pair<COutPoint, Coin>> &coins,
+                        size_t &cursor, size_t maxCoins, size_t maxScan);
+
     /**
      * Return a reference to Coin in the cache, or a pruned one if not found.
      * This is more efficient than GetCoin.
@@ -272,6 +329,16 @@ public:
 
     const CTxOut &GetOutputFor(const CTxIn &input) const;
 
+    /**
+     * Force a reallocation of the cache map. This is required when downsizing
+     * the cache because the map's allocator may be hanging onto a lot of
+     * memory despite having called .clear().
+     *
+     * See:
+     * https://stackoverflow.com/questions/42114044/how-to-release-unordered-map-memory
+     */
+    void ReallocateCache();
+
 private:
     CCoinsMap::iterator FetchCoin(const COutPoint &outpoint) const;
 };
@@ -101,11 +101,15 @@ static void SetMaxOpenFiles(leveldb::Options *options) {
              options->max_open_files, default_open_files);
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize) {
+static leveldb::Options GetOptions(size_t nCacheSize, const DBTuning &tuning) {
     leveldb::Options options;
     options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
     // up to two write buffers may be held in memory simultaneously
-    options.write_buffer_size = nCacheSize / 4;
+    options.write_buffer_size =
+        tuning.write_buffer_size ? tuning.write_buffer_size : nCacheSize / 4;
+    if (tuning.max_file_size) {
+        options.max_file_size = tuning.max_file_size;
+    }
     options.filter_policy = leveldb::NewBloomFilterPolicy(10);
     options.compression = leveldb::kNoCompression;
     options.info_log = new CBitcoinLevelDBLogger();
@@ -120,14 +124,14 @@ static leveldb::Options GetOptions(size_t nCacheSize) {
 }
 
 CDBWrapper::CDBWrapper(const fs::path &path, size_t nCacheSize, bool fMemory,
-                       bool fWipe, bool obfuscate)
+                       bool fWipe, bool obfuscate, const DBTuning &tuning)
     : m_name(fs::basename(path)) {
     penv = nullptr;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, tuning);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -144,11 +148,12 @@ CDBWrapper::CDBWrapper(const fs::path &path, size_t nCacheSize, bool fMemory,
     leveldb::Status status = leveldb::DB::Open(options, path.string(), &pdb);
     dbwrapper_private::HandleError(status);
     LogPrintf("Opened LevelDB successfully\n");
+    LogPrint(BCLog::LEVELDB,
+             "LevelDB %s using write_buffer_size=%u max_file_size=%u\n",
+             m_name, options.write_buffer_size, options.max_file_size);
 
     if (gArgs.GetBoolArg("-forcecompactdb", false)) {
-        LogPrintf("Starting database compaction of %s\n", path.string());
-        pdb->CompactRange(nullptr, nullptr);
-        LogPrintf("Finished database compaction of %s\n", path.string());
+        CompactFull();
     }
 
     // The base-case obfuscation key, which is a noop.
@@ -186,6 +191,12 @@ CDBWrapper::~CDBWrapper() {
     options.env = nullptr;
 }
 
+void CDBWrapper::CompactFull() const {
+    LogPrintf("Starting database compaction of %s\n", m_name);
+    pdb->CompactRange(nullptr, nullptr);
+    LogPrintf("Finished database compaction of %s\n", m_name);
+}
+
 bool CDBWrapper::WriteBatch(CDBBatch &batch, bool fSync) {
     const bool log_memory = LogAcceptCategory(BCLog::LEVELDB);
     double mem_before = 0;
@@ -30,6 +30,20 @@ public:
 
 class CDBWrapper;
 
+/**
+ * Tuning of the LevelDB instance of a CDBWrapper, for the settings which
+ * depend on how the database is written to. Zero keeps the default.
+ */
+struct DBTuning {
+    //! Bytes of writes buffered in memory before being written out as a new
+    //! sorted file, which compactions then merge into the lower levels
+    //! (default: a quarter of the cache size)
+    size_t write_buffer_size = 0;
+    //! Bytes written to a sorted file before moving on to a new one (default:
+    //! 2 MiB). Larger files mean fewer, longer compactions.
+    size_t max_file_size = 0;
+};
+
 /**
  * These should be considered an implementation detail of the specific database.
  */
@@ -224,9 +238,11 @@ public:
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If
      * false, XOR
      *                        with a zero'd byte array.
+     * @param[in] tuning      LevelDB settings overriding the defaults.
      */
     CDBWrapper(const fs::path &path, size_t nCacheSize, bool fMemory = false,
-               bool fWipe = false, bool obfuscate = false);
+               bool fWipe = false, bool obfuscate = false,
+               const DBTuning &tuning = {});
     ~CDBWrapper();
 
     CDBWrapper(const CDBWrapper &) = delete;
@@ -348,4 +364,10 @@ public:
         leveldb::Slice slKey2(ssKey2.data(), ssKey2.size());
         pdb->CompactRange(&slKey1, &slKey2);
     }
+
+    /**
+     * Compact the whole database, merging its files into the lowest level
+     * they can go to.
+     */
+    void CompactFull() const;
 };
@@ -36,6 +36,7 @@
 #include <net_permissions.h>
 #include <net_processing.h>
 #include <netbase.h>
+#include <node/blockfilemap.h>
 #include <node/blockstorage.h>
 #include <policy/mempool.h>
 #include <policy/policy.h>
@@ -257,6 +258,7 @@ void Shutdown(NodeContext &node) {
     }
 
     StopScriptCheckWorkerThreads();
+    StopCoinsFlushThread();
 
     // After the threads that potentially access these pointers have been
     // stopped, destruct and reset all to nullptr.
@@ -430,6 +432,22 @@ void SetupServerArgs() {
     gArgs.AddArg("-indexdir=<dir>",
                  "Specify directory to hold leveldb files (default: <datadir>)",
                  ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blockfilemmap=<n>",
+                 strprintf("Number of block files kept memory-mapped to read "
+                           "blocks from, such as those served to peers, "
+                           "without copying them through stdio (0 to read "
+                           "them with stdio, default: %u)",
+                           DEFAULT_MAPPED_BLOCK_FILES),
+                 ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blockindexdbfilesize=<n>",
+                 "Size in megabytes of the files of the block index database "
+                 "(default: 2)",
+                 ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blockindexdbwritebuffer=<n>",
+                 "Megabytes of writes to the block index database buffered in "
+                 "memory before being written to disk (default: a quarter of "
+                 "its cache)",
+                 ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocknotify=<cmd>",
                  "Execute command when the best block changes (%s in cmd is "
                  "replaced by block hash)",
@@ -444,6 +462,15 @@ void SetupServerArgs() {
                            "not affected. (default: %d)",
                            DEFAULT_BLOCKSONLY),
                  ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-chainstatedbfilesize=<n>",
+                 "Size in megabytes of the files of the coins database. Larger "
+                 "files mean fewer, longer compactions (default: 2)",
+                 ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-chainstatedbwritebuffer=<n>",
+                 "Megabytes of writes to the coins database buffered in memory "
+                 "before being written to disk (default: a quarter of its "
+                 "cache)",
+                 ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-conf=<file>",
                  strprintf("Specify configuration file. Relative paths will be "
                            "prefixed by datadir location. (default: %s)",
@@ -568,6 +595,14 @@ void SetupServerArgs() {
                            "parked (default: %d)",
                            DEFAULT_PARK_DEEP_REORG),
                  ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-parworkstealing",
+                 strprintf("Give each script verification thread its own "
+                           "queue of checks and let idle threads steal work "
+                           "from the others, instead of sharing a single "
+                           "queue. Reduces lock contention with many threads "
+                           "(default: %d)",
+                           DEFAULT_SCRIPTCHECK_WORK_STEALING),
+                 ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-persistmempool",
                  strprintf("Whether to save the mempool on shutdown and load "
                            "on restart (default: %u)",
@@ -600,6 +635,12 @@ void SetupServerArgs() {
         "-reindex",
         "Rebuild chain state and block index from the blk*.dat files on disk",
         ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-schnorrbatchverify",
+                 strprintf("Verify the Schnorr signatures of a block in "
+                           "batches on the script verification threads, "
+                           "rather than one at a time (default: %d)",
+                           DEFAULT_SCHNORR_BATCH_VERIFY),
+                 ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #ifndef WIN32
     gArgs.AddArg(
         "-sysperms",
@@ -614,6 +655,34 @@ void SetupServerArgs() {
                            "getrawtransaction rpc call (default: %d)",
                            DEFAULT_TXINDEX),
                  ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-utxoprefetch",
+                 strprintf("Read the coins spent by a block from the UTXO "
+                           "database in parallel (using -par threads) before "
+                           "connecting it (default: %d)",
+                           DEFAULT_UTXO_PREFETCH),
+                 ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-txprecheck",
+                 strprintf("Check the scripts of the transactions queued from "
+                           "a peer in parallel (using -par threads) before "
+                           "accepting them to the mempool one by one "
+                           "(default: %d)",
+                           DEFAULT_TX_PRECHECK),
+                 ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-utxobackgroundflush",
+                 strprintf("Continuously write the modified coins of the UTXO "
+                           "cache to the UTXO database in small chunks from a "
+                           "background thread, instead of periodically "
+                           "writing all of them at once (default: %d)",
+                           DEFAULT_UTXO_BACKGROUND_FLUSH),
+                 ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-utxocommitment",
+                 strprintf("Maintain a commitment to the UTXO set (its "
+                           "ECMultiSet hash and statistics) for every block "
+                           "connected, so that gettxoutsetinfo \"ecmultiset\" "
+                           "does not have to walk the UTXO database "
+                           "(default: %d)",
+                           DEFAULT_UTXO_COMMITMENT),
+                 ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg(
         "-usecashaddr",
         strprintf("Use CashAddr address format for destination encoding "
@@ -1128,7 +1197,20 @@ void SetupServerArgs() {
                            "on individual gbt calls by specifying the \"checkvalidity\": boolean key in the "
                            "template_request object given to gbt. (default: %d)", DEFAULT_GBT_CHECK_VALIDITY),
                  ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
+    gArgs.AddArg("-gbtincremental",
+                 strprintf("Set whether getblocktemplate and getblocktemplatelight update the block template they "
+                           "last made with the transactions added to and removed from the mempool since, rather than "
+                           "making a new one from the whole mempool every few seconds. A new one is still made for "
+                           "each new block, and from time to time when the block is full. (default: %d)",
+                           DEFAULT_GBT_INCREMENTAL),
+                 ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
 
+    gArgs.AddArg("-blockpackageselection",
+                 strprintf("Select the transactions of new blocks by the fee each pays together with its unconfirmed "
+                           "ancestors, per the room they take in the block given both its size and sigchecks limits, "
+                           "rather than by the feerate of each on its own. (default: %d)",
+                           DEFAULT_BLOCK_PACKAGE_SELECTION),
+                 ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
     gArgs.AddArg("-blockmintxfee=<amt>",
                  strprintf("Set lowest fee rate (in %s/kB) for transactions to "
                            "be included in block creation. (default: %s)",
@@ -1676,8 +1758,18 @@ bool AppInitParameterInteraction(Config &config) {
     fCheckBlockIndex = gArgs.GetBoolArg("-checkblockindex",
                                         chainparams.DefaultConsistencyChecks());
     fCheckBlockReads = gArgs.GetBoolArg("-checkblockreads", chainparams.DefaultConsistencyChecks());
+    SetMaxMappedBlockFiles(std::max<int64_t>(
+        gArgs.GetArg("-blockfilemmap", DEFAULT_MAPPED_BLOCK_FILES), 0));
     fCheckpointsEnabled =
         gArgs.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+    fUtxoPrefetch = gArgs.GetBoolArg("-utxoprefetch", DEFAULT_UTXO_PREFETCH);
+    fTxPrecheck = gArgs.GetBoolArg("-txprecheck", DEFAULT_TX_PRECHECK);
+    fSchnorrBatchVerify =
+        gArgs.GetBoolArg("-schnorrbatchverify", DEFAULT_SCHNORR_BATCH_VERIFY);
+    fUtxoBackgroundFlush =
+        gArgs.GetBoolArg("-utxobackgroundflush", DEFAULT_UTXO_BACKGROUND_FLUSH);
+    fUtxoCommitment =
+        gArgs.GetBoolArg("-utxocommitment", DEFAULT_UTXO_COMMITMENT);
     if (fCheckpointsEnabled) {
         LogPrintf("Checkpoints will be verified.\n");
     } else {
@@ -2092,9 +2184,12 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
         script_threads = std::min(script_threads, LEGACY_MAX_ADDITIONAL_SCRIPTCHECK_THREADS);
     }
 
-    LogPrintf("Script verification uses %d additional threads\n", script_threads);
+    const bool script_work_stealing = gArgs.GetBoolArg(
+        "-parworkstealing", DEFAULT_SCRIPTCHECK_WORK_STEALING);
+    LogPrintf("Script verification uses %d additional threads%s\n",
+              script_threads, script_work_stealing ? " (work stealing)" : "");
     if (script_threads >= 1) {
-        StartScriptCheckWorkerThreads(script_threads);
+        StartScriptCheckWorkerThreads(script_threads, script_work_stealing);
     }
 
     // Start the lightweight task scheduler thread
@@ -2691,6 +2786,10 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
 
     loadBlockThread = std::thread(&ThreadImport, std::ref(config), vImportFiles);
 
+    if (fUtxoBackgroundFlush) {
+        StartCoinsFlushThread();
+    }
+
     // Wait for genesis block to be processed
     {
         WAIT_LOCK(g_genesis_wait_mutex, lock);
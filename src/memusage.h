@@ -7,6 +7,7 @@
 
 #include <indirectmap.h>
 #include <prevector.h>
+#include <support/allocators/pool.h>
 #include <util/heapoptional.h>
 
 #include <cstdlib>
@@ -152,6 +153,25 @@ inline size_t DynamicUsage(const std::unordered_map<X, Y, Hasher, Eq, A> &m) {
            MallocUsage(sizeof(void *) * m.bucket_count());
 }
 
+template <typename X, typename Y, typename Hasher, typename Eq,
+          std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+inline size_t DynamicUsage(
+    const std::unordered_map<X, Y, Hasher, Eq,
+                             PoolAllocator<std::pair<const X, Y>,
+                                           MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>>
+        &m) {
+    // The nodes live in chunks owned by the pool resource, which are kept
+    // even when nodes are erased, so count the chunks rather than the nodes.
+    // The chunks are held in a std::list, whose nodes take about 3 pointers.
+    const auto *pool_resource = m.get_allocator().resource();
+    const size_t usage_resource =
+        MallocUsage(sizeof(void *) * 3) * pool_resource->NumAllocatedChunks();
+    const size_t usage_chunks = MallocUsage(pool_resource->ChunkSizeBytes()) *
+                                pool_resource->NumAllocatedChunks();
+    return usage_resource + usage_chunks +
+           MallocUsage(sizeof(void *) * m.bucket_count());
+}
+
 // Some of our utility wrappers
 
 template <typename T>
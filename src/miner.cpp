@@ -68,11 +68,12 @@ int64_t UpdateTime(CBlockHeader *pblock, const Consensus::Params &params,
 BlockAssembler::Options::Options()
     : nConsensusCurrentBlockSizeLimit(DEFAULT_CONSENSUS_BLOCK_SIZE),
       nMaxGeneratedBlockSize(DEFAULT_CONSENSUS_BLOCK_SIZE),
-      blockMinFeeRate(DEFAULT_BLOCK_MIN_TX_FEE_PER_KB) {}
+      blockMinFeeRate(DEFAULT_BLOCK_MIN_TX_FEE_PER_KB), fPackageSelection(DEFAULT_BLOCK_PACKAGE_SELECTION) {}
 
 void BlockAssembler::readOptions(const Options &options) {
     nConsensusCurrentBlockSizeLimit = options.nConsensusCurrentBlockSizeLimit;
     blockMinFeeRate = options.blockMinFeeRate;
+    fPackageSelection = options.fPackageSelection;
     // Limit size to between 1K and nConsensusCurrentBlockSizeLimit -1K for sanity:
     constexpr unsigned coinbaseMargin = 1000u;
     assert(nConsensusCurrentBlockSizeLimit >= coinbaseMargin);
@@ -99,6 +100,7 @@ static BlockAssembler::Options DefaultOptions(const Config &config, const CBlock
             gArgs.IsArgSet("-blockmintxfee") && ParseMoney(gArgs.GetArg("-blockmintxfee", ""), n)) {
         options.blockMinFeeRate = CFeeRate(n);
     }
+    options.fPackageSelection = gArgs.GetBoolArg("-blockpackageselection", DEFAULT_BLOCK_PACKAGE_SELECTION);
 
     return options;
 }
@@ -115,6 +117,8 @@ void BlockAssembler::resetBlock() {
     // These counters do not include coinbase tx.
     nBlockTx = 0;
     nFees = Amount::zero();
+    setInBlock.clear();
+    fSelectionIncomplete = false;
 }
 
 std::unique_ptr<CBlockTemplate>
@@ -179,7 +183,11 @@ BlockAssembler::CreateNewBlock(const CScript &scriptPubKeyIn, double timeLimitSe
         nAddTxsTimeLimit = nTimeStart + static_cast<int64_t>(addTxsFrac * timeLimitSecs * 1e6);
     }
 
-    addTxs(nAddTxsTimeLimit);
+    if (fPackageSelection) {
+        addPackageTxs(nAddTxsTimeLimit);
+    } else {
+        addTxs(nAddTxsTimeLimit);
+    }
 
     const int64_t nTime0 = GetTimeMicros();
 
@@ -192,14 +200,42 @@ BlockAssembler::CreateNewBlock(const CScript &scriptPubKeyIn, double timeLimitSe
                       -> bool { return a.tx->GetId() < b.tx->GetId(); });
     }
 
+    const int64_t nTime1 = GetTimeMicros();
+
+    coinbaseScript = scriptPubKeyIn;
+    FinishBlock(pindexPrev, checkValidity);
+
+    const int64_t nTime2 = GetTimeMicros();
+
+    // Save time taken by addTxs() vs total time taken
+    const int64_t elapsedAddTxs = nTime0 - nTimeStart;
+    const int64_t elapsedTotal = nTime2 - nTimeStart;
+    // Adjust addTxsFrac based on elapsedAddTxs this run, using an EMA with alpha = 25% for non-tiny blocks
+    const double alpha = pblock->vtx.size() > 50 ? 0.25 : 0.05;
+    const double thisAddTxsFrac = elapsedTotal > 0 ? std::clamp(elapsedAddTxs / double(elapsedTotal), 0., 1.) : 0.;
+    addTxsFrac = addTxsFrac * (1. - alpha) + thisAddTxsFrac * alpha;
+
+    LogPrint(BCLog::BENCH,
+             "CreateNewBlock() addTxs: %.2fms, "
+             "CTOR: %.2fms, validity: %.2fms (%u new txs checked) (total %.2fms), addTxsFrac: %1.2f, "
+             "timeLimitSecs: %1.3f\n",
+             0.001 * elapsedAddTxs,
+             0.001 * (nTime1 - nTime0), 0.001 * (nTime2 - nTime1), checkValidity ? validityCache.nLastNewTxs : 0,
+             0.001 * elapsedTotal, addTxsFrac, timeLimitSecs);
+
+    return std::move(pblocktemplate);
+}
+
+void BlockAssembler::FinishBlock(CBlockIndex *pindexPrev, bool checkValidity) {
+    const Consensus::Params &consensusParams = chainparams.GetConsensus();
+
     // Copy all the transactions refs into the block
+    pblock->vtx.clear();
     pblock->vtx.reserve(pblocktemplate->entries.size());
     for (const CBlockTemplateEntry &entry : pblocktemplate->entries) {
         pblock->vtx.push_back(entry.tx);
     }
 
-    const int64_t nTime1 = GetTimeMicros();
-
     nLastBlockTx = nBlockTx;
     nLastBlockSize = nBlockSize;
 
@@ -208,7 +244,7 @@ BlockAssembler::CreateNewBlock(const CScript &scriptPubKeyIn, double timeLimitSe
     coinbaseTx.vin.resize(1);
     coinbaseTx.vin[0].prevout = COutPoint();
     coinbaseTx.vout.resize(1);
-    coinbaseTx.vout[0].scriptPubKey = scriptPubKeyIn;
+    coinbaseTx.vout[0].scriptPubKey = coinbaseScript;
     coinbaseTx.vout[0].nValue = nFees + GetBlockSubsidy(nHeight, consensusParams);
     coinbaseTx.vin[0].scriptSig = CScript() << ScriptInt::fromIntUnchecked(nHeight) << OP_0;
 
@@ -243,30 +279,133 @@ BlockAssembler::CreateNewBlock(const CScript &scriptPubKeyIn, double timeLimitSe
         if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev,
                                BlockValidationOptions(config)
                                    .withCheckPoW(false)
-                                   .withCheckMerkleRoot(false))) {
+                                   .withCheckMerkleRoot(false),
+                               &validityCache)) {
             throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s",
                                                __func__,
                                                FormatStateMessage(state)));
         }
     }
-    const int64_t nTime2 = GetTimeMicros();
+}
 
-    // Save time taken by addTxs() vs total time taken
-    const int64_t elapsedAddTxs = nTime0 - nTimeStart;
-    const int64_t elapsedTotal = nTime2 - nTimeStart;
-    // Adjust addTxsFrac based on elapsedAddTxs this run, using an EMA with alpha = 25% for non-tiny blocks
-    const double alpha = pblock->vtx.size() > 50 ? 0.25 : 0.05;
-    const double thisAddTxsFrac = elapsedTotal > 0 ? std::clamp(elapsedAddTxs / double(elapsedTotal), 0., 1.) : 0.;
-    addTxsFrac = addTxsFrac * (1. - alpha) + thisAddTxsFrac * alpha;
+void BlockAssembler::UpdateBlock(std::unique_ptr<CBlockTemplate> &tmpl, const std::vector<TxId> &removed,
+                                 const std::vector<TxId> &added, bool checkValidity) {
+    const int64_t nTimeStart = GetTimeMicros();
+
+    pblocktemplate = std::move(tmpl);
+    pblock = &pblocktemplate->block;
+    auto &entries = pblocktemplate->entries;
+
+    LOCK2(cs_main, mempool.cs);
+    CBlockIndex *pindexPrev = ::ChainActive().Tip();
+    assert(pindexPrev && pblock->hashPrevBlock == pindexPrev->GetBlockHash());
+
+    // Transactions still in the mempool which have to come out because their fee changed, along with those of their
+    // descendants which are in the block, get another go below.
+    std::queue<CTxMemPool::txiter> candidates;
+    std::unordered_set<TxId, SaltedTxIdHasher> setRemove;
+    for (const TxId &txid : removed) {
+        if (!setInBlock.count(txid) || setRemove.count(txid)) {
+            continue;
+        }
+        const auto it = mempool.mapTx.find(txid);
+        if (it == mempool.mapTx.end()) {
+            // Its descendants left the mempool with it, and are in `removed` too.
+            setRemove.insert(txid);
+            continue;
+        }
+        std::vector<CTxMemPool::txiter> stage{it};
+        while (!stage.empty()) {
+            const auto descendant = stage.back();
+            stage.pop_back();
+            if (setInBlock.count(descendant->GetTx().GetId()) &&
+                setRemove.insert(descendant->GetTx().GetId()).second) {
+                const auto &children = mempool.GetMemPoolChildren(descendant);
+                stage.insert(stage.end(), children.begin(), children.end());
+            }
+        }
+        candidates.push(it);
+    }
+    if (!setRemove.empty()) {
+        entries.erase(std::remove_if(std::begin(entries) + 1, std::end(entries),
+                                     [&](const CBlockTemplateEntry &entry) {
+                                         if (!setRemove.count(entry.tx->GetId())) {
+                                             return false;
+                                         }
+                                         nBlockSize -= entry.tx->GetTotalSize();
+                                         --nBlockTx;
+                                         nBlockSigChecks -= entry.sigChecks;
+                                         nFees -= entry.fees;
+                                         setInBlock.erase(entry.tx->GetId());
+                                         return true;
+                                     }),
+                      std::end(entries));
+    }
+
+    for (const TxId &txid : added) {
+        if (const auto it = mempool.mapTx.find(txid); it != mempool.mapTx.end()) {
+            candidates.push(it);
+        }
+    }
+
+    // As in addTxs(), but only for the new transactions, in the order they came, and their descendants which have
+    // been waiting on them.
+    const size_t nOldEntries = entries.size();
+    while (!candidates.empty()) {
+        const CTxMemPool::txiter iter = candidates.front();
+        candidates.pop();
+
+        if (setInBlock.count(iter->GetTx().GetId()) || iter->GetModifiedFeeRate() < blockMinFeeRate) {
+            continue;
+        }
+
+        const auto &parents = mempool.GetMemPoolParents(iter);
+        if (!std::all_of(parents.begin(), parents.end(), [this](const auto &parent) {
+                return setInBlock.count(parent->GetTx().GetId()) != 0;
+            })) {
+            // It gets another go once its last parent is in. With package selection, it may have been worth
+            // bringing its parents in for it, which only a new block looks at.
+            fSelectionIncomplete |= fPackageSelection;
+            continue;
+        }
+
+        if (!TestTx(iter->GetTxSize(), iter->GetSigChecks())) {
+            fSelectionIncomplete = true;
+            continue;
+        }
+
+        if (!CheckTx(iter->GetTx())) {
+            continue;
+        }
+
+        AddToBlock(iter);
+
+        for (const auto &child : mempool.GetMemPoolChildren(iter)) {
+            candidates.push(child);
+        }
+    }
+
+    if (IsMagneticAnomalyEnabled(chainparams.GetConsensus(), pindexPrev)) {
+        // The block was in canonical order already, so only the new transactions need sorting.
+        const auto cmp = [](const CBlockTemplateEntry &a, const CBlockTemplateEntry &b) -> bool {
+            return a.tx->GetId() < b.tx->GetId();
+        };
+        std::sort(std::begin(entries) + nOldEntries, std::end(entries), cmp);
+        std::inplace_merge(std::begin(entries) + 1, std::begin(entries) + nOldEntries, std::end(entries), cmp);
+    }
+
+    const int64_t nTime0 = GetTimeMicros();
+
+    FinishBlock(pindexPrev, checkValidity);
+
+    const int64_t nTime1 = GetTimeMicros();
 
     LogPrint(BCLog::BENCH,
-             "CreateNewBlock() addTxs: %.2fms, "
-             "CTOR: %.2fms, validity: %.2fms (total %.2fms), addTxsFrac: %1.2f, timeLimitSecs: %1.3f\n",
-             0.001 * elapsedAddTxs,
-             0.001 * (nTime1 - nTime0), 0.001 * (nTime2 - nTime1),
-             0.001 * elapsedTotal, addTxsFrac, timeLimitSecs);
+             "UpdateBlock() %u removed, %u added: %.2fms, validity: %.2fms (%u new txs checked) (total %.2fms)\n",
+             removed.size(), added.size(), 0.001 * (nTime0 - nTimeStart), 0.001 * (nTime1 - nTime0),
+             checkValidity ? validityCache.nLastNewTxs : 0, 0.001 * (nTime1 - nTimeStart));
 
-    return std::move(pblocktemplate);
+    tmpl = std::move(pblocktemplate);
 }
 
 bool BlockAssembler::TestTx(uint64_t txSize, int64_t txSigChecks) const {
@@ -288,6 +427,7 @@ void BlockAssembler::AddToBlock(CTxMemPool::txiter iter) {
     ++nBlockTx;
     nBlockSigChecks += iter->GetSigChecks();
     nFees += iter->GetFee();
+    setInBlock.insert(iter->GetTx().GetId());
 
     if (fPrintPriority) {
         LogPrintf(
@@ -393,6 +533,7 @@ void BlockAssembler::addTxs(int64_t nLimitTimePoint) {
 
         // Check whether the tx will exceed the block limits.
         if (!TestTx(iter->GetTxSize(), iter->GetSigChecks())) {
+            fSelectionIncomplete = true;
             ++nConsecutiveFailed;
             if (nConsecutiveFailed > MAX_CONSECUTIVE_FAILURES && nBlockSize > nMaxGeneratedBlockSize - 1000) {
                 // Give up if we're close to full and haven't succeeded in a while.
@@ -430,6 +571,328 @@ void BlockAssembler::addTxs(int64_t nLimitTimePoint) {
             }
         }
     }
+
+    if (TimedOut()) {
+        fSelectionIncomplete = true;
+    }
+}
+
+/**
+ * The most transactions a package can have in addPackageTxs(). A transaction
+ * with more ancestors not in the block yet waits for some of them to go in.
+ */
+static constexpr size_t MAX_PACKAGE_COUNT = 100;
+
+/**
+ * addPackageTxs is addTxs for -blockpackageselection. Rather than each
+ * transaction on its own, it ranks each transaction together with its
+ * in-mempool ancestors which are not in the block yet, so that a child paying
+ * for its parents (CPFP) brings them in. A package is ranked by the fee it pays
+ * for the room it takes in the block, which is the larger of its virtual size
+ * and its sigchecks weighed by the ratio of the block's size limit to its
+ * sigchecks limit, so that as the block nears either limit the packages paying
+ * the most for what is left of it go in.
+ *
+ * The package of a transaction is only worked out when it comes up: the
+ * candidates are first queued with the score of the transaction alone, and one
+ * whose package scores lower than the next candidate is queued again with the
+ * score of its package. Children are queued again as their parents go in.
+ */
+void BlockAssembler::addPackageTxs(int64_t nLimitTimePoint) {
+    using EntryPtrHasher = StdHashWrapper<const CTxMemPoolEntry *>;
+
+    struct Candidate {
+        double score;
+        CTxMemPool::txiter iter;
+        bool operator<(const Candidate &other) const { return score < other.score; }
+    };
+
+    // A transaction and its ancestors not in the block
+    struct Package {
+        Amount modifiedFees;
+        uint64_t size{};
+        uint64_t virtualSize{};
+        int64_t sigChecks{};
+        size_t count{};
+
+        void Add(const CTxMemPoolEntry &entry) {
+            modifiedFees += entry.GetModifiedFee();
+            size += entry.GetTxSize();
+            virtualSize += entry.GetTxVirtualSize();
+            sigChecks += entry.GetSigChecks();
+            ++count;
+        }
+        void Add(const Package &other) {
+            modifiedFees += other.modifiedFees;
+            size += other.size;
+            virtualSize += other.virtualSize;
+            sigChecks += other.sigChecks;
+            count += other.count;
+        }
+    };
+
+    auto TimedOut = [nLimitTimePoint] {
+        return nLimitTimePoint > 0 && GetTimeMicros() >= nLimitTimePoint;
+    };
+
+    // The virtual size already weighs sigchecks by the policy ratio, which the block's own ratio may exceed.
+    const double bytesPerSigCheck = double(nMaxGeneratedBlockSize) / std::max<uint64_t>(nMaxGeneratedBlockSigChecks, 1);
+    auto Score = [bytesPerSigCheck](const Package &package) {
+        return (package.modifiedFees / SATOSHI)
+               / std::max({double(package.virtualSize), package.sigChecks * bytesPerSigCheck, 1.});
+    };
+    auto Queue = [&Score](std::vector<Candidate> &queue, CTxMemPool::txiter iter) {
+        Package package;
+        package.Add(*iter);
+        queue.push_back({Score(package), iter});
+    };
+
+    // Mirrors setInBlock, which starts out empty, without hashing txids
+    std::unordered_set<const CTxMemPoolEntry *, EntryPtrHasher> inBlock;
+    auto ParentsNotInBlock = [&](CTxMemPool::txiter iter, std::vector<CTxMemPool::txiter> &parents)
+                                 EXCLUSIVE_LOCKS_REQUIRED(mempool.cs) {
+        parents.clear();
+        for (const auto &parent : mempool.GetMemPoolParents(iter)) {
+            if (!inBlock.count(&*parent)) {
+                parents.push_back(parent);
+            }
+        }
+    };
+
+    std::unordered_set<const CTxMemPoolEntry *, EntryPtrHasher> visited;
+    std::vector<std::pair<CTxMemPool::txiter, bool>> stack;
+    std::vector<CTxMemPool::txiter> parents;
+    // Puts the transaction and its ancestors not in the block into txs, parents first. Returns false if there are
+    // more than MAX_PACKAGE_COUNT of them.
+    auto GetPackageTxs = [&](CTxMemPool::txiter iter, std::vector<CTxMemPool::txiter> &txs)
+                             EXCLUSIVE_LOCKS_REQUIRED(mempool.cs) {
+        txs.clear();
+        visited.clear();
+        stack.assign(1, {iter, false});
+        // Depth first, adding each transaction after its parents
+        while (!stack.empty()) {
+            const auto [it, expanded] = stack.back();
+            if (expanded) {
+                stack.pop_back();
+                txs.push_back(it);
+                continue;
+            }
+            if (!visited.insert(&*it).second) {
+                // Reached through another child, and added already
+                stack.pop_back();
+                continue;
+            }
+            if (visited.size() > MAX_PACKAGE_COUNT) {
+                return false;
+            }
+            stack.back().second = true;
+            ParentsNotInBlock(it, parents);
+            for (const auto &parent : parents) {
+                if (!visited.count(&*parent)) {
+                    stack.emplace_back(parent, false);
+                }
+            }
+        }
+        return true;
+    };
+
+    // The packages worked out since the block last changed. A transaction with a single parent not in the block has
+    // the package of its parent plus itself, so that along chains they are worked out in one go.
+    std::unordered_map<const CTxMemPoolEntry *, Package, EntryPtrHasher> packages;
+    uint64_t nPackagesBlockTx = nBlockTx;
+    std::vector<CTxMemPool::txiter> chain, txs;
+    // Returns false if the package has more than MAX_PACKAGE_COUNT transactions
+    auto GetPackage = [&](CTxMemPool::txiter iter, Package &package) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs) {
+        if (nPackagesBlockTx != nBlockTx) {
+            packages.clear();
+            nPackagesBlockTx = nBlockTx;
+        }
+        package = Package();
+        chain.clear();
+        for (auto it = iter;;) {
+            if (const auto found = packages.find(&*it); found != packages.end()) {
+                package = found->second;
+                break;
+            }
+            ParentsNotInBlock(it, parents);
+            if (parents.size() > 1) {
+                if (!GetPackageTxs(it, txs)) {
+                    return false;
+                }
+                for (const auto &tx : txs) {
+                    package.Add(*tx);
+                }
+                packages.emplace(&*it, package);
+                break;
+            }
+            chain.push_back(it);
+            if (chain.size() > MAX_PACKAGE_COUNT) {
+                return false;
+            }
+            if (parents.empty()) {
+                break;
+            }
+            it = parents.front();
+        }
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+            package.Add(**it);
+            packages.emplace(&**it, package);
+        }
+        return package.count <= MAX_PACKAGE_COUNT;
+    };
+
+    // As in addTxs()
+    const int64_t MAX_CONSECUTIVE_FAILURES = 1000;
+    int64_t nConsecutiveFailed = 0;
+
+    std::vector<Candidate> queue;
+    queue.reserve(mempool.size());
+    for (auto it = mempool.mapTx.begin(); it != mempool.mapTx.end(); ++it) {
+        Queue(queue, it);
+    }
+    std::make_heap(queue.begin(), queue.end());
+
+    Package package;
+    while (!TimedOut() && !queue.empty()) {
+        std::pop_heap(queue.begin(), queue.end());
+        const CTxMemPool::txiter iter = queue.back().iter;
+        queue.pop_back();
+
+        if (inBlock.count(&*iter)) {
+            continue;
+        }
+
+        // The package cannot fit if the transaction alone does not, which
+        // spares working it out.
+        const bool fTxFits = TestTx(iter->GetTxSize(), iter->GetSigChecks());
+        if (fTxFits) {
+            if (!GetPackage(iter, package)) {
+                // It is queued again once one of its parents is in the block.
+                continue;
+            }
+
+            const double score = Score(package);
+            if (!queue.empty() && score < queue.front().score) {
+                queue.push_back({score, iter});
+                std::push_heap(queue.begin(), queue.end());
+                continue;
+            }
+
+            if (CFeeRate(package.modifiedFees, package.virtualSize) < blockMinFeeRate) {
+                continue;
+            }
+        }
+
+        if (!fTxFits || !TestTx(package.size, package.sigChecks)) {
+            fSelectionIncomplete = true;
+            ++nConsecutiveFailed;
+            if (nConsecutiveFailed > MAX_CONSECUTIVE_FAILURES && nBlockSize > nMaxGeneratedBlockSize - 1000) {
+                break;
+            }
+            continue;
+        }
+
+        GetPackageTxs(iter, txs);
+        if (!std::all_of(txs.begin(), txs.end(), [this](const auto &it) { return CheckTx(it->GetTx()); })) {
+            continue;
+        }
+
+        nConsecutiveFailed = 0;
+
+        for (const auto &it : txs) {
+            AddToBlock(it);
+            inBlock.insert(&*it);
+        }
+
+        // The packages of their children are smaller now, and get another look.
+        for (const auto &it : txs) {
+            for (const auto &child : mempool.GetMemPoolChildren(it)) {
+                if (!inBlock.count(&*child)) {
+                    Queue(queue, child);
+                    std::push_heap(queue.begin(), queue.end());
+                }
+            }
+        }
+    }
+
+    if (TimedOut()) {
+        fSelectionIncomplete = true;
+    }
+}
+
+IncrementalBlockAssembler::IncrementalBlockAssembler(const Config &_config, CTxMemPool &pool)
+    : assembler(_config, pool), mempool(pool) {
+    connAdded = pool.NotifyEntryAdded.connect([this](CTransactionRef tx) { TransactionAdded(tx->GetId()); });
+    connRemoved = pool.NotifyEntryRemoved.connect(
+        [this](CTransactionRef tx, MemPoolRemovalReason) { TransactionRemoved(tx->GetId()); });
+    connPrioritised = pool.NotifyEntryPrioritised.connect([this](const TxId &txid) {
+        TransactionRemoved(txid);
+        TransactionAdded(txid);
+    });
+}
+
+void IncrementalBlockAssembler::TransactionAdded(const TxId &txid) {
+    LOCK(cs);
+    if (pindexPrev && !fOverflow) {
+        vAdded.push_back(txid);
+        fOverflow = vAdded.size() + vRemoved.size() > MAX_PENDING_CHANGES;
+    }
+}
+
+void IncrementalBlockAssembler::TransactionRemoved(const TxId &txid) {
+    LOCK(cs);
+    if (pindexPrev && !fOverflow) {
+        vRemoved.push_back(txid);
+        fOverflow = vAdded.size() + vRemoved.size() > MAX_PENDING_CHANGES;
+    }
+}
+
+std::unique_ptr<CBlockTemplate>
+IncrementalBlockAssembler::CreateNewBlock(const CScript &scriptPubKeyIn, double timeLimitSecs, bool checkValidity,
+                                          const CBlockIndex **ppindexPrev) {
+    // Hold the mempool still, so that the changes followed from here on are exactly those not in the block.
+    LOCK2(cs_main, mempool.cs);
+    {
+        LOCK(cs);
+        pindexPrev = nullptr;
+        pLastTemplate = nullptr;
+        vAdded.clear();
+        vRemoved.clear();
+        fOverflow = false;
+    }
+    const CBlockIndex *pindexPrevNew{};
+    auto pblocktemplate = assembler.CreateNewBlock(scriptPubKeyIn, timeLimitSecs, checkValidity, &pindexPrevNew);
+    if (ppindexPrev) *ppindexPrev = pindexPrevNew;
+    if (pblocktemplate) {
+        LOCK(cs);
+        pindexPrev = pindexPrevNew;
+        pLastTemplate = pblocktemplate.get();
+    }
+    return pblocktemplate;
+}
+
+bool IncrementalBlockAssembler::UpdateBlock(std::unique_ptr<CBlockTemplate> &tmpl, bool checkValidity) {
+    LOCK2(cs_main, mempool.cs);
+    std::vector<TxId> removed, added;
+    {
+        LOCK(cs);
+        if (!tmpl || tmpl.get() != pLastTemplate || pindexPrev != ::ChainActive().Tip() || fOverflow) {
+            return false;
+        }
+        removed.swap(vRemoved);
+        added.swap(vAdded);
+    }
+    if (removed.empty() && added.empty()) {
+        return true;
+    }
+    try {
+        assembler.UpdateBlock(tmpl, removed, added, checkValidity);
+    } catch (...) {
+        // The block is lost; the next one has to be made anew.
+        WITH_LOCK(cs, pindexPrev = nullptr; pLastTemplate = nullptr);
+        throw;
+    }
+    return true;
 }
 
 static
@@ -7,7 +7,11 @@
 #pragma once
 
 #include <primitives/block.h>
+#include <script/script.h>
+#include <sync.h>
 #include <txmempool.h>
+#include <util/saltedhashers.h>
+#include <validation.h>
 
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index_container.hpp>
@@ -15,17 +19,20 @@
 #include <cstdint>
 #include <memory>
 #include <optional>
+#include <unordered_set>
+#include <vector>
 
 class CBlockIndex;
 class CChainParams;
 class Config;
-class CScript;
 
 namespace Consensus {
 struct Params;
 }
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+/** Default for -blockpackageselection */
+static const bool DEFAULT_BLOCK_PACKAGE_SELECTION = false;
 
 struct CBlockTemplateEntry {
     CTransactionRef tx;
@@ -52,6 +59,7 @@ public:
         uint64_t nConsensusCurrentBlockSizeLimit;
         uint64_t nMaxGeneratedBlockSize;
         CFeeRate blockMinFeeRate;
+        bool fPackageSelection;
     };
 
 private:
@@ -65,12 +73,21 @@ private:
     uint64_t nMaxGeneratedBlockSize{};
     uint64_t nMaxGeneratedBlockSigChecks{};
     CFeeRate blockMinFeeRate;
+    bool fPackageSelection{};
 
     // Information on the current status of the block
     uint64_t nBlockSize{};
     uint64_t nBlockTx{};
     uint64_t nBlockSigChecks{};
     Amount nFees;
+    // The transactions in the block, other than the coinbase
+    std::unordered_set<TxId, SaltedTxIdHasher> setInBlock;
+    // Whether some transactions were left out for lack of room or time
+    bool fSelectionIncomplete{};
+    // The script the coinbase pays to
+    CScript coinbaseScript;
+    // Kept by TestBlockValidity() from one block to the next
+    BlockTemplateValidityCache validityCache;
 
     // Chain context for the block
     int nHeight{};
@@ -114,6 +131,28 @@ public:
     CreateNewBlock(const CScript &scriptPubKeyIn, double timeLimitSecs = 0., bool checkValidity = true,
                    const CBlockIndex **ppindexPrev = nullptr);
 
+    /**
+     *  Bring a block template made by the last call to CreateNewBlock() on
+     *  this instance up to date with the mempool, given the transactions
+     *  removed from it and added to it (or prioritised) since, in the order
+     *  they were added. Only those transactions are looked at, rather than
+     *  the whole mempool, so this is much cheaper than making a new block.
+     *  The tip must not have changed since; the block keeps the coinbase
+     *  script and the options it was made with.
+     *  @param tmpl            The template to update, in place
+     *  @param removed         Ids of the transactions removed or prioritised
+     *  @param added           Ids of the transactions added or prioritised
+     *  @param checkValidity   As for CreateNewBlock()
+     */
+    void UpdateBlock(std::unique_ptr<CBlockTemplate> &tmpl, const std::vector<TxId> &removed,
+                     const std::vector<TxId> &added, bool checkValidity);
+
+    /**
+     * Whether transactions were left out of the last block made or updated for lack of room or time, in which case
+     * UpdateBlock() can miss better ones than those in the block, and a new block should be made from time to time.
+     */
+    bool IsSelectionIncomplete() const { return fSelectionIncomplete; }
+
     // Warning: These won't return real values until CreateNewBlock() has been called at least once on this instance.
     uint64_t GetMaxGeneratedBlockSize() const { return nMaxGeneratedBlockSize; }
     uint64_t GetConsensusMaxBlockSize() const { return nConsensusCurrentBlockSizeLimit; }
@@ -124,6 +163,8 @@ private:
     void resetBlock();
     /** Add a tx to the block */
     void AddToBlock(CTxMemPool::txiter iter);
+    /** Fill in the coinbase and header of the block once its transactions are in, and check it if asked to */
+    void FinishBlock(CBlockIndex *pindexPrev, bool checkValidity);
 
     // Methods for how to add transactions to a block.
     /**
@@ -131,6 +172,12 @@ private:
      */
     void addTxs(int64_t nLimitTimePoint)
         EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
+    /**
+     * Add transactions from the mempool based on the feerate of each with its
+     * ancestors, per the room they take in the block (-blockpackageselection).
+     */
+    void addPackageTxs(int64_t nLimitTimePoint)
+        EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
 
     // helper functions for addTxs()
     /** Test if a new Tx would "fit" in the block */
@@ -140,6 +187,56 @@ private:
     bool CheckTx(const CTransaction &tx) const;
 };
 
+/**
+ * A block template kept up to date with the mempool, for getblocktemplate. It follows the transactions added to,
+ * removed from and prioritised in the mempool, so that the template can be updated with just those (see
+ * BlockAssembler::UpdateBlock()) rather than made anew from the whole mempool each time.
+ */
+class IncrementalBlockAssembler {
+    BlockAssembler assembler;
+    const CTxMemPool &mempool;
+
+    mutable Mutex cs;
+    //! The tip the last block was made on, or nullptr if it is to be made anew
+    const CBlockIndex *pindexPrev GUARDED_BY(cs){};
+    //! The last block made, which is the only one that can be updated
+    const CBlockTemplate *pLastTemplate GUARDED_BY(cs){};
+    //! Transactions removed from / added to the mempool since the block was made or updated
+    std::vector<TxId> vRemoved GUARDED_BY(cs);
+    std::vector<TxId> vAdded GUARDED_BY(cs);
+    //! Set when too many transactions came and went for an update to be worth it
+    bool fOverflow GUARDED_BY(cs){};
+
+    boost::signals2::scoped_connection connAdded;
+    boost::signals2::scoped_connection connRemoved;
+    boost::signals2::scoped_connection connPrioritised;
+
+    void TransactionAdded(const TxId &txid);
+    void TransactionRemoved(const TxId &txid);
+
+public:
+    /** Past this many changes to the mempool, a new block is made rather than updating it */
+    static constexpr size_t MAX_PENDING_CHANGES = 100'000;
+
+    /// Invariant: as for BlockAssembler.
+    IncrementalBlockAssembler(const Config &_config, CTxMemPool &pool);
+
+    /** Make a new block, as BlockAssembler::CreateNewBlock(), and follow the mempool from there */
+    std::unique_ptr<CBlockTemplate>
+    CreateNewBlock(const CScript &scriptPubKeyIn, double timeLimitSecs = 0., bool checkValidity = true,
+                   const CBlockIndex **ppindexPrev = nullptr);
+
+    /**
+     * Update `tmpl`, the last block made by CreateNewBlock(), with the changes to the mempool since. Returns false,
+     * leaving it as it was, if it cannot be updated and a new block must be made instead: it is not the last block
+     * made, the tip changed, or there were too many changes.
+     */
+    bool UpdateBlock(std::unique_ptr<CBlockTemplate> &tmpl, bool checkValidity);
+
+    /** See BlockAssembler::IsSelectionIncomplete() */
+    bool IsSelectionIncomplete() const { return assembler.IsSelectionIncomplete(); }
+};
+
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock *pblock, const CBlockIndex *pindexPrev, const Config &config,
                          unsigned int &nExtraNonce);
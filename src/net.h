@@ -723,6 +723,9 @@ public:
     RecursiveMutex cs_vProcessMsg;
     std::list<CNetMessage> vProcessMsg GUARDED_BY(cs_vProcessMsg);
     size_t nProcessQueueSize{0};
+    //! How many of the messages at the front of vProcessMsg are transactions
+    //! whose scripts were already checked (see PrecheckTransactionsForMempool)
+    size_t nProcessMsgPrechecked GUARDED_BY(cs_vProcessMsg){0};
 
     RecursiveMutex cs_sendProcessing;
 
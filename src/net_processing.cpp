@@ -101,6 +101,11 @@ static constexpr int STALE_RELAY_AGE_LIMIT = 30 * 24 * 60 * 60;
 static constexpr int HISTORICAL_BLOCK_AGE = 7 * 24 * 60 * 60;
 /** Maximum number of in-flight transactions from a peer */
 static constexpr int32_t MAX_PEER_TX_IN_FLIGHT = 100;
+/**
+ * Maximum number of queued transactions from a peer whose scripts are checked
+ * together ahead of their processing
+ */
+static constexpr size_t MAX_PEER_TX_PRECHECK = MAX_PEER_TX_IN_FLIGHT;
 /** Maximum number of announced transactions from a peer */
 static constexpr int32_t MAX_PEER_TX_ANNOUNCEMENTS = 2 * MAX_INV_SZ;
 /** How many microseconds to delay requesting transactions from inbound peers */
@@ -4014,6 +4019,52 @@ bool PeerLogicValidation::SendRejectsAndCheckIfShouldDiscourage(CNode *pnode,
     return false;
 }
 
+/**
+ * Check the scripts of the transactions at the front of the message queue of
+ * `pfrom` together, in parallel, before they are processed one by one. Their
+ * processing then finds the results in the script cache, so that
+ * AcceptToMemoryPool only holds cs_main for its other checks.
+ */
+static void PrecheckQueuedTransactions(const Config &config, CNode *pfrom) {
+    if (!fTxPrecheck || (!g_relay_txes && !pfrom->HasPermission(PF_RELAY))) {
+        return;
+    }
+
+    std::vector<CDataStream> vPayloads;
+    {
+        LOCK(pfrom->cs_vProcessMsg);
+        if (pfrom->nProcessMsgPrechecked > 0) {
+            return;
+        }
+        for (const CNetMessage &msg : pfrom->vProcessMsg) {
+            if (vPayloads.size() == MAX_PEER_TX_PRECHECK ||
+                msg.hdr.GetCommand() != NetMsgType::TX) {
+                break;
+            }
+            vPayloads.push_back(msg.vRecv);
+        }
+        // A lone transaction is checked as fast by AcceptToMemoryPool.
+        if (vPayloads.size() < 2) {
+            return;
+        }
+        pfrom->nProcessMsgPrechecked = vPayloads.size();
+    }
+
+    std::vector<CTransactionRef> txs;
+    txs.reserve(vPayloads.size());
+    for (CDataStream &payload : vPayloads) {
+        payload.SetVersion(pfrom->GetRecvVersion());
+        try {
+            CTransactionRef ptx;
+            payload >> ptx;
+            txs.push_back(std::move(ptx));
+        } catch (const std::exception &) {
+            // Reported when the message is processed.
+        }
+    }
+    PrecheckTransactionsForMempool(config, g_mempool, txs);
+}
+
 bool PeerLogicValidation::ProcessMessages(const Config &config, CNode *pfrom,
                                           std::atomic<bool> &interruptMsgProc) {
     const CChainParams &chainparams = config.GetChainParams();
@@ -4046,6 +4097,8 @@ bool PeerLogicValidation::ProcessMessages(const Config &config, CNode *pfrom,
         return false;
     }
 
+    PrecheckQueuedTransactions(config, pfrom);
+
     std::list<CNetMessage> msgs;
     {
         LOCK(pfrom->cs_vProcessMsg);
@@ -4055,6 +4108,9 @@ bool PeerLogicValidation::ProcessMessages(const Config &config, CNode *pfrom,
         // Just take one message
         msgs.splice(msgs.begin(), pfrom->vProcessMsg,
                     pfrom->vProcessMsg.begin());
+        if (pfrom->nProcessMsgPrechecked > 0) {
+            --pfrom->nProcessMsgPrechecked;
+        }
         pfrom->nProcessQueueSize -=
             msgs.front().vRecv.size() + CMessageHeader::HEADER_SIZE;
         pfrom->fPauseRecv =
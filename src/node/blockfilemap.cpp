@@ -0,0 +1,98 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/blockfilemap.h>
+
+#include <logging.h>
+
+#ifndef WIN32
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedBlockFile::~MappedBlockFile() {
+#ifndef WIN32
+    munmap(const_cast<uint8_t *>(m_data), m_size);
+#endif
+}
+
+std::unique_ptr<const MappedBlockFile>
+MappedBlockFile::Open(const fs::path &path) {
+#ifdef WIN32
+    return nullptr;
+#else
+    const int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1) {
+        LogPrintf("Unable to open file %s for mapping: %s\n", path.string(),
+                  std::strerror(errno));
+        return nullptr;
+    }
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            LogPrintf("Unable to map file %s: %s\n", path.string(),
+                      std::strerror(errno));
+        }
+    }
+    // The mapping stays valid without the file descriptor.
+    close(fd);
+    if (data == MAP_FAILED) {
+        return nullptr;
+    }
+    return std::unique_ptr<const MappedBlockFile>(
+        new MappedBlockFile(static_cast<const uint8_t *>(data), st.st_size));
+#endif
+}
+
+void BlockFileMapCache::SetMaxFiles(size_t max_files) {
+    LOCK(cs);
+    m_max_files = max_files;
+    if (m_entries.size() > m_max_files) {
+        m_entries.resize(m_max_files);
+    }
+}
+
+std::shared_ptr<const MappedBlockFile>
+BlockFileMapCache::Get(int nFile, const fs::path &path, size_t min_size) {
+    LOCK(cs);
+    if (m_max_files == 0) {
+        return nullptr;
+    }
+    auto it = m_entries.begin();
+    while (it != m_entries.end() && it->nFile != nFile) {
+        ++it;
+    }
+    if (it != m_entries.end()) {
+        if (it->path == path && it->file->data().size() >= min_size) {
+            m_entries.splice(m_entries.begin(), m_entries, it);
+            return it->file;
+        }
+        // The file grew, or is another one with the same number (after a
+        // change of data directory, as in the tests).
+        m_entries.erase(it);
+    }
+
+    std::shared_ptr<const MappedBlockFile> file = MappedBlockFile::Open(path);
+    if (!file) {
+        return nullptr;
+    }
+    m_entries.push_front({nFile, path, file});
+    if (m_entries.size() > m_max_files) {
+        m_entries.pop_back();
+    }
+    return file;
+}
+
+void BlockFileMapCache::Invalidate(int nFile) {
+    LOCK(cs);
+    m_entries.remove_if([nFile](const Entry &entry) {
+        return entry.nFile == nFile;
+    });
+}
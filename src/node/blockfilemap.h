@@ -0,0 +1,79 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <fs.h>
+#include <span.h>
+#include <sync.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+
+/** Default for -blockfilemmap: the number of block files kept mapped */
+static constexpr size_t DEFAULT_MAPPED_BLOCK_FILES = sizeof(void *) > 4 ? 16 : 0;
+
+/** A read-only memory mapping of a whole block file (blk?????.dat) */
+class MappedBlockFile {
+    const uint8_t *m_data;
+    size_t m_size;
+
+    MappedBlockFile(const uint8_t *data, size_t size)
+        : m_data(data), m_size(size) {}
+
+public:
+    ~MappedBlockFile();
+
+    MappedBlockFile(const MappedBlockFile &) = delete;
+    MappedBlockFile &operator=(const MappedBlockFile &) = delete;
+
+    /**
+     * Map the file at `path` as it is now. Returns nullptr, having logged why,
+     * if it cannot be mapped, as on platforms without mmap.
+     */
+    static std::unique_ptr<const MappedBlockFile> Open(const fs::path &path);
+
+    Span<const uint8_t> data() const { return {m_data, m_size}; }
+};
+
+/**
+ * The most recently used mappings of the block files, by file number. Readers
+ * hold on to a mapping with a shared_ptr, so that it stays valid for as long
+ * as they use it, even after being evicted or invalidated.
+ */
+class BlockFileMapCache {
+    struct Entry {
+        int nFile;
+        fs::path path;
+        std::shared_ptr<const MappedBlockFile> file;
+    };
+
+    mutable Mutex cs;
+    size_t m_max_files GUARDED_BY(cs);
+    //! Most recently used first
+    std::list<Entry> m_entries GUARDED_BY(cs);
+
+public:
+    explicit BlockFileMapCache(size_t max_files) : m_max_files(max_files) {}
+
+    /** Change the number of mappings kept; 0 disables mapping. */
+    void SetMaxFiles(size_t max_files);
+
+    /**
+     * The mapping of block file `nFile` at `path`, covering at least its first
+     * `min_size` bytes if the file has that many. It is mapped again if the
+     * file grew since it was mapped. Returns nullptr if mapping is disabled or
+     * failed, in which case the file should be read instead.
+     */
+    std::shared_ptr<const MappedBlockFile> Get(int nFile, const fs::path &path,
+                                               size_t min_size);
+
+    /**
+     * Drop the mapping of block file `nFile`, which is being truncated or
+     * deleted. Must be called before doing so.
+     */
+    void Invalidate(int nFile);
+};
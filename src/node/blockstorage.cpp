@@ -13,6 +13,7 @@
 #include <dsproof/dsproof.h>
 #include <flatfile.h>
 #include <fs.h>
+#include <node/blockfilemap.h>
 #include <pow.h>
 #include <hash.h>
 #include <shutdown.h>
@@ -22,6 +23,8 @@
 #include <util/time.h>
 #include <validation.h>
 
+#include <algorithm>
+
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 bool fHavePruned GUARDED_BY(cs_main) = false;
@@ -45,6 +48,9 @@ std::set<const CBlockIndex *> setDirtyBlockIndex GUARDED_BY(cs_main);
 /** Dirty block file entries. */
 std::set<int> setDirtyFileInfo GUARDED_BY(cs_LastBlockFile);
 
+/** The block files mapped for reading blocks */
+static BlockFileMapCache g_block_file_maps{DEFAULT_MAPPED_BLOCK_FILES};
+
 static FILE *OpenUndoFile(const FlatFilePos &pos, bool fReadOnly = false);
 static FlatFileSeq BlockFileSeq();
 static FlatFileSeq UndoFileSeq();
@@ -179,6 +185,10 @@ void FlushBlockFile(bool fFinalize = false) {
                              vinfoBlockFile[nLastBlockFile].nUndoSize);
 
     bool status = true;
+    if (fFinalize) {
+        // The pre-allocated space at its end is truncated.
+        g_block_file_maps.Invalidate(nLastBlockFile);
+    }
     status &= BlockFileSeq().Flush(block_pos_old, fFinalize);
     status &= UndoFileSeq().Flush(undo_pos_old, fFinalize);
     if (!status) {
@@ -201,6 +211,7 @@ uint64_t CalculateCurrentUsage() {
 void UnlinkPrunedFiles(const std::set<int> &setFilesToPrune) {
     for (const int i : setFilesToPrune) {
         FlatFilePos pos(i, 0);
+        g_block_file_maps.Invalidate(i);
         fs::remove(BlockFileSeq().FileName(pos));
         fs::remove(UndoFileSeq().FileName(pos));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, i);
@@ -219,6 +230,20 @@ FILE *OpenBlockFile(const FlatFilePos &pos, bool fReadOnly) {
     return BlockFileSeq().Open(pos, fReadOnly);
 }
 
+void SetMaxMappedBlockFiles(size_t max_files) {
+    g_block_file_maps.SetMaxFiles(max_files);
+}
+
+/**
+ * The mapping of the block file of `pos`, covering at least `min_size` bytes
+ * if the file has that many, or nullptr if block files are not mapped.
+ */
+static std::shared_ptr<const MappedBlockFile>
+MapBlockFile(const FlatFilePos &pos, size_t min_size) {
+    return g_block_file_maps.Get(pos.nFile, BlockFileSeq().FileName(pos),
+                                 min_size);
+}
+
 /** Open an undo file (rev?????.dat) */
 static FILE *OpenUndoFile(const FlatFilePos &pos, bool fReadOnly) {
     return UndoFileSeq().Open(pos, fReadOnly);
@@ -354,23 +379,43 @@ bool WriteUndoDataForBlock(const CBlockUndo &blockundo, CValidationState &state,
     return true;
 }
 
+/** Deserialize the block at `pos` straight from the mapped block file */
+static bool ReadBlockFromMap(CBlock &block, const FlatFilePos &pos) {
+    const auto file = MapBlockFile(pos, pos.nPos);
+    if (!file) {
+        return false;
+    }
+    const Span<const uint8_t> data = file->data();
+    try {
+        GenericVectorReader(SER_DISK, CLIENT_VERSION, data, pos.nPos) >> block;
+    } catch (const std::exception &) {
+        // The block may go beyond the end of the file as it was mapped. Let
+        // the caller read the file, and report the error if it is corrupt.
+        block.SetNull();
+        return false;
+    }
+    return true;
+}
+
 bool ReadBlockFromDisk(CBlock &block, const FlatFilePos &pos,
                        const Consensus::Params &params) {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s",
-                     pos.ToString());
-    }
+    if (!ReadBlockFromMap(block, pos)) {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull()) {
+            return error("ReadBlockFromDisk: OpenBlockFile failed for %s",
+                         pos.ToString());
+        }
 
-    // Read block
-    try {
-        filein >> block;
-    } catch (const std::exception &e) {
-        return error("%s: Deserialize or I/O error - %s at %s", __func__,
-                     e.what(), pos.ToString());
+        // Read block
+        try {
+            filein >> block;
+        } catch (const std::exception &e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__,
+                         e.what(), pos.ToString());
+        }
     }
 
     // Check the header
@@ -461,8 +506,54 @@ std::optional<uint64_t> ReadBlockSizeFromDisk(const CBlockIndex *pindex, const C
     return blockSize;
 }
 
-bool ReadRawBlockFromDisk(std::vector<uint8_t> &rawBlock, const CBlockIndex *pindex,
-                          const CChainParams &chainParams, int nType, int nVersion) {
+/**
+ * Map the raw bytes of the block at `blockPos`, after checking the disk magic and block size in front of them like
+ * ReadBlockSizeCommon. Returns std::nullopt if block files are not mapped, and false, having logged the error, if the
+ * block is not there.
+ */
+static std::optional<bool> ReadRawBlockFromMap(RawBlock &rawBlock, const FlatFilePos &blockPos,
+                                               const CChainParams &chainParams) {
+    auto file = MapBlockFile(blockPos, blockPos.nPos);
+    if (!file) {
+        return std::nullopt;
+    }
+
+    uint32_t blockSize = 0;
+    const size_t headerSize = CMessageHeader::MESSAGE_START_SIZE + sizeof(blockSize);
+    if (blockPos.nPos < headerSize || blockPos.nPos > file->data().size()) {
+        return error("%s: block position out of the bounds of its file for %s", __func__, blockPos.ToString());
+    }
+
+    // read the disk magic and block size
+    CMessageHeader::MessageMagic magic;
+    GenericVectorReader(SER_DISK, CLIENT_VERSION, file->data(), blockPos.nPos - headerSize, magic, blockSize);
+
+    // verify disk magic to validate block position inside the file
+    if (magic != chainParams.DiskMagic()) {
+        return error("%s: block DiskMagic verification failed for %s", __func__, blockPos.ToString());
+    }
+
+    // check the block size for sanity
+    if (blockSize < BLOCK_HEADER_SIZE || blockSize > MAX_CONSENSUS_BLOCK_SIZE) {
+        return error("%s: block size verification failed for %s", __func__, blockPos.ToString());
+    }
+
+    if (blockPos.nPos + uint64_t{blockSize} > file->data().size()) {
+        // The block was written after the file was mapped.
+        file = MapBlockFile(blockPos, blockPos.nPos + blockSize);
+        if (!file || blockPos.nPos + uint64_t{blockSize} > file->data().size()) {
+            return error("%s: block data beyond the end of its file for %s", __func__, blockPos.ToString());
+        }
+    }
+
+    const Span<const uint8_t> data = file->data().subspan(blockPos.nPos, blockSize);
+    rawBlock = RawBlock(std::move(file), data);
+    return true;
+}
+
+/** Read the raw bytes of the block of `pindex` with stdio, when block files are not mapped */
+static bool ReadRawBlockFromFile(std::vector<uint8_t> &rawBlock, const CBlockIndex *pindex,
+                                 const CChainParams &chainParams) {
     uint64_t blockSize;
     FlatFilePos blockPos;
     auto optFile = ReadBlockSizeCommon(blockSize, pindex, chainParams, &blockPos);
@@ -476,46 +567,88 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t> &rawBlock, const CBlockIndex *pin
         rawBlock.resize(blockSize);
         *optFile >> Span{rawBlock};
     } catch (const std::exception &e) {
+        rawBlock.clear();
         return error("%s: failed to read block data from disk for %s. Original exception: %s",
                      __func__, blockPos.ToString(), e.what());
     }
+    return true;
+}
 
-    if (fCheckBlockReads) {
-        // This is normally only enabled for regtest and is provided in order to guarantee additional sanity checks
-        // when returning raw blocks in this manner. For real networks, we prefer the performance benefit of not
-        // deserializing and not doing these slower checks here.
-        Tic elapsed;
-        CBlock block;
-        std::vector<uint8_t> rawBlock2;
-        rawBlock2.reserve(rawBlock.size());
+/** The additional sanity checks of the raw bytes of a block done with -checkblockreads */
+static bool CheckRawBlock(Span<const uint8_t> rawBlock, const CBlockIndex *pindex, const FlatFilePos &blockPos,
+                          int nType, int nVersion) {
+    // This is normally only enabled for regtest and is provided in order to guarantee additional sanity checks
+    // when returning raw blocks in this manner. For real networks, we prefer the performance benefit of not
+    // deserializing and not doing these slower checks here.
+    Tic elapsed;
+    CBlock block;
+    std::vector<uint8_t> rawBlock2;
+    rawBlock2.reserve(rawBlock.size());
 
-        try {
-            VectorReader(nType, nVersion, rawBlock, 0) >> block;
-            CVectorWriter(nType, nVersion, rawBlock2, 0) << block;
-        } catch (const std::exception &e) {
-            return error("%s: Consistency check failed; ser/deser error for block data for %s, exception was: %s",
-                         __func__, blockPos.ToString(), e.what());
-        }
+    try {
+        GenericVectorReader(nType, nVersion, rawBlock, 0) >> block;
+        CVectorWriter(nType, nVersion, rawBlock2, 0) << block;
+    } catch (const std::exception &e) {
+        return error("%s: Consistency check failed; ser/deser error for block data for %s, exception was: %s",
+                     __func__, blockPos.ToString(), e.what());
+    }
+
+    // Ensure the block, when re-serialized with nType and nVersion matches what we had on disk. This defends
+    // against block serialization being sensitive to the caller's nType/nVersion flags. Block serialization
+    // should always be the same irrespective of flags provided, otherwise this ReadRawBlockFromDisk() function
+    // cannot be used and caller should be using ReadBlockFromDisk() instead (see net_processing.cpp where this
+    // function is called).
+    if (!std::equal(rawBlock.begin(), rawBlock.end(), rawBlock2.begin(), rawBlock2.end())) {
+        return error("%s: Consistency check failed; block raw data mismatches re-serialized version for block %s at"
+                     " %s, nType: %i, nVersion: %i", __func__, pindex->ToString(), blockPos.ToString(), nType,
+                     nVersion);
+    }
+    // Check the header (detects possible corruption; unlikely)
+    if (block.GetHash() != pindex->GetBlockHash()) {
+        return error("%s: Consistency check failed; GetHash() doesn't match index for %s at %s",
+                     __func__, pindex->ToString(), blockPos.ToString());
+    }
+    LogPrint(BCLog::BENCH, "%s: checks passed for block %s (%i bytes) in %s msec\n", __func__,
+             block.GetHash().ToString(), rawBlock2.size(), elapsed.msecStr());
+    return true;
+}
 
-        // Ensure the block, when re-serialized with nType and nVersion matches what we had on disk. This defends
-        // against block serialization being sensitive to the caller's nType/nVersion flags. Block serialization
-        // should always be the same irrespective of flags provided, otherwise this ReadRawBlockFromDisk() function
-        // cannot be used and caller should be using ReadBlockFromDisk() instead (see net_processing.cpp where this
-        // function is called).
-        if (rawBlock != rawBlock2) {
-            return error("%s: Consistency check failed; block raw data mismatches re-serialized version for block %s at"
-                         " %s, nType: %i, nVersion: %i", __func__, pindex->ToString(), blockPos.ToString(), nType,
-                         nVersion);
+std::vector<uint8_t> RawBlock::ToVector() && {
+    if (m_file) {
+        return {m_data.begin(), m_data.end()};
+    }
+    return std::move(m_copy);
+}
+
+bool ReadRawBlockFromDisk(RawBlock &rawBlock, const CBlockIndex *pindex, const CChainParams &chainParams, int nType,
+                          int nVersion) {
+    const FlatFilePos blockPos = WITH_LOCK(cs_main, return pindex->GetBlockPos());
+    if (const auto mapped = ReadRawBlockFromMap(rawBlock, blockPos, chainParams)) {
+        if (!*mapped) {
+            return false;
         }
-        // Check the header (detects possible corruption; unlikely)
-        if (block.GetHash() != pindex->GetBlockHash()) {
-            return error("%s: Consistency check failed; GetHash() doesn't match index for %s at %s",
-                         __func__, pindex->ToString(), blockPos.ToString());
+    } else {
+        std::vector<uint8_t> copy;
+        if (!ReadRawBlockFromFile(copy, pindex, chainParams)) {
+            return false;
         }
-        LogPrint(BCLog::BENCH, "%s: checks passed for block %s (%i bytes) in %s msec\n", __func__,
-                 block.GetHash().ToString(), rawBlock2.size(), elapsed.msecStr());
+        rawBlock = RawBlock(std::move(copy));
     }
 
+    if (fCheckBlockReads && !CheckRawBlock(rawBlock.data(), pindex, blockPos, nType, nVersion)) {
+        rawBlock = RawBlock();
+        return false;
+    }
+    return true;
+}
+
+bool ReadRawBlockFromDisk(std::vector<uint8_t> &rawBlock, const CBlockIndex *pindex, const CChainParams &chainParams,
+                          int nType, int nVersion) {
+    RawBlock raw;
+    if (!ReadRawBlockFromDisk(raw, pindex, chainParams, nType, nVersion)) {
+        return false;
+    }
+    rawBlock = std::move(raw).ToVector();
     return true;
 }
 
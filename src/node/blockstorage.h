@@ -6,11 +6,13 @@
 #pragma once
 
 #include <fs.h>
+#include <span.h>
 #include <sync.h>
 
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <set>
 #include <vector>
@@ -22,6 +24,7 @@ class CBlockUndo;
 class CValidationState;
 class CChainParams;
 class Config;
+class MappedBlockFile;
 struct FlatFilePos;
 namespace Consensus {
 struct Params;
@@ -67,6 +70,12 @@ void CleanupBlockRevFiles();
  */
 FILE *OpenBlockFile(const FlatFilePos &pos, bool fReadOnly = false);
 
+/**
+ * Set the number of block files kept memory-mapped for reading blocks
+ * (-blockfilemmap). 0 makes blocks be read with stdio instead.
+ */
+void SetMaxMappedBlockFiles(size_t max_files);
+
 /** Get block file info entry for one block file */
 CBlockFileInfo *GetBlockFileInfo(size_t n);
 
@@ -85,10 +94,44 @@ bool ReadBlockFromDisk(CBlock &block, const FlatFilePos &pos,
                        const Consensus::Params &params);
 bool ReadBlockFromDisk(CBlock &block, const CBlockIndex *pindex,
                        const Consensus::Params &params);
+
+/**
+ * The raw bytes of a block, as read by ReadRawBlockFromDisk. Normally these are the bytes of the memory-mapped block
+ * file itself, which stays mapped for as long as they are held, rather than a copy of them.
+ */
+class RawBlock {
+    std::shared_ptr<const MappedBlockFile> m_file;
+    //! The copy of the bytes, if the block file could not be mapped
+    std::vector<uint8_t> m_copy;
+    Span<const uint8_t> m_data;
+
+public:
+    RawBlock() = default;
+    RawBlock(std::shared_ptr<const MappedBlockFile> file, Span<const uint8_t> data)
+        : m_file(std::move(file)), m_data(data) {}
+    explicit RawBlock(std::vector<uint8_t> &&copy) : m_copy(std::move(copy)), m_data(m_copy) {}
+
+    // The bytes of m_copy stay where they are when it is moved.
+    RawBlock(RawBlock &&) = default;
+    RawBlock &operator=(RawBlock &&) = default;
+    RawBlock(const RawBlock &) = delete;
+    RawBlock &operator=(const RawBlock &) = delete;
+
+    Span<const uint8_t> data() const { return m_data; }
+    size_t size() const { return m_data.size(); }
+
+    /** The bytes as a vector, copied unless they already were. */
+    std::vector<uint8_t> ToVector() &&;
+};
+
 /**
  * Read raw block bytes from disk. Faster than the above, because this function just returns the raw block data without
- * any unserialization. Intended to be used by the net code for low-overhead serving of block data.
+ * any unserialization. Intended to be used by the net code for low-overhead serving of block data. The bytes are those
+ * of the memory-mapped block file, unless it could not be mapped (see -blockfilemmap).
  * `nType` and `nVersion` parameters are used for `-checkblockreads` sanity checking of the serialized data. */
+bool ReadRawBlockFromDisk(RawBlock &rawBlock, const CBlockIndex *pindex, const CChainParams &chainParams, int nType,
+                          int nVersion);
+/** Like the above, for callers needing a vector of the bytes (which are then copied from the mapped block file). */
 bool ReadRawBlockFromDisk(std::vector<uint8_t> &rawBlock, const CBlockIndex *pindex, const CChainParams &chainParams,
                           int nType, int nVersion);
 
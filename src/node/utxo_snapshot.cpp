@@ -0,0 +1,25 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/utxo_snapshot.h>
+
+#include <chainparams.h>
+
+#include <algorithm>
+
+SnapshotMetadata::SnapshotMetadata(const CChainParams &params,
+                                   const BlockHash &base_blockhash,
+                                   uint64_t coins_count,
+                                   const std::optional<abla::State> &abla_state)
+    : m_base_blockhash(base_blockhash), m_coins_count(coins_count),
+      m_abla_state(abla_state) {
+    std::copy(params.DiskMagic().begin(), params.DiskMagic().end(),
+              m_network_magic.begin());
+}
+
+bool SnapshotMetadata::IsForNetwork(const CChainParams &params) const {
+    return std::equal(m_network_magic.begin(), m_network_magic.end(),
+                      params.DiskMagic().begin());
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <consensus/abla.h>
+#include <primitives/blockhash.h>
+#include <serialize.h>
+
+#include <array>
+#include <cstdint>
+#include <ios>
+#include <optional>
+#include <string>
+
+class CChainParams;
+
+/** Version of the UTXO snapshot file format written by dumptxoutset */
+static constexpr uint16_t SNAPSHOT_VERSION = 1;
+/** Leading bytes of a UTXO snapshot file, followed by the network magic */
+static constexpr std::array<uint8_t, 5> SNAPSHOT_MAGIC_BYTES = {'u', 't', 'x', 'o', 0xff};
+
+/**
+ * Metadata at the start of a UTXO snapshot file (see dumptxoutset and
+ * loadtxoutset). It is followed by the coins, grouped by transaction: the txid,
+ * the number of outputs, and for each output its index and the Coin.
+ */
+class SnapshotMetadata {
+public:
+    /** The network the snapshot belongs to */
+    std::array<uint8_t, 4> m_network_magic{};
+    /** The block the UTXO set is the state of, after connecting it */
+    BlockHash m_base_blockhash;
+    /** The number of coins in the snapshot */
+    uint64_t m_coins_count = 0;
+    /**
+     * The ABLA state of the base block, needed to connect the next block.
+     * Unlike the coins, it is not covered by the assumed hash of the snapshot.
+     */
+    std::optional<abla::State> m_abla_state;
+
+    SnapshotMetadata() = default;
+    SnapshotMetadata(const CChainParams &params, const BlockHash &base_blockhash,
+                     uint64_t coins_count,
+                     const std::optional<abla::State> &abla_state);
+
+    template <typename Stream> void Serialize(Stream &s) const {
+        s << SNAPSHOT_MAGIC_BYTES << SNAPSHOT_VERSION << m_network_magic
+          << m_base_blockhash << m_coins_count << m_abla_state;
+    }
+
+    template <typename Stream> void Unserialize(Stream &s) {
+        std::array<uint8_t, SNAPSHOT_MAGIC_BYTES.size()> magic;
+        uint16_t version;
+        s >> magic >> version;
+        if (magic != SNAPSHOT_MAGIC_BYTES) {
+            throw std::ios_base::failure("Not a UTXO snapshot file");
+        }
+        if (version != SNAPSHOT_VERSION) {
+            throw std::ios_base::failure(
+                "Unsupported UTXO snapshot version " + std::to_string(version));
+        }
+        s >> m_network_magic >> m_base_blockhash >> m_coins_count >>
+            m_abla_state;
+    }
+
+    /** Whether the snapshot was made on the network of `params` */
+    bool IsForNetwork(const CChainParams &params) const;
+};
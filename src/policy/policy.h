@@ -37,6 +37,12 @@ static constexpr Amount DEFAULT_BLOCK_MIN_TX_FEE_PER_KB(1000 * SATOSHI);
  * TestBlockValidity() on the generated block template.
  */
 static constexpr bool DEFAULT_GBT_CHECK_VALIDITY = true;
+/**
+ * Default for -gbtincremental, which determines whether getblocktemplate
+ * updates its cached block template with the changes to the mempool rather
+ * than making a new one.
+ */
+static constexpr bool DEFAULT_GBT_INCREMENTAL = true;
 /**
  * Default for -allowunconnectedmining, which determines whether we ensure
  * that the node is connected to at least 1 peer for getblocktemplate[light]
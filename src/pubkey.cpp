@@ -10,9 +10,23 @@
 #include <secp256k1_recovery.h>
 #include <secp256k1_schnorr.h>
 
+#include <memory>
+
 namespace {
 /* Global secp256k1_context object used for verification. */
 secp256k1_context *secp256k1_context_verify = nullptr;
+
+/**
+ * Size of the scratch space used for the multi-scalar multiplication in
+ * CPubKey::VerifySchnorrBatch(), which needs about 2 points per signature.
+ */
+constexpr size_t SCHNORR_BATCH_SCRATCH_SIZE = 1 << 20;
+
+struct ScratchSpaceDeleter {
+    void operator()(secp256k1_scratch_space *scratch) const {
+        secp256k1_scratch_space_destroy(secp256k1_context_no_precomp, scratch);
+    }
+};
 } // namespace
 
 /**
@@ -216,6 +230,36 @@ bool CPubKey::VerifySchnorr(const uint256 &hash,
                                     hash.begin(), &pubkey);
 }
 
+bool CPubKey::VerifySchnorrBatch(
+    const std::vector<SchnorrSigCheck> &checks) {
+    // One scratch space per thread, as batches are verified by the script
+    // check worker threads concurrently.
+    static thread_local std::unique_ptr<secp256k1_scratch_space,
+                                        ScratchSpaceDeleter>
+        scratch{secp256k1_scratch_space_create(secp256k1_context_no_precomp,
+                                               SCHNORR_BATCH_SCRATCH_SIZE)};
+
+    std::vector<secp256k1_pubkey> pubkeys(checks.size());
+    std::vector<const secp256k1_pubkey *> pubkeyPtrs(checks.size());
+    std::vector<const uint8_t *> msgPtrs(checks.size());
+    std::vector<const uint8_t *> sigPtrs(checks.size());
+    for (size_t i = 0; i < checks.size(); ++i) {
+        const CPubKey &pubkey = checks[i].pubkey;
+        if (!pubkey.IsValid() ||
+            !secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkeys[i],
+                                       pubkey.data(), pubkey.size())) {
+            return false;
+        }
+        pubkeyPtrs[i] = &pubkeys[i];
+        msgPtrs[i] = checks[i].hash.begin();
+        sigPtrs[i] = checks[i].sig.data();
+    }
+
+    return secp256k1_schnorr_verify_batch(
+        secp256k1_context_verify, scratch.get(), sigPtrs.data(),
+        msgPtrs.data(), pubkeyPtrs.data(), checks.size());
+}
+
 bool CPubKey::RecoverCompact(const uint256 &hash,
                              const std::vector<uint8_t> &vchSig) {
     if (vchSig.size() != COMPACT_SIGNATURE_SIZE) {
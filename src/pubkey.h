@@ -13,6 +13,7 @@
 
 #include <boost/range/adaptor/sliced.hpp>
 
+#include <array>
 #include <stdexcept>
 #include <vector>
 
@@ -27,6 +28,8 @@ public:
 
 typedef uint256 ChainCode;
 
+struct SchnorrSigCheck;
+
 /** An encapsulated public key. */
 class CPubKey {
 public:
@@ -166,6 +169,13 @@ public:
     bool VerifySchnorr(const uint256 &hash,
                        const std::vector<uint8_t> &vchSig) const;
 
+    /**
+     * Verify a batch of Schnorr signatures at once, which is faster than
+     * verifying them one at a time. Returns true if all of the signatures are
+     * valid; if not, there is no indication of which ones are invalid.
+     */
+    static bool VerifySchnorrBatch(const std::vector<SchnorrSigCheck> &checks);
+
     /**
      * Check whether a DER-serialized ECDSA signature is normalized (lower-S).
      */
@@ -187,6 +197,13 @@ public:
                 const ChainCode &cc) const;
 };
 
+/** A Schnorr signature verification, see CPubKey::VerifySchnorrBatch(). */
+struct SchnorrSigCheck {
+    CPubKey pubkey;
+    uint256 hash;
+    std::array<uint8_t, 64> sig;
+};
+
 struct CExtPubKey {
     uint8_t nDepth = 0;
     uint8_t vchFingerprint[4] = {};
@@ -220,7 +220,7 @@ static bool rest_block(const Config &config, HTTPRequest *req,
 
     const BlockHash hash(rawHash);
 
-    std::vector<uint8_t> rawBlock;
+    RawBlock rawBlock;
     CBlockIndex *pblockindex = nullptr;
     CBlockIndex *tip = nullptr;
     {
@@ -245,12 +245,12 @@ static bool rest_block(const Config &config, HTTPRequest *req,
     switch (rf) {
         case RetFormat::BINARY: {
             req->WriteHeader("Content-Type", "application/octet-stream");
-            req->WriteReply(HTTP_OK, rawBlock);
+            req->WriteReply(HTTP_OK, rawBlock.data());
             return true;
         }
 
         case RetFormat::HEX: {
-            std::string strHex = HexStr(rawBlock) + "\n";
+            std::string strHex = HexStr(rawBlock.data()) + "\n";
             req->WriteHeader("Content-Type", "text/plain");
             req->WriteReply(HTTP_OK, strHex);
             return true;
@@ -258,7 +258,7 @@ static bool rest_block(const Config &config, HTTPRequest *req,
 
         case RetFormat::JSON: {
             CBlock block;
-            VectorReader(SER_NETWORK, PROTOCOL_VERSION, rawBlock, 0) >> block;
+            GenericVectorReader(SER_NETWORK, PROTOCOL_VERSION, rawBlock.data(), 0) >> block;
             UniValue::Object objBlock = blockToJSON(config, block, tip, pblockindex, tx_verbosity);
             std::string strJSON = UniValue::stringify(objBlock) + "\n";
             req->WriteHeader("Content-Type", "application/json");
@@ -15,10 +15,12 @@
 #include <consensus/abla.h>
 #include <consensus/validation.h>
 #include <core_io.h>
+#include <ec_multiset.h>
 #include <hash.h>
 #include <index/txindex.h>
 #include <key_io.h>
 #include <node/blockstorage.h>
+#include <node/utxo_snapshot.h>
 #include <policy/policy.h>
 #include <primitives/transaction.h>
 #include <rpc/mining.h>
@@ -34,6 +36,7 @@
 #include <util/defer.h>
 #include <util/strencodings.h>
 #include <util/system.h>
+#include <utxo_commitment.h>
 #include <validation.h>
 #include <validationinterface.h>
 #include <warnings.h>
@@ -42,6 +45,7 @@
 #include <cassert>
 #include <condition_variable>
 #include <cstdint>
+#include <cstdio>
 #include <list>
 #include <memory>
 #include <mutex>
@@ -488,29 +492,22 @@ static std::string EntryDescriptionString() {
            "       ... ]\n";
 }
 
-static UniValue::Object entryToJSON(const CTxMemPool &pool, const CTxMemPoolEntry &e)
-    EXCLUSIVE_LOCKS_REQUIRED(pool.cs) {
-    AssertLockHeld(pool.cs);
-
+static UniValue::Object entryToJSON(const MempoolSnapshot::Entry &e) {
     UniValue::Object info;
     info.reserve(5);
 
     UniValue::Object fees;
     fees.reserve(2);
-    fees.emplace_back("base", ValueFromAmount(e.GetFee()));
+    fees.emplace_back("base", ValueFromAmount(e.nFee));
     fees.emplace_back("modified", ValueFromAmount(e.GetModifiedFee()));
 
     info.emplace_back("fees", std::move(fees));
-    info.emplace_back("size", e.GetTxSize());
-    info.emplace_back("time", e.GetTime());
-
-    const CTransaction &tx = e.GetTx();
+    info.emplace_back("size", e.nTxSize);
+    info.emplace_back("time", e.info.nTime);
 
     std::set<std::string> setDepends;
-    for (const CTxIn &txin : tx.vin) {
-        if (pool.exists(txin.prevout.GetTxId())) {
-            setDepends.insert(txin.prevout.GetTxId().ToString());
-        }
+    for (const TxId &parent : e.parents) {
+        setDepends.insert(parent.ToString());
     }
     UniValue::Array depends;
     depends.reserve(setDepends.size());
@@ -520,11 +517,9 @@ static UniValue::Object entryToJSON(const CTxMemPool &pool, const CTxMemPoolEntr
     info.emplace_back("depends", std::move(depends));
 
     UniValue::Array spent;
-    const CTxMemPool::txiter &it = pool.mapTx.find(tx.GetId());
-    const CTxMemPool::setEntries &setChildren = pool.GetMemPoolChildren(it);
-    spent.reserve(setChildren.size());
-    for (CTxMemPool::txiter childiter : setChildren) {
-        spent.emplace_back(childiter->GetTx().GetId().ToString());
+    spent.reserve(e.children.size());
+    for (const TxId &child : e.children) {
+        spent.emplace_back(child.ToString());
     }
     info.emplace_back("spentby", std::move(spent));
 
@@ -533,12 +528,12 @@ static UniValue::Object entryToJSON(const CTxMemPool &pool, const CTxMemPoolEntr
 
 UniValue MempoolToJSON(const CTxMemPool &pool, bool verbose) {
     if (verbose) {
+        // Formatting is done on a snapshot, without holding pool.cs.
+        const auto snapshot = pool.GetSnapshot();
         UniValue::Object ret;
-        LOCK(pool.cs);
-        ret.reserve(pool.mapTx.size());
-        for (const CTxMemPoolEntry &e : pool.mapTx) {
-            const uint256 &txid = e.GetTx().GetId();
-            ret.emplace_back(txid.ToString(), entryToJSON(pool, e));
+        ret.reserve(snapshot->entries.size());
+        for (const MempoolSnapshot::Entry &e : snapshot->entries) {
+            ret.emplace_back(e.info.tx->GetId().ToString(), entryToJSON(e));
         }
         return ret;
     }
@@ -647,9 +642,9 @@ static UniValue getmempoolancestors(const Config &config,
     UniValue::Object ret;
     ret.reserve(setAncestors.size());
     for (CTxMemPool::txiter ancestorIt : setAncestors) {
-        const CTxMemPoolEntry &e = *ancestorIt;
-        const TxId &_txid = e.GetTx().GetId();
-        ret.emplace_back(_txid.ToString(), entryToJSON(::g_mempool, e));
+        const TxId &_txid = ancestorIt->GetTx().GetId();
+        ret.emplace_back(_txid.ToString(),
+                         entryToJSON(g_mempool.GetSnapshotEntry(ancestorIt)));
     }
     return ret;
 }
@@ -715,9 +710,9 @@ static UniValue getmempooldescendants(const Config &config,
     UniValue::Object ret;
     ret.reserve(setDescendants.size());
     for (CTxMemPool::txiter descendantIt : setDescendants) {
-        const CTxMemPoolEntry &e = *descendantIt;
-        const TxId &_txid = e.GetTx().GetId();
-        ret.emplace_back(_txid.ToString(), entryToJSON(::g_mempool, e));
+        const TxId &_txid = descendantIt->GetTx().GetId();
+        ret.emplace_back(_txid.ToString(),
+                         entryToJSON(g_mempool.GetSnapshotEntry(descendantIt)));
     }
     return ret;
 }
@@ -751,8 +746,7 @@ static UniValue getmempoolentry(const Config &config,
                            "Transaction not in mempool");
     }
 
-    const CTxMemPoolEntry &e = *it;
-    return entryToJSON(::g_mempool, e);
+    return entryToJSON(g_mempool.GetSnapshotEntry(it));
 }
 
 static UniValue getblockhash(const Config &config,
@@ -940,8 +934,8 @@ static CBlock ReadBlockChecked(const Config &config, const CBlockIndex *pblockin
 
 /// Lock-free -- will throw if block not found or was pruned, etc. Guaranteed to return valid bytes or fail.
 /// Like the above function but does no sanity checking on the block. Just returns the bytes it read from disk.
-static std::vector<uint8_t> ReadRawBlockUnchecked(const Config &config, const CBlockIndex *pblockindex) {
-    std::vector<uint8_t> rawBlock;
+static RawBlock ReadRawBlockUnchecked(const Config &config, const CBlockIndex *pblockindex) {
+    RawBlock rawBlock;
     GenericReadBlockHelper([&]{
         return ReadRawBlockFromDisk(rawBlock, pblockindex, config.GetChainParams(), SER_NETWORK,
                                     PROTOCOL_VERSION);
@@ -1080,7 +1074,7 @@ static UniValue getblock(const Config &config, const JSONRPCRequest &request) {
 
     if (verbosity <= 0) {
         const auto rawBlock = ReadRawBlockUnchecked(config, pblockindex);
-        return HexStr(rawBlock);
+        return HexStr(rawBlock.data());
     }
 
     const CBlock block = ReadBlockChecked(config, pblockindex);
@@ -1126,17 +1120,16 @@ static void ApplyStats(CCoinsStats &stats, CHashWriter &ss, const uint256 &hash,
                           VarIntMode::NONNEGATIVE_SIGNED);
         stats.nTransactionOutputs++;
         stats.nTotalAmount += output.second.GetTxOut().nValue;
-        stats.nBogoSize +=
-            32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ +
-            8 /* amount */ + 2 /* scriptPubKey len */ +
-            output.second.GetTxOut().scriptPubKey.size() /* scriptPubKey */;
+        stats.nBogoSize += GetBogoSize(output.second.GetTxOut().scriptPubKey);
     }
     ss << VARINT(0u);
 }
 
-//! Calculate statistics about the unspent transaction output set
+//! Calculate statistics about the unspent transaction output set, and its
+//! ECMultiSet if pmultiset is not null
 static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats,
-                         const std::function<void()>& interruption_point) {
+                         const std::function<void()>& interruption_point,
+                         ECMultiSet *pmultiset = nullptr) {
     std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
     assert(pcursor);
 
@@ -1144,7 +1137,13 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats,
     stats.hashBlock = pcursor->GetBestBlock();
     {
         LOCK(cs_main);
-        stats.nHeight = LookupBlockIndex(stats.hashBlock)->nHeight;
+        // The coins database has no best block while a UTXO snapshot is
+        // being loaded.
+        const CBlockIndex *pindex = LookupBlockIndex(stats.hashBlock);
+        if (!pindex) {
+            return false;
+        }
+        stats.nHeight = pindex->nHeight;
     }
     ss << stats.hashBlock;
     uint256 prevkey;
@@ -1159,6 +1158,9 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats,
                 outputs.clear();
             }
             prevkey = key.GetTxId();
+            if (pmultiset) {
+                ApplyCoinHash(*pmultiset, key, coin);
+            }
             outputs[key.GetN()] = std::move(coin);
         } else {
             return error("%s: unable to read value", __func__);
@@ -1239,52 +1241,348 @@ static UniValue pruneblockchain(const Config &config,
 
 static UniValue gettxoutsetinfo(const Config &config,
                                 const JSONRPCRequest &request) {
-    if (request.fHelp || request.params.size() != 0) {
+    if (request.fHelp || request.params.size() > 1) {
         throw std::runtime_error(
             RPCHelpMan{"gettxoutsetinfo",
                 "\nReturns statistics about the unspent transaction output set.\n"
-                "Note this call may take some time.\n",
-                {}}
+                "Note this call may take some time, unless hash_type is \"ecmultiset\" and the node maintains the\n"
+                "commitment to the UTXO set (see -utxocommitment).\n",
+                {
+                    {"hash_type", RPCArg::Type::STR, /* opt */ true, /* default_val */ "hash_serialized", "Which UTXO set hash to calculate. Options: \"hash_serialized\", \"ecmultiset\""},
+                }}
                 .ToString() +
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
-            "  \"transactions\": n,      (numeric) The number of transactions\n"
+            "  \"transactions\": n,      (numeric) The number of transactions "
+            "(only with hash_type \"hash_serialized\")\n"
             "  \"txouts\": n,            (numeric) The number of output "
             "transactions\n"
             "  \"bogosize\": n,          (numeric) A database-independent "
             "metric for UTXO set size\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
+            "  \"hash_serialized\": \"hash\",   (string) The serialized hash "
+            "(only with hash_type \"hash_serialized\")\n"
+            "  \"ecmultiset_hash\": \"hash\",   (string) The ECMultiSet hash, "
+            "as checked by loadtxoutset (only with hash_type \"ecmultiset\")\n"
             "  \"disk_size\": n,         (numeric) The estimated size of the "
             "chainstate on disk\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n" +
             HelpExampleCli("gettxoutsetinfo", "") +
+            HelpExampleCli("gettxoutsetinfo", "\"ecmultiset\"") +
             HelpExampleRpc("gettxoutsetinfo", ""));
     }
 
+    const std::string hash_type = request.params[0].isNull()
+                                      ? "hash_serialized"
+                                      : request.params[0].get_str();
+    if (hash_type != "hash_serialized" && hash_type != "ecmultiset") {
+        throw JSONRPCError(RPC_INVALID_PARAMETER,
+                           "hash_type must be \"hash_serialized\" or "
+                           "\"ecmultiset\"");
+    }
+
     CCoinsStats stats;
-    FlushStateToDisk();
-    NodeContext& node = EnsureAnyNodeContext(request.context);
-    if (!GetUTXOStats(pcoinsdbview.get(), stats, node.rpc_interruption_point)) {
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+    std::shared_ptr<const UTXOCommitment> commitment;
+    if (hash_type == "ecmultiset") {
+        LOCK(cs_main);
+        const CBlockIndex *tip = ::ChainActive().Tip();
+        commitment = tip->utxoCommitment;
+        stats.nHeight = tip->nHeight;
+        stats.hashBlock = tip->GetBlockHash();
+    }
+
+    if (commitment) {
+        stats.nTransactionOutputs = commitment->nTransactionOutputs;
+        stats.nBogoSize = commitment->nBogoSize;
+        stats.nTotalAmount = commitment->nTotalAmount;
+        stats.nDiskSize = pcoinsdbview->EstimateSize();
+    } else {
+        FlushStateToDisk();
+        NodeContext& node = EnsureAnyNodeContext(request.context);
+        ECMultiSet multiset;
+        if (!GetUTXOStats(pcoinsdbview.get(), stats, node.rpc_interruption_point,
+                          hash_type == "ecmultiset" ? &multiset : nullptr)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+        }
+        if (hash_type == "ecmultiset") {
+            // Have -utxocommitment maintain it from this block on.
+            commitment = std::make_shared<const UTXOCommitment>(
+                multiset, stats.nTransactionOutputs, stats.nBogoSize,
+                stats.nTotalAmount);
+            SetUTXOCommitment(stats.hashBlock, *commitment);
+        }
     }
 
     UniValue::Object ret;
     ret.reserve(8);
     ret.emplace_back("height", stats.nHeight);
     ret.emplace_back("bestblock", stats.hashBlock.GetHex());
-    ret.emplace_back("transactions", stats.nTransactions);
+    if (!commitment) {
+        ret.emplace_back("transactions", stats.nTransactions);
+    }
     ret.emplace_back("txouts", stats.nTransactionOutputs);
     ret.emplace_back("bogosize", stats.nBogoSize);
-    ret.emplace_back("hash_serialized", stats.hashSerialized.GetHex());
+    if (commitment) {
+        ret.emplace_back("ecmultiset_hash", commitment->GetHash().GetHex());
+    } else {
+        ret.emplace_back("hash_serialized", stats.hashSerialized.GetHex());
+    }
     ret.emplace_back("disk_size", stats.nDiskSize);
     ret.emplace_back("total_amount", ValueFromAmount(stats.nTotalAmount));
     return ret;
 }
 
+static UniValue compactchainstate(const Config &config,
+                                  const JSONRPCRequest &request) {
+    if (request.fHelp || !request.params.empty()) {
+        throw std::runtime_error(
+            RPCHelpMan{"compactchainstate",
+                "\nFlush the UTXO cache and compact the whole coins database, merging its files into the lowest level\n"
+                "they can go to. This makes later reads and compactions cheaper, after an initial sync for instance.\n"
+                "Note this call may take some time.\n",
+                {}}
+                .ToString() +
+            "\nResult:\n"
+            "{\n"
+            "  \"size_before\": n,      (numeric) The estimated size of the chainstate on disk before compacting it\n"
+            "  \"size_after\": n,       (numeric) The estimated size of the chainstate on disk after compacting it\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("compactchainstate", "") +
+            HelpExampleRpc("compactchainstate", ""));
+    }
+
+    FlushStateToDisk();
+    UniValue::Object ret;
+    ret.reserve(2);
+    ret.emplace_back("size_before", pcoinsdbview->EstimateSize());
+    pcoinsdbview->Compact();
+    ret.emplace_back("size_after", pcoinsdbview->EstimateSize());
+    return ret;
+}
+
+static UniValue dumptxoutset(const Config &config,
+                             const JSONRPCRequest &request) {
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            RPCHelpMan{"dumptxoutset",
+                "\nWrite the UTXO set to a file, as a snapshot which can be loaded by loadtxoutset.\n"
+                "Note this call may take some time.\n",
+                {
+                    {"path", RPCArg::Type::STR, /* opt */ false, /* default_val */ "", "Path to the output file. If relative, will be prefixed by datadir."},
+                }}
+                .ToString() +
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_written\": n,        (numeric) The number of coins written in the snapshot\n"
+            "  \"base_hash\": \"hash\",       (string) The hash of the block the snapshot is the UTXO set of\n"
+            "  \"base_height\": n,          (numeric) The height of that block\n"
+            "  \"path\": \"path\",            (string) The absolute path the snapshot was written to\n"
+            "  \"txoutset_hash\": \"hash\",   (string) The ECMultiSet hash of the coins of the snapshot\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("dumptxoutset", "\"utxo.dat\"") +
+            HelpExampleRpc("dumptxoutset", "\"utxo.dat\""));
+    }
+
+    const fs::path path =
+        fs::absolute(request.params[0].get_str(), GetDataDir());
+    // Write to a temporary path and then move into `path` on completion, so
+    // that an interrupted dump does not look like a snapshot.
+    const fs::path temppath = path.string() + ".incomplete";
+    if (fs::exists(path)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER,
+                           path.string() + " already exists. If you are sure "
+                                           "this is what you want, move it "
+                                           "out of the way first");
+    }
+
+    CAutoFile afile(fsbridge::fopen(temppath, "wb"), SER_DISK, CLIENT_VERSION);
+    if (afile.IsNull()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER,
+                           "Couldn't open file " + temppath.string() +
+                               " for writing.");
+    }
+
+    // Take a view of the coins database consistent with the tip, after which
+    // the chain may move on.
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    const CBlockIndex *pindexBase;
+    std::shared_ptr<const UTXOCommitment> commitment;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        pcursor.reset(pcoinsdbview->Cursor(true));
+        pindexBase = LookupBlockIndex(pcursor->GetBestBlock());
+        if (!pindexBase) {
+            throw JSONRPCError(RPC_MISC_ERROR,
+                               "Unable to read UTXO set while a UTXO snapshot "
+                               "is being loaded");
+        }
+        commitment = pindexBase->utxoCommitment;
+    }
+
+    NodeContext &node = EnsureAnyNodeContext(request.context);
+    SnapshotMetadata metadata(config.GetChainParams(),
+                              pindexBase->GetBlockHash(), 0,
+                              pindexBase->GetAblaStateOpt());
+    ECMultiSet hash;
+    try {
+        afile << metadata;
+
+        // Coins come out of the database sorted by outpoint, so the outputs of
+        // a transaction are written together.
+        TxId txid;
+        std::vector<std::pair<uint32_t, Coin>> outputs;
+        auto writeOutputs = [&] {
+            afile << txid << COMPACTSIZE(uint64_t(outputs.size()));
+            for (const auto &[n, coin] : outputs) {
+                afile << VARINT(n) << coin;
+            }
+            metadata.m_coins_count += outputs.size();
+            outputs.clear();
+        };
+        for (; pcursor->Valid(); pcursor->Next()) {
+            COutPoint outpoint;
+            Coin coin;
+            if (!pcursor->GetKey(outpoint) || !pcursor->GetValue(coin)) {
+                throw JSONRPCError(RPC_INTERNAL_ERROR,
+                                   "Unable to read UTXO set");
+            }
+            if (outpoint.GetTxId() != txid && !outputs.empty()) {
+                node.rpc_interruption_point();
+                writeOutputs();
+            }
+            txid = outpoint.GetTxId();
+            if (!commitment) {
+                // Otherwise already known (see -utxocommitment).
+                ApplyCoinHash(hash, outpoint, coin);
+            }
+            outputs.emplace_back(outpoint.GetN(), std::move(coin));
+        }
+        if (!outputs.empty()) {
+            writeOutputs();
+        }
+
+        // Now that the number of coins is known, write the metadata again.
+        if (std::fseek(afile.Get(), 0, SEEK_SET) != 0) {
+            throw std::ios_base::failure("seek failed");
+        }
+        afile << metadata;
+        if (!FileCommit(afile.Get())) {
+            throw std::ios_base::failure("FileCommit failed");
+        }
+        afile.fclose();
+    } catch (const std::ios_base::failure &e) {
+        afile.fclose();
+        fs::remove(temppath);
+        throw JSONRPCError(RPC_MISC_ERROR,
+                           strprintf("Unable to write %s: %s",
+                                     temppath.string(), e.what()));
+    }
+    RenameOver(temppath, path);
+
+    UniValue::Object ret;
+    ret.reserve(5);
+    ret.emplace_back("coins_written", metadata.m_coins_count);
+    ret.emplace_back("base_hash", pindexBase->GetBlockHash().GetHex());
+    ret.emplace_back("base_height", pindexBase->nHeight);
+    ret.emplace_back("path", path.string());
+    ret.emplace_back("txoutset_hash",
+                     (commitment ? commitment->GetHash() : hash.GetHash())
+                         .GetHex());
+    return ret;
+}
+
+static UniValue loadtxoutset(const Config &config,
+                             const JSONRPCRequest &request) {
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            RPCHelpMan{"loadtxoutset",
+                "\nLoad a UTXO snapshot written by dumptxoutset, and make its base block the chain tip, so that the node\n"
+                "only needs to download and validate the blocks after it.\n"
+                "The node must run with -prune, must not have connected any block yet, and must know the header of the\n"
+                "base block of the snapshot. The coins of the snapshot must match the UTXO set hash known for its height.\n"
+                "The blocks below the base block are considered valid without being downloaded, and will not be available.\n"
+                "If the node stops during the load, the coins written so far are erased at the next start.\n"
+                "Note this call may take some time.\n",
+                {
+                    {"path", RPCArg::Type::STR, /* opt */ false, /* default_val */ "", "Path to the snapshot file. If relative, will be prefixed by datadir."},
+                }}
+                .ToString() +
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_loaded\": n,         (numeric) The number of coins loaded from the snapshot\n"
+            "  \"base_hash\": \"hash\",       (string) The hash of the base block of the snapshot\n"
+            "  \"base_height\": n,          (numeric) The height of that block\n"
+            "  \"path\": \"path\",            (string) The absolute path the snapshot was read from\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("loadtxoutset", "\"utxo.dat\"") +
+            HelpExampleRpc("loadtxoutset", "\"utxo.dat\""));
+    }
+
+    const fs::path path =
+        fs::absolute(request.params[0].get_str(), GetDataDir());
+    CAutoFile afile(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (afile.IsNull()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER,
+                           "Couldn't open file " + path.string() +
+                               " for reading.");
+    }
+
+    SnapshotMetadata metadata;
+    try {
+        afile >> metadata;
+    } catch (const std::ios_base::failure &e) {
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR,
+                           strprintf("Unable to read %s: %s", path.string(),
+                                     e.what()));
+    }
+
+    int nHeight;
+    {
+        LOCK(cs_main);
+        const CBlockIndex *pindex =
+            LookupBlockIndex(metadata.m_base_blockhash);
+        if (!pindex) {
+            throw JSONRPCError(
+                RPC_INVALID_ADDRESS_OR_KEY,
+                strprintf("The header of the snapshot base block %s is not "
+                          "known yet",
+                          metadata.m_base_blockhash.ToString()));
+        }
+        nHeight = pindex->nHeight;
+    }
+    const AssumeutxoData *au_data =
+        config.GetChainParams().AssumeutxoForHeight(nHeight);
+    if (!au_data) {
+        throw JSONRPCError(
+            RPC_INVALID_PARAMETER,
+            strprintf("No UTXO set hash is known for height %d", nHeight));
+    }
+
+    CValidationState state;
+    if (!LoadUTXOSnapshot(config, afile, metadata, *au_data, state)) {
+        throw JSONRPCError(RPC_MISC_ERROR, FormatStateMessage(state));
+    }
+    // Connect the blocks after the snapshot which were already received.
+    if (!ActivateBestChain(config, state)) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, FormatStateMessage(state));
+    }
+
+    UniValue::Object ret;
+    ret.reserve(4);
+    ret.emplace_back("coins_loaded", metadata.m_coins_count);
+    ret.emplace_back("base_hash", metadata.m_base_blockhash.GetHex());
+    ret.emplace_back("base_height", nHeight);
+    ret.emplace_back("path", path.string());
+    return ret;
+}
+
 UniValue gettxout(const Config &config, const JSONRPCRequest &request) {
     if (request.fHelp || request.params.size() < 2 ||
         request.params.size() > 3) {
@@ -2925,6 +3223,8 @@ static UniValue fillmempool(const Config &config, const JSONRPCRequest &request)
 static const ContextFreeRPCCommand commands[] = {
     //  category            name                      actor (function)        argNames
     //  ------------------- ------------------------  ----------------------  ----------
+    { "blockchain",         "compactchainstate",      compactchainstate,      {} },
+    { "blockchain",         "dumptxoutset",           dumptxoutset,           {"path"} },
     { "blockchain",         "finalizeblock",          finalizeblock,          {"blockhash"} },
     { "blockchain",         "getbestblockhash",       getbestblockhash,       {} },
     { "blockchain",         "getblock",               getblock,               {"blockhash","verbosity|verbose"} },
@@ -2943,8 +3243,9 @@ static const ContextFreeRPCCommand commands[] = {
     { "blockchain",         "getmempoolinfo",         getmempoolinfo,         {} },
     { "blockchain",         "getrawmempool",          getrawmempool,          {"verbose"} },
     { "blockchain",         "gettxout",               gettxout,               {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        gettxoutsetinfo,        {} },
+    { "blockchain",         "gettxoutsetinfo",        gettxoutsetinfo,        {"hash_type"} },
     { "blockchain",         "invalidateblock",        invalidateblock,        {"blockhash"} },
+    { "blockchain",         "loadtxoutset",           loadtxoutset,           {"path"} },
     { "blockchain",         "parkblock",              parkblock,              {"blockhash"} },
     { "blockchain",         "preciousblock",          preciousblock,          {"blockhash"} },
     { "blockchain",         "pruneblockchain",        pruneblockchain,        {"height"} },
@@ -366,7 +366,9 @@ const std::string kDataFileMagic = "GBT";
 } // namespace
 } // namespace gbtl
 
-static UniValue getblocktemplatecommon(bool fLight, const Config &config, const JSONRPCRequest &request) {
+/// If `pLightTemplate` is not nullptr, the light template is also returned there, in short (fLight mode only).
+static UniValue getblocktemplatecommon(bool fLight, const Config &config, const JSONRPCRequest &request,
+                                       gbtl::LightTemplate *pLightTemplate = nullptr) {
     const auto t0 = GetTimeMicros(); // perf. info, used iff logging BCLog::RPC
     LOCK(cs_main);
 
@@ -509,7 +511,9 @@ static UniValue getblocktemplatecommon(bool fLight, const Config &config, const
     struct LightResult {
         const gbtl::JobId jobId;
         const UniValue::Array merkle;
-        LightResult(const gbtl::JobId& _jobId, const UniValue::Array& _merkle) : jobId(_jobId), merkle(_merkle) {}
+        const std::vector<uint256> merkleSteps;
+        LightResult(const gbtl::JobId& _jobId, const UniValue::Array& _merkle, const std::vector<uint256>& _merkleSteps)
+            : jobId(_jobId), merkle(_merkle), merkleSteps(_merkleSteps) {}
     };
     // Update block
     static CBlockIndex *pindexPrev;
@@ -517,10 +521,31 @@ static UniValue getblocktemplatecommon(bool fLight, const Config &config, const
     static std::unique_ptr<CBlockTemplate> pblocktemplate;
     static std::unique_ptr<LightResult> plightresult; // fLight mode only, cached result associated with pblocktemplate
     static bool fIgnoreCache = false;
+    // Follows the mempool from the last template made, to update it cheaply (-gbtincremental)
+    static IncrementalBlockAssembler incrementalAssembler(GetConfig(), g_mempool);
+    const bool fIncremental = gArgs.GetBoolArg("-gbtincremental", DEFAULT_GBT_INCREMENTAL);
     bool fNewTip = (pindexPrev && pindexPrev != ::ChainActive().Tip());
-    if (pindexPrev != ::ChainActive().Tip() || fIgnoreCache || ignoreCacheOverride ||
-        (g_mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast &&
-         GetTime() - nStart > 5)) {
+    bool fMakeNew = pindexPrev != ::ChainActive().Tip() || fIgnoreCache || ignoreCacheOverride;
+    if (!fMakeNew && g_mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast) {
+        // A template which was left short of some transactions for lack of room or time is still made anew every 5
+        // seconds, since the transactions it left out are not followed.
+        const bool fStale = GetTime() - nStart > 5;
+        if (fIncremental && !(fStale && incrementalAssembler.IsSelectionIncomplete())) {
+            // As below, clear pindexPrev so that a failure makes a new block on the next call.
+            CBlockIndex *pindexPrevOld = pindexPrev;
+            pindexPrev = nullptr;
+            nTransactionsUpdatedLast = g_mempool.GetTransactionsUpdated();
+            if (incrementalAssembler.UpdateBlock(pblocktemplate, checkValidity)) {
+                plightresult.reset();
+                pindexPrev = pindexPrevOld;
+            } else {
+                fMakeNew = true;
+            }
+        } else {
+            fMakeNew = fStale;
+        }
+    }
+    if (fMakeNew) {
         // Clear pindexPrev so future calls make a new block, despite any
         // failures from here on
         pindexPrev = nullptr;
@@ -548,8 +573,11 @@ static UniValue getblocktemplatecommon(bool fLight, const Config &config, const
         // Create new block
         CScript scriptDummy = CScript() << OP_TRUE;
         const CBlockIndex *pindexMinedTip{};
-        pblocktemplate =
-            BlockAssembler(config, g_mempool).CreateNewBlock(scriptDummy, timeLimitSecs, checkValidity, &pindexMinedTip);
+        pblocktemplate = fIncremental
+                             ? incrementalAssembler.CreateNewBlock(scriptDummy, timeLimitSecs, checkValidity,
+                                                                   &pindexMinedTip)
+                             : BlockAssembler(config, g_mempool)
+                                   .CreateNewBlock(scriptDummy, timeLimitSecs, checkValidity, &pindexMinedTip);
         plightresult.reset();
         if (!pblocktemplate) {
             throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
@@ -625,6 +653,7 @@ static UniValue getblocktemplatecommon(bool fLight, const Config &config, const
 
     uint160 jobId; // fLight version only, ends up in results["job_id"]
     UniValue::Array merkle; // fLight version only, ends up in results["merkle"]
+    std::vector<uint256> merkleSteps; // fLight version only, the hashes of `merkle`
     UniValue::Array transactions; // !fLight version only, ends up in results["transactions"]
     if (fLight) {
         assert(pvtx && (!tmpBlockTxsWithAdditionalTxs || pvtx == tmpBlockTxsWithAdditionalTxs.get()));
@@ -633,6 +662,7 @@ static UniValue getblocktemplatecommon(bool fLight, const Config &config, const
             LogPrint(BCLog::RPC, "Using cached merkle result\n");
             jobId = plightresult->jobId; // copy jobId
             merkle = plightresult->merkle; // copy UniValue
+            merkleSteps = plightresult->merkleSteps;
         } else {
             // merkle cached result not available (new template) or we have additional_txs and can't use cached result
             LogPrint(BCLog::RPC, "Calculating new merkle result\n");
@@ -645,7 +675,7 @@ static UniValue getblocktemplatecommon(bool fLight, const Config &config, const
                 vtxIdsNoCoinbase.push_back(tx->GetId());
             }
             // make merkleSteps and merkle branch
-            const auto merkleSteps = gbtl::MakeMerkleBranch(std::move(vtxIdsNoCoinbase));
+            merkleSteps = gbtl::MakeMerkleBranch(std::move(vtxIdsNoCoinbase));
             merkle.reserve(merkleSteps.size());
             // hash source is Hash160(hashPrevBlock + concatenation_of_all_merkle_step_hashes)
             std::vector<uint8_t> hashSource;
@@ -661,7 +691,7 @@ static UniValue getblocktemplatecommon(bool fLight, const Config &config, const
 
             // Finally, cache the merkle results if they were calculated from the tx's in pblock (no additional_txs).
             if (pvtx == &pblock->vtx) {
-                plightresult.reset(new LightResult(jobId, merkle));
+                plightresult.reset(new LightResult(jobId, merkle, merkleSteps));
                 LogPrint(BCLog::RPC, "Saved merkle result\n");
             }
         }
@@ -739,10 +769,27 @@ static UniValue getblocktemplatecommon(bool fLight, const Config &config, const
         gbtl::CacheAndSaveTxsToFile(jobId, pvtx);
     }
 
+    if (fLight && pLightTemplate) {
+        pLightTemplate->jobId = jobId;
+        pLightTemplate->hashPrevBlock = pblock->hashPrevBlock;
+        pLightTemplate->nHeight = pindexPrev->nHeight + 1;
+        pLightTemplate->nVersion = pblock->nVersion;
+        pLightTemplate->nBits = pblock->nBits;
+        pLightTemplate->nTime = pblock->GetBlockTime();
+        pLightTemplate->coinbaseValue = pblock->vtx[0]->vout[0].nValue;
+        pLightTemplate->merkle = std::move(merkleSteps);
+    }
+
     LogPrint(BCLog::RPC, "getblocktemplatecommon: took %f secs\n", (GetTimeMicros() - t0) / 1e6);
     return result;
 }
 
+gbtl::LightTemplate gbtl::GetLightTemplate(const Config &config) {
+    LightTemplate ret;
+    getblocktemplatecommon(true, config, JSONRPCRequest(), &ret);
+    return ret;
+}
+
 static std::vector<RPCArg> getGBTArgs(const Config &config, bool fLight) {
     std::vector<RPCArg> ret{
         {"template_request", RPCArg::Type::OBJ, /* opt */ true, /* default_val */ "",
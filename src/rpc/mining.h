@@ -5,13 +5,17 @@
 
 #pragma once
 
+#include <amount.h>
 #include <gbtlight.h>
+#include <primitives/blockhash.h>
 #include <primitives/transaction.h>
 #include <script/script.h>
 
 #include <univalue.h>
 
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 class CBlock;
 class Config;
@@ -50,4 +54,20 @@ void LoadTxsFromFile(const JobId &jobId, CBlock &block);
  *  IMPORTANT: This function must be called with the cs_main lock held.  Test code should take cs_main before
  *             calling this function.   */
 void CacheAndSaveTxsToFile(const JobId &jobId, const std::vector<CTransactionRef> *pvtx);
+
+/** A light block template, in short, as published by -zmqpubblocktemplate. */
+struct LightTemplate {
+    JobId jobId;
+    BlockHash hashPrevBlock;
+    int32_t nHeight{};
+    int32_t nVersion{};
+    uint32_t nBits{};
+    int64_t nTime{};
+    Amount coinbaseValue;
+    //! The merkle branch of the "merkle" entry of getblocktemplatelight
+    std::vector<uint256> merkle;
+};
+/** Returns the template getblocktemplatelight would return now, in short. Its job is kept for submitblocklight the
+ *  same way. Throws JSONRPCError like getblocktemplatelight does, e.g. during the initial block download.   */
+LightTemplate GetLightTemplate(const Config &config);
 }
@@ -37,6 +37,14 @@ ScriptExecutionContext::ScriptExecutionContext(unsigned input, const std::vector
     shared = std::make_shared<Shared>(std::move(coins), tx);
 }
 
+ScriptExecutionContext::ScriptExecutionContext(unsigned input, std::vector<Coin> &&coins, CTransactionView tx)
+    : nIn(input)
+{
+    assert(input < tx.vin().size());
+    assert(coins.size() == tx.vin().size());
+    shared = std::make_shared<Shared>(std::move(coins), tx);
+}
+
 ScriptExecutionContext::ScriptExecutionContext(unsigned input, const ScriptExecutionContext &sharedContext)
     : nIn(input), shared(sharedContext.shared)
 {
@@ -85,3 +93,19 @@ ScriptExecutionContext::createForAllInputs(CTransactionView tx, const std::vecto
     }
     return ret;
 }
+
+/* static */
+std::vector<ScriptExecutionContext>
+ScriptExecutionContext::createForAllInputs(CTransactionView tx, std::vector<Coin> &&coins)
+{
+    std::vector<ScriptExecutionContext> ret;
+    ret.reserve(tx.vin().size());
+    for (size_t i = 0; i < tx.vin().size(); ++i) {
+        if (i == 0) {
+            ret.push_back(ScriptExecutionContext(i, std::move(coins), tx)); // private c'tor, must use push_back
+        } else {
+            ret.push_back(ScriptExecutionContext(i, ret.front())); // private c'tor, must use push_back
+        }
+    }
+    return ret;
+}
@@ -56,6 +56,10 @@ class ScriptExecutionContext {
     /// All of the coins for the tx will get pre-cached and a new internal Shared object will be constructed.
     ScriptExecutionContext(unsigned input, const std::vector<PSBTInput> &inputs, CTransactionView tx);
 
+    /// Construct a specific context for this input, given a tx and the coins spent by all of its inputs.
+    /// Use this constructor for the first input in a tx.
+    ScriptExecutionContext(unsigned input, std::vector<Coin> &&coins, CTransactionView tx);
+
     /// Construct a specific context for this input, given another context.
     /// The two contexts will share the same Shared data.
     /// Use this constructor for all subsequent inputs to a tx (so that they may all share the same context)
@@ -70,6 +74,11 @@ public:
     static
     std::vector<ScriptExecutionContext> createForAllInputs(CTransactionView tx, const std::vector<PSBTInput> &inputs);
 
+    /// Like the above, but takes the coins spent by the tx directly, in input order. This never touches a
+    /// CCoinsViewCache, so it may be used from worker threads.
+    static
+    std::vector<ScriptExecutionContext> createForAllInputs(CTransactionView tx, std::vector<Coin> &&coins);
+
     /// Construct a *limited* context that cannot see all coins (utxos). It only has the coin for this input.
     /// All other sibling input coins will appear as coin.IsSpent() (null data).  this->isLimited() will return
     /// true if this constructor is used.
@@ -13,6 +13,7 @@
 #include <uint256.h>
 #include <util/system.h>
 
+#include <algorithm>
 #include <mutex>
 #include <shared_mutex>
 
@@ -117,9 +118,70 @@ bool CachingTransactionSignatureChecker::IsCached(
                             [] { return false; });
 }
 
+void SchnorrBatchVerifier::Add(const std::vector<uint8_t> &vchSig,
+                               const CPubKey &pubkey, const uint256 &sighash,
+                               const uint256 &cacheEntry, bool store) {
+    assert(vchSig.size() == 64);
+    Entry &entry = entries.emplace_back();
+    entry.check.pubkey = pubkey;
+    entry.check.hash = sighash;
+    std::copy(vchSig.begin(), vchSig.end(), entry.check.sig.begin());
+    entry.cacheEntry = cacheEntry;
+    entry.store = store;
+}
+
+bool SchnorrBatchVerifier::Verify() {
+    if (entries.empty()) {
+        return true;
+    }
+
+    bool fOk = false;
+    // Batch verification only pays off once there are a few signatures, and
+    // does not tell which signatures are bad when it fails. Verify the
+    // signatures one at a time in either case.
+    if (entries.size() >= SCHNORR_BATCH_MIN_SIZE) {
+        std::vector<SchnorrSigCheck> checks;
+        checks.reserve(entries.size());
+        for (const Entry &entry : entries) {
+            checks.push_back(entry.check);
+        }
+        fOk = CPubKey::VerifySchnorrBatch(checks);
+    }
+
+    if (fOk) {
+        for (Entry &entry : entries) {
+            if (entry.store) {
+                signatureCache.Set(entry.cacheEntry);
+            }
+        }
+    } else {
+        fOk = true;
+        for (Entry &entry : entries) {
+            const std::vector<uint8_t> vchSig(entry.check.sig.begin(),
+                                              entry.check.sig.end());
+            if (!entry.check.pubkey.VerifySchnorr(entry.check.hash, vchSig)) {
+                fOk = false;
+            } else if (entry.store) {
+                signatureCache.Set(entry.cacheEntry);
+            }
+        }
+    }
+
+    entries.clear();
+    return fOk;
+}
+
 bool CachingTransactionSignatureChecker::VerifySignature(
     const std::vector<uint8_t> &vchSig, const CPubKey &pubkey,
     const uint256 &sighash) const {
+    if (pSchnorrBatch && vchSig.size() == 64) {
+        uint256 entry;
+        signatureCache.ComputeEntry(entry, sighash, vchSig, pubkey);
+        if (!signatureCache.Get(entry, !store)) {
+            pSchnorrBatch->Add(vchSig, pubkey, sighash, entry, store);
+        }
+        return true;
+    }
     return RunMemoizedCheck(vchSig, pubkey, sighash, store, [&] {
         return TransactionSignatureChecker::VerifySignature(vchSig, pubkey,
                                                             sighash);
@@ -6,7 +6,9 @@
 
 #pragma once
 
+#include <pubkey.h>
 #include <script/interpreter.h>
+#include <uint256.h>
 
 #include <vector>
 
@@ -16,8 +18,8 @@
 static constexpr int64_t DEFAULT_MAX_SIG_CACHE_SIZE = 32;
 // Maximum sig cache size allowed
 static constexpr int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
-
-class CPubKey;
+// Below this many signatures, SchnorrBatchVerifier verifies them one at a time
+static constexpr size_t SCHNORR_BATCH_MIN_SIZE = 8;
 
 /**
  * We're hashing a nonce into the entries themselves, so we don't need extra
@@ -39,18 +41,60 @@ public:
     }
 };
 
+/**
+ * Schnorr signature verifications deferred by a
+ * CachingTransactionSignatureChecker, to be verified together as a batch.
+ *
+ * Deferred signatures are reported as valid to the script interpreter. This is
+ * only correct when the scripts are run with SCRIPT_VERIFY_NULLFAIL, which
+ * turns any failed signature check into a script failure: the scripts then
+ * succeed if and only if they succeed as well with all of the deferred
+ * signatures being valid.
+ */
+class SchnorrBatchVerifier {
+private:
+    struct Entry {
+        SchnorrSigCheck check;
+        //! Signature cache entry, added once the signature is verified
+        uint256 cacheEntry;
+        bool store;
+    };
+    std::vector<Entry> entries;
+
+    void Add(const std::vector<uint8_t> &vchSig, const CPubKey &pubkey,
+             const uint256 &sighash, const uint256 &cacheEntry, bool store);
+
+public:
+    /**
+     * Verify all of the deferred signatures and forget about them. Valid
+     * signatures are added to the signature cache if requested when they were
+     * deferred. Returns whether all of the signatures are valid.
+     */
+    bool Verify();
+
+    /** Forget about the deferred signatures without verifying them */
+    void Clear() { entries.clear(); }
+
+    size_t size() const { return entries.size(); }
+
+    friend class CachingTransactionSignatureChecker;
+};
+
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker {
 private:
     bool store;
+    //! If not null, Schnorr signatures are deferred to this batch
+    SchnorrBatchVerifier *pSchnorrBatch;
 
     bool IsCached(const std::vector<uint8_t> &vchSig, const CPubKey &vchPubKey,
                   const uint256 &sighash) const;
 
 public:
     CachingTransactionSignatureChecker(const ScriptExecutionContext &contextIn, bool storeIn,
-                                       PrecomputedTransactionData &txdataIn)
+                                       PrecomputedTransactionData &txdataIn,
+                                       SchnorrBatchVerifier *pSchnorrBatchIn = nullptr)
         : TransactionSignatureChecker(contextIn, txdataIn),
-          store(storeIn) {}
+          store(storeIn), pSchnorrBatch(pSchnorrBatchIn) {}
 
     bool VerifySignature(const std::vector<uint8_t> &vchSig,
                          const CPubKey &vchPubKey,
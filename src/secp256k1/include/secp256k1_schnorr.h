@@ -23,6 +23,32 @@ SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int secp256k1_schnorr_verify(
   const secp256k1_pubkey *pubkey
 ) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(2) SECP256K1_ARG_NONNULL(3) SECP256K1_ARG_NONNULL(4);
 
+/**
+ * Verify a batch of signatures created by secp256k1_schnorr_sign, using a
+ * single multi-scalar multiplication with random weights. This is faster than
+ * verifying the signatures one at a time, but does not tell which signature is
+ * invalid if the batch does not verify.
+ * Returns: 1: all signatures are correct (or n_sigs is 0)
+ *          0: at least one signature is incorrect
+ * Args:    ctx:       a secp256k1 context object, initialized for verification.
+ *          scratch:   scratch space used for the multi-scalar multiplication.
+ *                     If NULL, or too small, the points are multiplied one at
+ *                     a time and the batch is not faster than individual
+ *                     verification.
+ * In:      sig64:     array of pointers to the 64-byte signatures
+ *          msg32:     array of pointers to the 32-byte message hashes
+ *          pubkey:    array of pointers to the public keys
+ *          n_sigs:    number of signatures in the arrays
+ */
+SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int secp256k1_schnorr_verify_batch(
+  const secp256k1_context* ctx,
+  secp256k1_scratch_space *scratch,
+  const unsigned char *const *sig64,
+  const unsigned char *const *msg32,
+  const secp256k1_pubkey *const *pubkey,
+  size_t n_sigs
+) SECP256K1_ARG_NONNULL(1);
+
 /**
  * Create a signature using a custom EC-Schnorr-SHA256 construction. It
  * produces non-malleable 64-byte signatures which support batch validation,
@@ -27,6 +27,155 @@ int secp256k1_schnorr_verify(
     return secp256k1_schnorr_sig_verify(&ctx->ecmult_ctx, sig64, &q, msg32);
 }
 
+/* Data passed to the ecmult_multi callback of secp256k1_schnorr_verify_batch.
+ * Point 2*i is R_i and point 2*i+1 is P_i, for the i-th signature. */
+typedef struct {
+    const secp256k1_context *ctx;
+    const unsigned char *const *sig64;
+    const unsigned char *const *msg32;
+    const secp256k1_pubkey *const *pubkey;
+    const unsigned char *seed;
+} secp256k1_schnorr_verify_batch_data;
+
+/* Compute the randomizer a_i of the i-th signature of a batch. The first one
+ * is always 1, the others are derived from a hash of the whole batch so that
+ * they cannot be predicted when the signatures are created. */
+static void secp256k1_schnorr_batch_randomizer(secp256k1_scalar *a, const unsigned char *seed, size_t i) {
+    secp256k1_sha256 sha;
+    unsigned char buf[32];
+    unsigned char idx[8];
+    int j;
+
+    if (i == 0) {
+        secp256k1_scalar_set_int(a, 1);
+        return;
+    }
+
+    for (j = 0; j < 8; j++) {
+        idx[j] = (unsigned char)((uint64_t)i >> (8 * j));
+    }
+    secp256k1_sha256_initialize(&sha);
+    secp256k1_sha256_write(&sha, seed, 32);
+    secp256k1_sha256_write(&sha, idx, 8);
+    secp256k1_sha256_finalize(&sha, buf);
+    secp256k1_scalar_set_b32(a, buf, NULL);
+}
+
+static int secp256k1_schnorr_verify_batch_cb(secp256k1_scalar *sc, secp256k1_ge *pt, size_t idx, void *cbdata) {
+    const secp256k1_schnorr_verify_batch_data *data = (const secp256k1_schnorr_verify_batch_data *)cbdata;
+    size_t i = idx / 2;
+    secp256k1_scalar a;
+
+    secp256k1_schnorr_batch_randomizer(&a, data->seed, i);
+    if (idx % 2 == 0) {
+        /* -a_i * R_i, with R_i the point with x coordinate r and a quadratic
+         * residue as y coordinate. */
+        secp256k1_fe rx;
+        if (!secp256k1_fe_set_b32(&rx, data->sig64[i])) {
+            return 0;
+        }
+        if (!secp256k1_ge_set_xquad(pt, &rx)) {
+            return 0;
+        }
+        secp256k1_scalar_negate(sc, &a);
+    } else {
+        /* -a_i * e_i * P_i */
+        secp256k1_scalar e;
+        if (!secp256k1_pubkey_load(data->ctx, pt, data->pubkey[i])) {
+            return 0;
+        }
+        secp256k1_schnorr_compute_e(&e, data->sig64[i], pt, data->msg32[i]);
+        secp256k1_scalar_mul(sc, &a, &e);
+        secp256k1_scalar_negate(sc, sc);
+    }
+    return 1;
+}
+
+int secp256k1_schnorr_verify_batch(
+    const secp256k1_context* ctx,
+    secp256k1_scratch_space *scratch,
+    const unsigned char *const *sig64,
+    const unsigned char *const *msg32,
+    const secp256k1_pubkey *const *pubkey,
+    size_t n_sigs
+) {
+    secp256k1_schnorr_verify_batch_data data;
+    secp256k1_sha256 sha;
+    secp256k1_scalar s, a, sum_s;
+    secp256k1_gej resj;
+    unsigned char seed[32];
+    size_t i;
+    VERIFY_CHECK(ctx != NULL);
+    ARG_CHECK(secp256k1_ecmult_context_is_built(&ctx->ecmult_ctx));
+    ARG_CHECK(n_sigs == 0 || sig64 != NULL);
+    ARG_CHECK(n_sigs == 0 || msg32 != NULL);
+    ARG_CHECK(n_sigs == 0 || pubkey != NULL);
+    /* The callback indexes points as 2*i and 2*i+1. */
+    ARG_CHECK(n_sigs <= SIZE_MAX / 2);
+
+    if (n_sigs == 0) {
+        return 1;
+    }
+
+    /* Check the encoding of every signature and public key, and commit to the
+     * whole batch in the seed of the randomizers. */
+    secp256k1_sha256_initialize(&sha);
+    for (i = 0; i < n_sigs; i++) {
+        secp256k1_ge q;
+        secp256k1_fe rx;
+        unsigned char buf[33];
+        size_t size = 0;
+        int overflow = 0;
+
+        ARG_CHECK(sig64[i] != NULL);
+        ARG_CHECK(msg32[i] != NULL);
+        ARG_CHECK(pubkey[i] != NULL);
+
+        if (!secp256k1_pubkey_load(ctx, &q, pubkey[i])) {
+            return 0;
+        }
+        if (!secp256k1_fe_set_b32(&rx, sig64[i])) {
+            return 0;
+        }
+        secp256k1_scalar_set_b32(&s, sig64[i] + 32, &overflow);
+        if (overflow) {
+            return 0;
+        }
+
+        secp256k1_eckey_pubkey_serialize(&q, buf, &size, 1);
+        VERIFY_CHECK(size == 33);
+        secp256k1_sha256_write(&sha, sig64[i], 64);
+        secp256k1_sha256_write(&sha, msg32[i], 32);
+        secp256k1_sha256_write(&sha, buf, 33);
+    }
+    secp256k1_sha256_finalize(&sha, seed);
+
+    /* sum(a_i * s_i) * G */
+    secp256k1_scalar_set_int(&sum_s, 0);
+    for (i = 0; i < n_sigs; i++) {
+        secp256k1_scalar_set_b32(&s, sig64[i] + 32, NULL);
+        secp256k1_schnorr_batch_randomizer(&a, seed, i);
+        secp256k1_scalar_mul(&s, &s, &a);
+        secp256k1_scalar_add(&sum_s, &sum_s, &s);
+    }
+
+    /* The batch is valid iff
+     *   sum(a_i * s_i) * G - sum(a_i * R_i) - sum(a_i * e_i * P_i) == 0
+     * where R_i is decompressed from r_i with a quadratic residue y. This
+     * accepts exactly the signatures accepted by secp256k1_schnorr_verify,
+     * except with negligible probability. */
+    data.ctx = ctx;
+    data.sig64 = sig64;
+    data.msg32 = msg32;
+    data.pubkey = pubkey;
+    data.seed = seed;
+    if (!secp256k1_ecmult_multi_var(&ctx->error_callback, &ctx->ecmult_ctx, scratch, &resj, &sum_s, secp256k1_schnorr_verify_batch_cb, &data, 2 * n_sigs)) {
+        return 0;
+    }
+
+    return secp256k1_gej_is_infinity(&resj);
+}
+
 int secp256k1_schnorr_sign(
     const secp256k1_context *ctx,
     unsigned char *sig64,
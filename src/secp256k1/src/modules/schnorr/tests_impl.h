@@ -78,6 +78,72 @@ void test_schnorr_sign_verify(void) {
 
 #undef SIG_COUNT
 
+#define BATCH_SIZE 64
+
+void test_schnorr_verify_batch(void) {
+    unsigned char privkey[BATCH_SIZE][32];
+    unsigned char msg[BATCH_SIZE][32];
+    unsigned char sig[BATCH_SIZE][64];
+    secp256k1_pubkey pubkey[BATCH_SIZE];
+    const unsigned char *sigptr[BATCH_SIZE];
+    const unsigned char *msgptr[BATCH_SIZE];
+    const secp256k1_pubkey *pubkeyptr[BATCH_SIZE];
+    secp256k1_scratch_space *scratch;
+    size_t i, n;
+
+    for (i = 0; i < BATCH_SIZE; i++) {
+        secp256k1_scalar key;
+        random_scalar_order_test(&key);
+        secp256k1_scalar_get_b32(privkey[i], &key);
+        secp256k1_rand256_test(msg[i]);
+        CHECK(secp256k1_ec_pubkey_create(ctx, &pubkey[i], privkey[i]) == 1);
+        CHECK(secp256k1_schnorr_sign(ctx, sig[i], msg[i], privkey[i], NULL, NULL) == 1);
+        sigptr[i] = sig[i];
+        msgptr[i] = msg[i];
+        pubkeyptr[i] = &pubkey[i];
+    }
+
+    scratch = secp256k1_scratch_space_create(ctx, 1024 * 1024);
+    CHECK(scratch != NULL);
+
+    /* An empty batch is valid. */
+    CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, NULL, NULL, NULL, 0) == 1);
+
+    for (n = 1; n <= BATCH_SIZE; n *= 2) {
+        size_t bad = secp256k1_rand_int(n);
+        int pos = secp256k1_rand_bits(6);
+        unsigned char mod = 1 + secp256k1_rand_int(255);
+
+        /* Valid signatures verify, with and without scratch space. */
+        CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, sigptr, msgptr, pubkeyptr, n) == 1);
+        CHECK(secp256k1_schnorr_verify_batch(ctx, NULL, sigptr, msgptr, pubkeyptr, n) == 1);
+
+        /* A single bad signature makes the batch fail. */
+        sig[bad][pos] ^= mod;
+        CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, sigptr, msgptr, pubkeyptr, n) == 0);
+        CHECK(secp256k1_schnorr_verify_batch(ctx, NULL, sigptr, msgptr, pubkeyptr, n) == 0);
+        sig[bad][pos] ^= mod;
+
+        /* So does a signature checked against the wrong message. */
+        msg[bad][pos % 32] ^= mod;
+        CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, sigptr, msgptr, pubkeyptr, n) == 0);
+        msg[bad][pos % 32] ^= mod;
+
+        /* Swapping two public keys makes the batch fail. */
+        if (n > 1) {
+            pubkeyptr[0] = &pubkey[1];
+            pubkeyptr[1] = &pubkey[0];
+            CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, sigptr, msgptr, pubkeyptr, n) == 0);
+            pubkeyptr[0] = &pubkey[0];
+            pubkeyptr[1] = &pubkey[1];
+        }
+    }
+
+    secp256k1_scratch_space_destroy(ctx, scratch);
+}
+
+#undef BATCH_SIZE
+
 void run_schnorr_compact_test(void) {
     {
         /* Test vector 1 */
@@ -517,6 +583,7 @@ void run_schnorr_tests(void) {
 
     test_schnorr_sign_verify();
     run_schnorr_compact_test();
+    test_schnorr_verify_batch();
 }
 
 #endif
@@ -8,6 +8,7 @@
 #include <config.h>
 #include <consensus/consensus.h>
 #include <consensus/validation.h>
+#include <node/blockfilemap.h>
 #include <node/blockstorage.h>
 #include <span.h>
 #include <streams.h>
@@ -260,4 +261,51 @@ BOOST_FIXTURE_TEST_CASE(check_read_raw_block_from_disk, TestChain100Setup) {
     }
 }
 
+// Check that blocks read from the mapped block files are the same as those read with stdio.
+BOOST_FIXTURE_TEST_CASE(read_block_from_mapped_file, TestChain100Setup) {
+    Defer d([]{ SetMaxMappedBlockFiles(DEFAULT_MAPPED_BLOCK_FILES); });
+    const auto &chainParams = GetConfig().GetChainParams();
+    const auto readRaw = [&](const CBlockIndex *pindex, size_t maxMappedFiles) {
+        SetMaxMappedBlockFiles(maxMappedFiles);
+        RawBlock rawBlock;
+        BOOST_REQUIRE(ReadRawBlockFromDisk(rawBlock, pindex, chainParams, SER_NETWORK, PROTOCOL_VERSION));
+        return rawBlock;
+    };
+    const auto readBlock = [&](const CBlockIndex *pindex, size_t maxMappedFiles) {
+        SetMaxMappedBlockFiles(maxMappedFiles);
+        CBlock block;
+        BOOST_REQUIRE(ReadBlockFromDisk(block, pindex, chainParams.GetConsensus()));
+        return block;
+    };
+
+    const CBlockIndex *tip = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+    const std::vector<const CBlockIndex *> blocks{tip, tip->pprev, tip->GetAncestor(1)};
+    for (const CBlockIndex *pindex : blocks) {
+        const RawBlock mapped = readRaw(pindex, 1);
+        const RawBlock copied = readRaw(pindex, 0);
+        // The mapped bytes stay valid after their mapping is dropped.
+        BOOST_CHECK(mapped.data() == copied.data());
+        BOOST_CHECK(readBlock(pindex, 1).GetHash() == pindex->GetBlockHash());
+        BOOST_CHECK(readBlock(pindex, 0).GetHash() == pindex->GetBlockHash());
+
+        std::vector<uint8_t> rawBlock;
+        SetMaxMappedBlockFiles(1);
+        BOOST_REQUIRE(ReadRawBlockFromDisk(rawBlock, pindex, chainParams, SER_NETWORK, PROTOCOL_VERSION));
+        BOOST_CHECK(Span{rawBlock} == copied.data());
+        CBlock block;
+        GenericVectorReader(SER_NETWORK, PROTOCOL_VERSION, mapped.data(), 0) >> block;
+        BOOST_CHECK(block.GetHash() == pindex->GetBlockHash());
+    }
+
+    // So are the blocks written after their file was mapped.
+    const RawBlock mappedTip = readRaw(tip, 1);
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const CBlock next = CreateAndProcessBlock({}, scriptPubKey);
+    const CBlockIndex *pindexNext = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+    BOOST_REQUIRE(pindexNext->GetBlockHash() == next.GetHash());
+    BOOST_CHECK(readRaw(pindexNext, 1).data() == readRaw(pindexNext, 0).data());
+    BOOST_CHECK(readBlock(pindexNext, 1).GetHash() == next.GetHash());
+    BOOST_CHECK(mappedTip.data() == readRaw(tip, 0).data());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -106,6 +106,30 @@ struct FrozenCleanupCheck {
     }
 };
 
+/** Check that defers its result to the end of the batch it is run in. */
+struct DeferringCheck {
+    static thread_local size_t tl_deferred;
+    static thread_local bool tl_failed;
+    static std::atomic<size_t> n_verified;
+    bool fails{false};
+    DeferringCheck() {}
+    explicit DeferringCheck(bool fails_) : fails(fails_) {}
+    bool operator()() {
+        ++tl_deferred;
+        tl_failed |= fails;
+        return true;
+    }
+    static bool FinishBatch(bool fOk) {
+        if (fOk) {
+            n_verified.fetch_add(tl_deferred, std::memory_order_relaxed);
+            fOk = !tl_failed;
+        }
+        tl_deferred = 0;
+        tl_failed = false;
+        return fOk;
+    }
+};
+
 // Static Allocations
 std::mutex FrozenCleanupCheck::m{};
 std::atomic<uint64_t> FrozenCleanupCheck::nFrozen{0};
@@ -114,6 +138,9 @@ std::mutex UniqueCheck::m;
 std::unordered_multiset<size_t> UniqueCheck::results;
 std::atomic<size_t> FakeCheckCheckCompletion::n_calls{0};
 std::atomic<size_t> MemoryCheck::fake_allocated_memory{0};
+thread_local size_t DeferringCheck::tl_deferred{0};
+thread_local bool DeferringCheck::tl_failed{false};
+std::atomic<size_t> DeferringCheck::n_verified{0};
 
 // Queue Typedefs
 typedef CCheckQueue<FakeCheckCheckCompletion> Correct_Queue;
@@ -122,13 +149,15 @@ typedef CCheckQueue<FailingCheck> Failing_Queue;
 typedef CCheckQueue<UniqueCheck> Unique_Queue;
 typedef CCheckQueue<MemoryCheck> Memory_Queue;
 typedef CCheckQueue<FrozenCleanupCheck> FrozenCleanup_Queue;
+typedef CCheckQueue<DeferringCheck> Deferring_Queue;
 
 /** This test case checks that the CCheckQueue works properly
  * with each specified size_t Checks pushed.
  */
-static void Correct_Queue_range(std::vector<size_t> range) {
+static void Correct_Queue_range(std::vector<size_t> range,
+                                bool work_stealing) {
     auto small_queue = std::make_unique<Correct_Queue>(QUEUE_BATCH_SIZE);
-    small_queue->StartWorkerThreads(SCRIPT_CHECK_THREADS);
+    small_queue->StartWorkerThreads(SCRIPT_CHECK_THREADS, work_stealing);
     // Make vChecks here to save on malloc (this test can be slow...)
     std::vector<FakeCheckCheckCompletion> vChecks;
     for (const size_t i : range) {
@@ -153,21 +182,24 @@ static void Correct_Queue_range(std::vector<size_t> range) {
 BOOST_AUTO_TEST_CASE(test_CheckQueue_Correct_Zero) {
     std::vector<size_t> range;
     range.push_back((size_t)0);
-    Correct_Queue_range(range);
+    Correct_Queue_range(range, false);
+    Correct_Queue_range(range, true);
 }
 /** Test that 1 check is correct
  */
 BOOST_AUTO_TEST_CASE(test_CheckQueue_Correct_One) {
     std::vector<size_t> range;
     range.push_back((size_t)1);
-    Correct_Queue_range(range);
+    Correct_Queue_range(range, false);
+    Correct_Queue_range(range, true);
 }
 /** Test that MAX check is correct
  */
 BOOST_AUTO_TEST_CASE(test_CheckQueue_Correct_Max) {
     std::vector<size_t> range;
     range.push_back(100000);
-    Correct_Queue_range(range);
+    Correct_Queue_range(range, false);
+    Correct_Queue_range(range, true);
 }
 /** Test that random numbers of checks are correct
  */
@@ -179,86 +211,127 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_Correct_Random) {
                                       (size_t)1000, ((size_t)100000) - i)))) {
         range.push_back(i);
     }
-    Correct_Queue_range(range);
+    Correct_Queue_range(range, false);
+    Correct_Queue_range(range, true);
 }
 
 /** Test that failing checks are caught */
 BOOST_AUTO_TEST_CASE(test_CheckQueue_Catches_Failure) {
-    auto fail_queue = std::make_unique<Failing_Queue>(QUEUE_BATCH_SIZE);
+    for (const bool work_stealing : {false, true}) {
+        auto fail_queue = std::make_unique<Failing_Queue>(QUEUE_BATCH_SIZE);
 
-    fail_queue->StartWorkerThreads(SCRIPT_CHECK_THREADS);
+        fail_queue->StartWorkerThreads(SCRIPT_CHECK_THREADS, work_stealing);
 
-    for (size_t i = 0; i < 1001; ++i) {
-        CCheckQueueControl<FailingCheck> control(fail_queue.get());
-        size_t remaining = i;
-        while (remaining) {
-            size_t r = InsecureRandRange(10);
+        for (size_t i = 0; i < 1001; ++i) {
+            CCheckQueueControl<FailingCheck> control(fail_queue.get());
+            size_t remaining = i;
+            while (remaining) {
+                size_t r = InsecureRandRange(10);
 
-            std::vector<FailingCheck> vChecks;
-            vChecks.reserve(r);
-            for (size_t k = 0; k < r && remaining; k++, remaining--) {
-                vChecks.emplace_back(remaining == 1);
+                std::vector<FailingCheck> vChecks;
+                vChecks.reserve(r);
+                for (size_t k = 0; k < r && remaining; k++, remaining--) {
+                    vChecks.emplace_back(remaining == 1);
+                }
+                control.Add(vChecks);
+            }
+            bool success = control.Wait();
+            if (i > 0) {
+                BOOST_REQUIRE(!success);
+            } else if (i == 0) {
+                BOOST_REQUIRE(success);
             }
-            control.Add(vChecks);
-        }
-        bool success = control.Wait();
-        if (i > 0) {
-            BOOST_REQUIRE(!success);
-        } else if (i == 0) {
-            BOOST_REQUIRE(success);
         }
+        fail_queue->StopWorkerThreads();
     }
-    fail_queue->StopWorkerThreads();
 }
 // Test that a block validation which fails does not interfere with
 // future blocks, ie, the bad state is cleared.
 BOOST_AUTO_TEST_CASE(test_CheckQueue_Recovers_From_Failure) {
-    auto fail_queue = std::make_unique<Failing_Queue>(QUEUE_BATCH_SIZE);
-    fail_queue->StartWorkerThreads(SCRIPT_CHECK_THREADS);
+    for (const bool work_stealing : {false, true}) {
+        auto fail_queue = std::make_unique<Failing_Queue>(QUEUE_BATCH_SIZE);
+        fail_queue->StartWorkerThreads(SCRIPT_CHECK_THREADS, work_stealing);
 
-    for (auto times = 0; times < 10; ++times) {
-        for (const bool end_fails : {true, false}) {
-            CCheckQueueControl<FailingCheck> control(fail_queue.get());
-            {
-                std::vector<FailingCheck> vChecks;
-                vChecks.resize(100, false);
-                vChecks[99] = end_fails;
+        for (auto times = 0; times < 10; ++times) {
+            for (const bool end_fails : {true, false}) {
+                CCheckQueueControl<FailingCheck> control(fail_queue.get());
+                {
+                    std::vector<FailingCheck> vChecks;
+                    vChecks.resize(100, false);
+                    vChecks[99] = end_fails;
+                    control.Add(vChecks);
+                }
+                bool r = control.Wait();
+                BOOST_REQUIRE(r != end_fails);
+            }
+        }
+        fail_queue->StopWorkerThreads();
+    }
+}
+
+// Test that work deferred to the end of a batch is accounted for before the
+// result is returned, and that its failures are caught.
+BOOST_AUTO_TEST_CASE(test_CheckQueue_BatchFinisher) {
+    for (const bool work_stealing : {false, true}) {
+        auto queue = std::make_unique<Deferring_Queue>(
+            QUEUE_BATCH_SIZE, "scriptch", DeferringCheck::FinishBatch);
+        queue->StartWorkerThreads(SCRIPT_CHECK_THREADS, work_stealing);
+
+        for (size_t i = 0; i < 1001; ++i) {
+            const bool fails = i % 3 == 0;
+            DeferringCheck::n_verified = 0;
+            CCheckQueueControl<DeferringCheck> control(queue.get());
+            size_t remaining = i;
+            while (remaining) {
+                size_t r = InsecureRandRange(10);
+                std::vector<DeferringCheck> vChecks;
+                for (size_t k = 0; k < r && remaining; k++, remaining--) {
+                    vChecks.emplace_back(fails && remaining == 1);
+                }
                 control.Add(vChecks);
             }
-            bool r = control.Wait();
-            BOOST_REQUIRE(r != end_fails);
+            const bool success = control.Wait();
+            if (i > 0 && fails) {
+                BOOST_REQUIRE(!success);
+            } else {
+                BOOST_REQUIRE(success);
+                BOOST_REQUIRE_EQUAL(DeferringCheck::n_verified, i);
+            }
         }
+        queue->StopWorkerThreads();
     }
-    fail_queue->StopWorkerThreads();
 }
 
 // Test that unique checks are actually all called individually, rather than
 // just one check being called repeatedly. Test that checks are not called
 // more than once as well
 BOOST_AUTO_TEST_CASE(test_CheckQueue_UniqueCheck) {
-    auto queue = std::make_unique<Unique_Queue>(QUEUE_BATCH_SIZE);
-    queue->StartWorkerThreads(SCRIPT_CHECK_THREADS);
+    for (const bool work_stealing : {false, true}) {
+        UniqueCheck::results.clear();
+        auto queue = std::make_unique<Unique_Queue>(QUEUE_BATCH_SIZE);
+        queue->StartWorkerThreads(SCRIPT_CHECK_THREADS, work_stealing);
 
-    size_t COUNT = 100000;
-    size_t total = COUNT;
-    {
-        CCheckQueueControl<UniqueCheck> control(queue.get());
-        while (total) {
-            size_t r = InsecureRandRange(10);
-            std::vector<UniqueCheck> vChecks;
-            for (size_t k = 0; k < r && total; k++) {
-                vChecks.emplace_back(--total);
+        size_t COUNT = 100000;
+        size_t total = COUNT;
+        {
+            CCheckQueueControl<UniqueCheck> control(queue.get());
+            while (total) {
+                size_t r = InsecureRandRange(10);
+                std::vector<UniqueCheck> vChecks;
+                for (size_t k = 0; k < r && total; k++) {
+                    vChecks.emplace_back(--total);
+                }
+                control.Add(vChecks);
             }
-            control.Add(vChecks);
         }
+        bool r = true;
+        BOOST_REQUIRE_EQUAL(UniqueCheck::results.size(), COUNT);
+        for (size_t i = 0; i < COUNT; ++i) {
+            r = r && UniqueCheck::results.count(i) == 1;
+        }
+        BOOST_REQUIRE(r);
+        queue->StopWorkerThreads();
     }
-    bool r = true;
-    BOOST_REQUIRE_EQUAL(UniqueCheck::results.size(), COUNT);
-    for (size_t i = 0; i < COUNT; ++i) {
-        r = r && UniqueCheck::results.count(i) == 1;
-    }
-    BOOST_REQUIRE(r);
-    queue->StopWorkerThreads();
 }
 
 // Test that blocks which might allocate lots of memory free their memory
@@ -268,68 +341,72 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_UniqueCheck) {
 // checks might mean leaving a check un-swapped out, and decreasing by 1 each
 // time could leave the data hanging across a sequence of blocks.
 BOOST_AUTO_TEST_CASE(test_CheckQueue_Memory) {
-    auto queue = std::make_unique<Memory_Queue>(QUEUE_BATCH_SIZE);
-    queue->StartWorkerThreads(SCRIPT_CHECK_THREADS);
-    for (size_t i = 0; i < 1000; ++i) {
-        size_t total = i;
-        {
-            CCheckQueueControl<MemoryCheck> control(queue.get());
-            while (total) {
-                size_t r = InsecureRandRange(10);
-                std::vector<MemoryCheck> vChecks;
-                for (size_t k = 0; k < r && total; k++) {
-                    total--;
-                    // Each iteration leaves data at the front, back, and middle
-                    // to catch any sort of deallocation failure
-                    vChecks.emplace_back(total == 0 || total == i ||
-                                         total == i / 2);
+    for (const bool work_stealing : {false, true}) {
+        auto queue = std::make_unique<Memory_Queue>(QUEUE_BATCH_SIZE);
+        queue->StartWorkerThreads(SCRIPT_CHECK_THREADS, work_stealing);
+        for (size_t i = 0; i < 1000; ++i) {
+            size_t total = i;
+            {
+                CCheckQueueControl<MemoryCheck> control(queue.get());
+                while (total) {
+                    size_t r = InsecureRandRange(10);
+                    std::vector<MemoryCheck> vChecks;
+                    for (size_t k = 0; k < r && total; k++) {
+                        total--;
+                        // Each iteration leaves data at the front, back, and middle
+                        // to catch any sort of deallocation failure
+                        vChecks.emplace_back(total == 0 || total == i ||
+                                             total == i / 2);
+                    }
+                    control.Add(vChecks);
                 }
-                control.Add(vChecks);
             }
+            BOOST_REQUIRE_EQUAL(MemoryCheck::fake_allocated_memory, 0U);
         }
-        BOOST_REQUIRE_EQUAL(MemoryCheck::fake_allocated_memory, 0U);
+        queue->StopWorkerThreads();
     }
-    queue->StopWorkerThreads();
 }
 
 // Test that a new verification cannot occur until all checks
 // have been destructed
 BOOST_AUTO_TEST_CASE(test_CheckQueue_FrozenCleanup) {
-    auto queue = std::make_unique<FrozenCleanup_Queue>(QUEUE_BATCH_SIZE);
-    bool fails = false;
-    queue->StartWorkerThreads(SCRIPT_CHECK_THREADS);
-    std::thread t0([&]() {
-        CCheckQueueControl<FrozenCleanupCheck> control(queue.get());
-        std::vector<FrozenCleanupCheck> vChecks(1);
-        // Freezing can't be the default initialized behavior given how the
-        // queue
-        // swaps in default initialized Checks (otherwise freezing destructor
-        // would get called twice).
-        vChecks[0].should_freeze = true;
-        control.Add(vChecks);
-        BOOST_CHECK(control.Wait()); // Hangs here
-    });
-    {
-        std::unique_lock<std::mutex> l(FrozenCleanupCheck::m);
-        // Wait until the queue has finished all jobs and frozen
-        FrozenCleanupCheck::cv.wait(
-            l, []() { return FrozenCleanupCheck::nFrozen == 1; });
-    }
-    // Try to get control of the queue a bunch of times
-    for (auto x = 0; x < 100 && !fails; ++x) {
-        fails = queue->m_control_mutex.try_lock();
-    }
-    {
-        // Unfreeze (we need lock n case of spurious wakeup)
-        std::unique_lock<std::mutex> l(FrozenCleanupCheck::m);
-        FrozenCleanupCheck::nFrozen = 0;
+    for (const bool work_stealing : {false, true}) {
+        auto queue = std::make_unique<FrozenCleanup_Queue>(QUEUE_BATCH_SIZE);
+        bool fails = false;
+        queue->StartWorkerThreads(SCRIPT_CHECK_THREADS, work_stealing);
+        std::thread t0([&]() {
+            CCheckQueueControl<FrozenCleanupCheck> control(queue.get());
+            std::vector<FrozenCleanupCheck> vChecks(1);
+            // Freezing can't be the default initialized behavior given how the
+            // queue
+            // swaps in default initialized Checks (otherwise freezing destructor
+            // would get called twice).
+            vChecks[0].should_freeze = true;
+            control.Add(vChecks);
+            BOOST_CHECK(control.Wait()); // Hangs here
+        });
+        {
+            std::unique_lock<std::mutex> l(FrozenCleanupCheck::m);
+            // Wait until the queue has finished all jobs and frozen
+            FrozenCleanupCheck::cv.wait(
+                l, []() { return FrozenCleanupCheck::nFrozen == 1; });
+        }
+        // Try to get control of the queue a bunch of times
+        for (auto x = 0; x < 100 && !fails; ++x) {
+            fails = queue->m_control_mutex.try_lock();
+        }
+        {
+            // Unfreeze (we need lock n case of spurious wakeup)
+            std::unique_lock<std::mutex> l(FrozenCleanupCheck::m);
+            FrozenCleanupCheck::nFrozen = 0;
+        }
+        // Awaken frozen destructor
+        FrozenCleanupCheck::cv.notify_one();
+        // Wait for control to finish
+        t0.join();
+        BOOST_REQUIRE(!fails);
+        queue->StopWorkerThreads();
     }
-    // Awaken frozen destructor
-    FrozenCleanupCheck::cv.notify_one();
-    // Wait for control to finish
-    t0.join();
-    BOOST_REQUIRE(!fails);
-    queue->StopWorkerThreads();
 }
 
 /** Test that CCheckQueueControl is threadsafe */
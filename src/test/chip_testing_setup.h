@@ -13,6 +13,7 @@
 
 #include <map>
 #include <string>
+#include <unordered_map>
 
 /// Testing setup that:
 /// - loads all of the json data for all of the "chip" tests into a static structure (lazy load, upon first use)
@@ -72,7 +73,7 @@ class ChipTestingSetup : public TestChain100Setup {
             std::string scriptAsm;
             CTransactionRef tx;
             size_t txSize{};
-            CCoinsMap inputCoins;
+            std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> inputCoins;
             std::string standardReason; //! Expected failure reason when validated in standard mode
             std::string nonstandardReason; //! Expected failure reason when validated in nonstandard mode
             std::string libauthStandardReason; //! Libauth suggested failure reason when validated in standard mode
@@ -9,6 +9,7 @@
 #include <consensus/validation.h>
 #include <script/standard.h>
 #include <streams.h>
+#include <txdb.h>
 #include <undo.h>
 #include <util/strencodings.h>
 #include <validation.h>
@@ -17,6 +18,7 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <limits>
 #include <map>
 #include <vector>
 
@@ -624,7 +626,8 @@ void GetCoinMapEntry(const CCoinsMap &map, Amount &value, char &flags) {
 }
 
 void WriteCoinViewEntry(CCoinsView &view, const Amount value, char flags) {
-    CCoinsMap map;
+    CCoinsMapMemoryResource resource;
+    CCoinsMap map{0, CCoinsMap::hasher{}, CCoinsMap::key_equal{}, &resource};
     InsertCoinMapEntry(map, value, flags);
     BOOST_CHECK(view.BatchWrite(map, BlockHash()));
 }
@@ -911,4 +914,176 @@ BOOST_AUTO_TEST_CASE(coin_write) {
     }
 }
 
+static void CheckEmplaceFetchedCoin(Amount base_value, Amount cache_value,
+                                    Amount expected_value, char cache_flags,
+                                    char expected_flags) {
+    SingleEntryCacheTest test(base_value, cache_value, cache_flags);
+
+    // Peeking must never pull the coin from the base view.
+    const Coin *peeked = test.cache.PeekCoinInCache(OUTPOINT);
+    BOOST_CHECK_EQUAL(peeked == nullptr, cache_value == ABSENT);
+    if (peeked) {
+        BOOST_CHECK_EQUAL(peeked->IsSpent(), cache_value == PRUNED);
+    }
+
+    CTxOut output;
+    output.nValue = VALUE3;
+    test.cache.EmplaceFetchedCoin(OUTPOINT, Coin(std::move(output), 1, false));
+    test.cache.SelfTest();
+
+    Amount result_value;
+    char result_flags;
+    GetCoinMapEntry(test.cache.map(), result_value, result_flags);
+    BOOST_CHECK_EQUAL(result_value, expected_value);
+    BOOST_CHECK_EQUAL(result_flags, expected_flags);
+}
+
+BOOST_AUTO_TEST_CASE(coin_emplace_fetched) {
+    /**
+     * Check EmplaceFetchedCoin behavior, inserting a coin obtained out of band
+     * from the base view into the cache, and checking the resulting entry in
+     * the cache. Existing entries must be left untouched, whatever their
+     * state, and the base view must not be consulted.
+     */
+    for (const Amount &base_value : {ABSENT, PRUNED, VALUE1}) {
+        CheckEmplaceFetchedCoin(base_value, ABSENT, VALUE3, NO_ENTRY, 0);
+        for (const Amount &cache_value : {PRUNED, VALUE2}) {
+            for (const char cache_flags : FLAGS) {
+                CheckEmplaceFetchedCoin(base_value, cache_value, cache_value,
+                                        cache_flags, cache_flags);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(coin_take_dirty) {
+    /**
+     * Check that TakeDirtyCoins hands out each modified coin once, spent ones
+     * included, in chunks bounded by maxCoins and maxScan, and leaves the
+     * entries in the cache as clean ones.
+     */
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+    std::map<COutPoint, Coin> expected;
+    for (uint32_t i = 0; i < 1000; ++i) {
+        const COutPoint outpoint(TxId(InsecureRand256()), i);
+        Coin coin(CTxOut(int64_t(1 + i) * SATOSHI, CScript()), 1, false);
+        if (i % 4 == 0) {
+            // Clean entries are left alone.
+            cache.EmplaceFetchedCoin(outpoint, std::move(coin));
+            continue;
+        }
+        cache.AddCoin(outpoint, coin, false);
+        if (i % 4 == 1) {
+            // A fresh coin which is spent is simply dropped from the cache.
+            BOOST_CHECK(cache.SpendCoin(outpoint));
+            continue;
+        }
+        expected[outpoint] = std::move(coin);
+    }
+    // Spends of coins which are not fresh must be written.
+    for (auto &[outpoint, entry] : cache.map()) {
+        if (entry.flags & CCoinsCacheEntry::FRESH && outpoint.GetN() % 4 == 3) {
+            entry.flags = CCoinsCacheEntry::DIRTY;
+            BOOST_CHECK(cache.SpendCoin(outpoint));
+            expected[outpoint].Clear();
+        }
+    }
+
+    std::vector<std::pair<COutPoint, Coin>> coins;
+    size_t cursor = 0;
+    size_t nChunks = 0;
+    bool fDone = false;
+    while (!fDone) {
+        const size_t nTaken = coins.size();
+        fDone = cache.TakeDirtyCoins(coins, cursor, 10, 100);
+        BOOST_CHECK_LE(coins.size() - nTaken, 10 + 100);
+        ++nChunks;
+    }
+    BOOST_CHECK_GT(nChunks, 1U);
+    BOOST_CHECK_EQUAL(cursor, 0U);
+    BOOST_CHECK_EQUAL(coins.size(), expected.size());
+    for (const auto &[outpoint, coin] : coins) {
+        BOOST_CHECK(coin == expected.at(outpoint));
+    }
+    for (const auto &[outpoint, entry] : cache.map()) {
+        BOOST_CHECK_EQUAL(entry.flags, 0);
+    }
+    cache.SelfTest();
+
+    // Nothing is left to take.
+    coins.clear();
+    BOOST_CHECK(cache.TakeDirtyCoins(coins, cursor, 10,
+                                     std::numeric_limits<size_t>::max()));
+    BOOST_CHECK(coins.empty());
+}
+
+BOOST_AUTO_TEST_CASE(coins_db_batch_write) {
+    /**
+     * Check that the changes flushed to the coins database, which are written
+     * in key order over several batches, all make it there, whether through
+     * BatchWrite or WriteCoinsChunk.
+     */
+    gArgs.ForceSetArg("-dbbatchsize", "1000");
+    CCoinsViewDB db(1 << 20, true);
+    std::map<COutPoint, Coin> expected;
+    const auto randomCoin = [] {
+        return Coin(CTxOut(int64_t(1 + InsecureRandRange(1000)) * SATOSHI,
+                           CScript() << ToByteVector(InsecureRand256())),
+                    1 + InsecureRandRange(100), InsecureRandBool());
+    };
+
+    const BlockHash hash1(InsecureRand256());
+    {
+        CCoinsViewCache cache(&db);
+        for (uint32_t i = 0; i < 500; ++i) {
+            const COutPoint outpoint(TxId(InsecureRand256()), i % 3);
+            const Coin coin = randomCoin();
+            cache.AddCoin(outpoint, coin, false);
+            expected[outpoint] = coin;
+        }
+        cache.SetBestBlock(hash1);
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK(db.GetBestBlock() == hash1);
+
+    // Spend some coins and add others, in chunks.
+    const BlockHash hash2(InsecureRand256());
+    std::vector<std::pair<COutPoint, Coin>> changes;
+    for (auto it = expected.begin(); it != expected.end();) {
+        if (InsecureRandBool()) {
+            changes.emplace_back(it->first, Coin());
+            it = expected.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (uint32_t i = 0; i < 100; ++i) {
+        const COutPoint outpoint(TxId(InsecureRand256()), i);
+        changes.emplace_back(outpoint, randomCoin());
+        expected[outpoint] = changes.back().second;
+    }
+    Shuffle(changes.begin(), changes.end(), g_insecure_rand_ctx);
+    const size_t half = changes.size() / 2;
+    BOOST_CHECK(db.WriteCoinsChunk(
+        {changes.begin(), changes.begin() + half}, hash2, false));
+    BOOST_CHECK(db.GetBestBlock().IsNull());
+    BOOST_CHECK(db.WriteCoinsChunk({changes.begin() + half, changes.end()},
+                                   hash2, true));
+    BOOST_CHECK(db.GetBestBlock() == hash2);
+    db.Compact();
+
+    std::unique_ptr<CCoinsViewCursor> pcursor(db.Cursor());
+    size_t nCoins = 0;
+    for (; pcursor->Valid(); pcursor->Next(), ++nCoins) {
+        COutPoint outpoint;
+        Coin coin;
+        BOOST_REQUIRE(pcursor->GetKey(outpoint) && pcursor->GetValue(coin));
+        BOOST_REQUIRE(expected.count(outpoint));
+        BOOST_CHECK(coin == expected.at(outpoint));
+    }
+    BOOST_CHECK_EQUAL(nCoins, expected.size());
+    gArgs.ForceSetArg("-dbbatchsize", std::to_string(nDefaultDbBatchSize));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -84,6 +84,46 @@ BOOST_AUTO_TEST_CASE(dbwrapper_batch) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_tuning) {
+    // A small write buffer and small files, so that the writes below go
+    // through several files and compactions.
+    DBTuning tuning;
+    tuning.write_buffer_size = 64 << 10;
+    tuning.max_file_size = 64 << 10;
+    fs::path ph = SetDataDir("dbwrapper_tuning");
+    CDBWrapper dbw(ph, (1 << 20), true, false, true, tuning);
+
+    std::vector<uint256> values;
+    for (uint32_t i = 0; i < 4; ++i) {
+        CDBBatch batch(dbw);
+        for (uint32_t j = 0; j < 1000; ++j) {
+            values.push_back(InsecureRand256());
+            batch.Write(std::make_pair('k', i * 1000 + j), values.back());
+        }
+        BOOST_CHECK(dbw.WriteBatch(batch));
+    }
+    // Overwrite and erase some of them.
+    for (uint32_t i = 0; i < values.size(); i += 3) {
+        if (i % 2) {
+            BOOST_CHECK(dbw.Erase(std::make_pair('k', i)));
+            values[i].SetNull();
+        } else {
+            values[i] = InsecureRand256();
+            BOOST_CHECK(dbw.Write(std::make_pair('k', i), values[i]));
+        }
+    }
+
+    dbw.CompactFull();
+    for (uint32_t i = 0; i < values.size(); ++i) {
+        uint256 res;
+        BOOST_CHECK_EQUAL(dbw.Read(std::make_pair('k', i), res),
+                          !values[i].IsNull());
+        if (!values[i].IsNull()) {
+            BOOST_CHECK_EQUAL(res.ToString(), values[i].ToString());
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(dbwrapper_iterator) {
     // Perform tests both obfuscated and non-obfuscated.
     for (const bool obfuscate : {false, true}) {
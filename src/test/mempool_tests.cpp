@@ -104,6 +104,134 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest) {
     BOOST_CHECK_EQUAL(testPool.size(), 0UL);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolLinksTest) {
+    // The parents and children of an entry are kept sorted by entry id, also
+    // once there are more of them than fit inline.
+    TestMemPoolEntryHelper entry;
+    CMutableTransaction txParent;
+    txParent.vin.resize(1);
+    txParent.vin[0].scriptSig = CScript() << OP_11;
+    txParent.vout.resize(6);
+    for (auto &out : txParent.vout) {
+        out.scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        out.nValue = 10000 * SATOSHI;
+    }
+    std::vector<CMutableTransaction> txChildren(txParent.vout.size());
+    for (size_t i = 0; i < txChildren.size(); ++i) {
+        txChildren[i].vin.resize(1);
+        txChildren[i].vin[0].scriptSig = CScript() << OP_11;
+        txChildren[i].vin[0].prevout = COutPoint(txParent.GetId(), i);
+        txChildren[i].vout.resize(1);
+        txChildren[i].vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        txChildren[i].vout[0].nValue = 9000 * SATOSHI;
+    }
+    // Spends every child.
+    CMutableTransaction txGrandChild;
+    for (const auto &txChild : txChildren) {
+        txGrandChild.vin.emplace_back(COutPoint(txChild.GetId(), 0));
+        txGrandChild.vin.back().scriptSig = CScript() << OP_11;
+    }
+    txGrandChild.vout.resize(1);
+    txGrandChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txGrandChild.vout[0].nValue = 50000 * SATOSHI;
+
+    CTxMemPool testPool;
+    LOCK2(cs_main, testPool.cs);
+    testPool.addUnchecked(entry.FromTx(txParent));
+    for (const auto &txChild : txChildren) {
+        testPool.addUnchecked(entry.FromTx(txChild));
+    }
+    testPool.addUnchecked(entry.FromTx(txGrandChild));
+
+    auto isSorted = [](const CTxMemPool::linkedEntries &links) {
+        return std::is_sorted(links.begin(), links.end(),
+                              CTxMemPool::CompareIteratorByEntryId());
+    };
+    const auto parentIt = *testPool.GetIter(txParent.GetId());
+    const auto grandChildIt = *testPool.GetIter(txGrandChild.GetId());
+    BOOST_CHECK_EQUAL(testPool.GetMemPoolChildren(parentIt).size(), 6U);
+    BOOST_CHECK(isSorted(testPool.GetMemPoolChildren(parentIt)));
+    BOOST_CHECK_EQUAL(testPool.GetMemPoolParents(grandChildIt).size(), 6U);
+    BOOST_CHECK(isSorted(testPool.GetMemPoolParents(grandChildIt)));
+
+    // Removing a child also removes the grandchild, and unlinks both from the
+    // entries which stay.
+    testPool.removeRecursive(CTransaction(txChildren[3]));
+    BOOST_CHECK_EQUAL(testPool.size(), 6U);
+    BOOST_CHECK_EQUAL(testPool.GetMemPoolChildren(parentIt).size(), 5U);
+    BOOST_CHECK(isSorted(testPool.GetMemPoolChildren(parentIt)));
+    for (size_t i = 0; i < txChildren.size(); ++i) {
+        if (i == 3) {
+            continue;
+        }
+        const auto childIt = *testPool.GetIter(txChildren[i].GetId());
+        BOOST_CHECK(testPool.GetMemPoolChildren(childIt).empty());
+        BOOST_CHECK(testPool.GetMemPoolParents(childIt) ==
+                    CTxMemPool::linkedEntries(1, parentIt));
+    }
+
+    testPool.removeRecursive(CTransaction(txParent));
+    BOOST_CHECK_EQUAL(testPool.size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolRemoveForBlockTest) {
+    // A block confirming part of a chain, and conflicting with another chain.
+    TestMemPoolEntryHelper entry;
+    auto makeTx = [](const std::vector<COutPoint> &prevouts, size_t nOutputs) {
+        CMutableTransaction mtx;
+        for (const COutPoint &prevout : prevouts) {
+            mtx.vin.emplace_back(prevout);
+            mtx.vin.back().scriptSig = CScript() << OP_11;
+        }
+        mtx.vout.resize(nOutputs);
+        for (auto &out : mtx.vout) {
+            out.scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+            out.nValue = 10000 * SATOSHI;
+        }
+        return MakeTransactionRef(mtx);
+    };
+    const COutPoint coin1(TxId(InsecureRand256()), 0);
+    const COutPoint coin2(TxId(InsecureRand256()), 0);
+    const CTransactionRef txParent = makeTx({coin1}, 2);
+    const CTransactionRef txChild1 = makeTx({COutPoint(txParent->GetId(), 0)}, 1);
+    const CTransactionRef txGrandChild = makeTx({COutPoint(txChild1->GetId(), 0)}, 1);
+    const CTransactionRef txChild2 = makeTx({COutPoint(txParent->GetId(), 1)}, 1);
+    const CTransactionRef txConflict = makeTx({coin2}, 1);
+    const CTransactionRef txConflictChild = makeTx({COutPoint(txConflict->GetId(), 0)}, 1);
+    // Spends coin2 too, but differently from txConflict.
+    const CTransactionRef txSpend2 = makeTx({coin2}, 2);
+
+    CTxMemPool testPool;
+    LOCK2(cs_main, testPool.cs);
+    for (const auto &tx : {txParent, txChild1, txGrandChild, txChild2, txConflict, txConflictChild}) {
+        testPool.addUnchecked(entry.FromTx(tx));
+    }
+    testPool.PrioritiseTransaction(txChild1->GetId(), 100 * SATOSHI);
+    testPool.PrioritiseTransaction(txConflict->GetId(), 100 * SATOSHI);
+    testPool.PrioritiseTransaction(txGrandChild->GetId(), 100 * SATOSHI);
+
+    // The block lists its transactions in canonical order, not topologically.
+    std::vector<CTransactionRef> vtx{txParent, txChild1, txSpend2};
+    std::sort(vtx.begin(), vtx.end(), [](const auto &a, const auto &b) { return a->GetId() < b->GetId(); });
+    testPool.removeForBlock(vtx);
+
+    BOOST_CHECK_EQUAL(testPool.size(), 2U);
+    BOOST_CHECK(testPool.exists(txGrandChild->GetId()));
+    BOOST_CHECK(testPool.exists(txChild2->GetId()));
+    for (const auto &tx : {txGrandChild, txChild2}) {
+        const auto it = *testPool.GetIter(tx->GetId());
+        BOOST_CHECK(testPool.GetMemPoolParents(it).empty());
+        BOOST_CHECK(testPool.GetMemPoolChildren(it).empty());
+    }
+
+    // The prioritisations of the confirmed and conflicting transactions go.
+    for (const auto &tx : {txChild1, txConflict, txGrandChild}) {
+        Amount delta = Amount::zero();
+        testPool.ApplyDelta(tx->GetId(), delta);
+        BOOST_CHECK_EQUAL(delta, tx == txGrandChild ? 100 * SATOSHI : Amount::zero());
+    }
+}
+
 BOOST_AUTO_TEST_CASE(MempoolClearTest) {
     // Test CTxMemPool::clear functionality
 
@@ -140,6 +268,64 @@ BOOST_AUTO_TEST_CASE(MempoolClearTest) {
     BOOST_CHECK_EQUAL(testPool.GetIndex().size(), 0UL);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolSnapshotTest) {
+    TestMemPoolEntryHelper entry;
+    CMutableTransaction txParent;
+    txParent.vin.resize(1);
+    txParent.vin[0].scriptSig = CScript() << OP_11;
+    txParent.vout.resize(1);
+    txParent.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txParent.vout[0].nValue = 33000 * SATOSHI;
+    CMutableTransaction txChild;
+    txChild.vin.resize(1);
+    txChild.vin[0].scriptSig = CScript() << OP_11;
+    txChild.vin[0].prevout = COutPoint(txParent.GetId(), 0);
+    txChild.vout.resize(1);
+    txChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txChild.vout[0].nValue = 32000 * SATOSHI;
+
+    CTxMemPool testPool;
+    const auto empty = testPool.GetSnapshot();
+    BOOST_CHECK(empty->entries.empty());
+
+    {
+        LOCK2(cs_main, testPool.cs);
+        testPool.addUnchecked(entry.Fee(1000 * SATOSHI).FromTx(txParent));
+        testPool.addUnchecked(entry.Fee(2000 * SATOSHI).FromTx(txChild));
+    }
+    const auto snapshot = testPool.GetSnapshot();
+    BOOST_CHECK(snapshot != empty);
+    BOOST_CHECK(empty->entries.empty());
+    BOOST_REQUIRE_EQUAL(snapshot->entries.size(), 2UL);
+    BOOST_CHECK_EQUAL(snapshot->nTransactionsUpdated,
+                      testPool.GetTransactionsUpdated());
+    const MempoolSnapshot::Entry &parent = snapshot->entries[0];
+    const MempoolSnapshot::Entry &child = snapshot->entries[1];
+    BOOST_CHECK(parent.info.tx->GetId() == txParent.GetId());
+    BOOST_CHECK_EQUAL(parent.nFee, 1000 * SATOSHI);
+    BOOST_CHECK(parent.parents.empty());
+    BOOST_CHECK(parent.children == std::vector<TxId>{txChild.GetId()});
+    BOOST_CHECK(child.info.tx->GetId() == txChild.GetId());
+    BOOST_CHECK(child.parents == std::vector<TxId>{txParent.GetId()});
+    BOOST_CHECK(child.children.empty());
+
+    // It is shared until the mempool changes.
+    BOOST_CHECK(testPool.GetSnapshot() == snapshot);
+    testPool.PrioritiseTransaction(txChild.GetId(), 500 * SATOSHI);
+    const auto prioritised = testPool.GetSnapshot();
+    BOOST_CHECK(prioritised != snapshot);
+    BOOST_CHECK_EQUAL(prioritised->entries[1].GetModifiedFee(),
+                      2500 * SATOSHI);
+    BOOST_CHECK_EQUAL(snapshot->entries[1].GetModifiedFee(), 2000 * SATOSHI);
+
+    testPool.removeRecursive(CTransaction(txParent));
+    BOOST_CHECK(testPool.GetSnapshot()->entries.empty());
+    BOOST_CHECK_EQUAL(prioritised->entries.size(), 2UL);
+    std::vector<uint256> vtxid;
+    testPool.queryHashes(vtxid);
+    BOOST_CHECK(vtxid.empty());
+}
+
 template <typename name>
 static void CheckSort(CTxMemPool &pool, std::vector<std::string> &sortedOrder,
                       const std::string &testcase)
@@ -519,7 +705,7 @@ struct TestMemPoolWithAncestryChecker : CTxMemPool
             if (!counted.insert(candidate).second) {
                 continue;
             }
-            const setEntries &parents = GetMemPoolParents(candidate);
+            const linkedEntries &parents = GetMemPoolParents(candidate);
             if (parents.size() == 0) {
                 setEntries descendants;
                 CalculateDescendants(candidate, descendants);
@@ -26,8 +26,11 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
 #include <memory>
 #include <optional>
+#include <set>
+#include <tuple>
 
 BOOST_FIXTURE_TEST_SUITE(miner_tests, TestingSetup)
 
@@ -166,6 +169,235 @@ static void TestPackageSelection(const Config &config,
     }
 }
 
+// Test suite for the incremental updates of a block template, which must give
+// the same block as making it anew. Like TestPackageSelection, reuses the
+// blockchain created in CreateNewBlock_validity.
+static void TestIncrementalUpdate(const Config &config,
+                                  const CScript &scriptPubKey,
+                                  const std::vector<CTransactionRef> &txFirst)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main, ::g_mempool.cs) {
+    TestMemPoolEntryHelper entry;
+    IncrementalBlockAssembler assembler(config, g_mempool);
+
+    std::unique_ptr<CBlockTemplate> pblocktemplate =
+        assembler.CreateNewBlock(scriptPubKey);
+    BOOST_REQUIRE(pblocktemplate);
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 1UL);
+
+    auto CheckUpdate = [&](size_t nTx) EXCLUSIVE_LOCKS_REQUIRED(cs_main, ::g_mempool.cs) {
+        BOOST_REQUIRE(assembler.UpdateBlock(pblocktemplate, true));
+        const std::unique_ptr<CBlockTemplate> pexpected =
+            BlockAssembler(config, g_mempool).CreateNewBlock(scriptPubKey);
+        const CBlock &block = pblocktemplate->block;
+        const CBlock &expected = pexpected->block;
+        BOOST_REQUIRE_EQUAL(block.vtx.size(), nTx);
+        BOOST_REQUIRE_EQUAL(expected.vtx.size(), nTx);
+        // Without CTOR, the new transactions come after the others rather
+        // than by feerate, which is just as valid.
+        auto SortedEntries = [](const CBlockTemplate &t) {
+            std::vector<std::tuple<TxId, Amount, int64_t>> ret;
+            for (size_t i = 1; i < t.entries.size(); ++i) {
+                ret.emplace_back(t.entries[i].tx->GetId(), t.entries[i].fees,
+                                 t.entries[i].sigChecks);
+            }
+            std::sort(ret.begin(), ret.end());
+            return ret;
+        };
+        BOOST_CHECK(SortedEntries(*pblocktemplate) == SortedEntries(*pexpected));
+        BOOST_CHECK_EQUAL(block.vtx[0]->GetValueOut(),
+                          expected.vtx[0]->GetValueOut());
+        BOOST_CHECK_EQUAL(pblocktemplate->entries[0].fees,
+                          pexpected->entries[0].fees);
+        BOOST_CHECK(block.hashPrevBlock == expected.hashPrevBlock);
+    };
+
+    // A parent, and a child paying more, come in the same update.
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vin[0].prevout = COutPoint(txFirst[2]->GetId(), 0);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = int64_t(5000000000LL - 10000) * SATOSHI;
+    const CTransaction parentTx(tx);
+    g_mempool.addUnchecked(entry.Fee(10000 * SATOSHI)
+                               .Time(GetTime())
+                               .SpendsCoinbase(true)
+                               .FromTx(tx));
+    tx.vin[0].prevout = COutPoint(parentTx.GetId(), 0);
+    tx.vout[0].nValue = int64_t(5000000000LL - 10000 - 20000) * SATOSHI;
+    const TxId childTxId = tx.GetId();
+    g_mempool.addUnchecked(entry.Fee(20000 * SATOSHI).SpendsCoinbase(false).FromTx(tx));
+
+    // A free transaction is left out...
+    tx.vin[0].prevout = COutPoint(txFirst[3]->GetId(), 0);
+    tx.vout[0].nValue = int64_t(5000000000LL) * SATOSHI;
+    const TxId freeTxId = tx.GetId();
+    g_mempool.addUnchecked(entry.Fee(Amount::zero()).SpendsCoinbase(true).FromTx(tx));
+    CheckUpdate(3);
+    BOOST_CHECK(std::none_of(pblocktemplate->block.vtx.begin(), pblocktemplate->block.vtx.end(),
+                             [&](const CTransactionRef &ptx) { return ptx->GetId() == freeTxId; }));
+
+    // ... until it is prioritised.
+    g_mempool.PrioritiseTransaction(freeTxId, COIN);
+    CheckUpdate(4);
+
+    // Taking out the parent takes out the child too.
+    g_mempool.removeRecursive(parentTx, MemPoolRemovalReason::CONFLICT);
+    BOOST_CHECK(!g_mempool.exists(childTxId));
+    CheckUpdate(2);
+
+    // Deprioritising the free transaction takes it out again.
+    g_mempool.PrioritiseTransaction(freeTxId, -1 * COIN);
+    CheckUpdate(1);
+    // Nothing changed since.
+    CheckUpdate(1);
+
+    // Only the last block made by the assembler can be updated.
+    std::unique_ptr<CBlockTemplate> pother =
+        BlockAssembler(config, g_mempool).CreateNewBlock(scriptPubKey);
+    BOOST_CHECK(!assembler.UpdateBlock(pother, true));
+
+    g_mempool.ClearPrioritisation(freeTxId);
+    g_mempool.clear();
+}
+
+// Test suite for the checks of block templates which only check their new
+// transactions in full. Like TestPackageSelection, reuses the blockchain
+// created in CreateNewBlock_validity.
+static void TestTemplateValidityCache(const Config &config,
+                                      const CScript &scriptPubKey,
+                                      const std::vector<CTransactionRef> &txFirst)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main, ::g_mempool.cs) {
+    const CChainParams &chainparams = config.GetChainParams();
+    const BlockValidationOptions validationOptions =
+        BlockValidationOptions(config).withCheckPoW(false).withCheckMerkleRoot(false);
+    TestMemPoolEntryHelper entry;
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vin[0].prevout = COutPoint(txFirst[2]->GetId(), 0);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = int64_t(5000000000LL - 10000) * SATOSHI;
+    const CTransactionRef spendTx = MakeTransactionRef(tx);
+    g_mempool.addUnchecked(entry.Fee(10000 * SATOSHI)
+                               .Time(GetTime())
+                               .SpendsCoinbase(true)
+                               .FromTx(tx));
+    tx.vin[0].prevout = COutPoint(txFirst[3]->GetId(), 0);
+    g_mempool.addUnchecked(entry.Fee(10000 * SATOSHI).FromTx(tx));
+
+    const std::unique_ptr<CBlockTemplate> pblocktemplate =
+        BlockAssembler(config, g_mempool).CreateNewBlock(scriptPubKey, 0, false);
+    CBlock &block = pblocktemplate->block;
+    BOOST_REQUIRE_EQUAL(block.vtx.size(), 3UL);
+
+    // All the transactions are new at first, and none of them the next time.
+    // The script checks of the new ones are set up ahead of time from the
+    // coins kept by the cache.
+    BlockTemplateValidityCache cache;
+    CValidationState state;
+    uint64_t nPrecomputedBefore = nBlockTxsPrecomputed;
+    BOOST_CHECK(TestBlockValidity(state, chainparams, block, ::ChainActive().Tip(), validationOptions, &cache));
+    BOOST_CHECK_EQUAL(cache.nLastNewTxs, 2U);
+    BOOST_CHECK_EQUAL(nBlockTxsPrecomputed - nPrecomputedBefore, 2U);
+    BOOST_CHECK_EQUAL(cache.checkedTxs.size(), 2U);
+    BOOST_CHECK(TestBlockValidity(state, chainparams, block, ::ChainActive().Tip(), validationOptions, &cache));
+    BOOST_CHECK_EQUAL(cache.nLastNewTxs, 0U);
+
+    // A new transaction double spending one checked before is still caught.
+    tx.vin[0].prevout = COutPoint(txFirst[2]->GetId(), 0);
+    tx.vout[0].nValue = int64_t(5000000000LL - 20000) * SATOSHI;
+    block.vtx.push_back(MakeTransactionRef(tx));
+    std::sort(block.vtx.begin() + 1, block.vtx.end(),
+              [](const CTransactionRef &a, const CTransactionRef &b) { return a->GetId() < b->GetId(); });
+    BOOST_CHECK(!TestBlockValidity(state, chainparams, block, ::ChainActive().Tip(), validationOptions, &cache));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "bad-txns-inputs-missingorspent");
+
+    // The failed check does not change what was checked before.
+    BOOST_CHECK_EQUAL(cache.checkedTxs.size(), 2U);
+    BOOST_CHECK(cache.checkedTxs.count(spendTx->GetId()));
+
+    g_mempool.clear();
+}
+
+// Test suite for -blockpackageselection. Like TestPackageSelection, reuses the
+// blockchain created in CreateNewBlock_validity.
+static void TestPackageFeeSelection(const Config &config,
+                                    const CScript &scriptPubKey,
+                                    const std::vector<CTransactionRef> &txFirst)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main, ::g_mempool.cs) {
+    TestMemPoolEntryHelper entry;
+
+    // The transactions below all have the same size, and the block only has
+    // room for a few of them.
+    auto MakeTx = [](const COutPoint &prevout, Amount fee) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << OP_1;
+        tx.vin[0].prevout = prevout;
+        tx.vout.resize(1);
+        tx.vout[0].nValue = int64_t(5000000000LL) * SATOSHI - fee;
+        return MakeTransactionRef(tx);
+    };
+    // With nTxs zero, the block is only limited by sigchecks, with the
+    // limits of a 1MB block.
+    auto Assembler = [&](size_t nTxs, bool fPackageSelection) {
+        BlockAssembler::Options options;
+        if (nTxs) {
+            options.blockMinFeeRate = blockMinFeeRate;
+            options.nMaxGeneratedBlockSize = 1000 + nTxs * MakeTx(COutPoint(), Amount::zero())->GetTotalSize() + 1;
+        } else {
+            options.blockMinFeeRate = CFeeRate(Amount::zero());
+            options.nConsensusCurrentBlockSizeLimit = ONE_MEGABYTE;
+        }
+        options.fPackageSelection = fPackageSelection;
+        return BlockAssembler(config, g_mempool, options);
+    };
+    auto BlockTxIds = [&](size_t nTxs, bool fPackageSelection) {
+        std::set<TxId> ret;
+        const auto pblocktemplate = Assembler(nTxs, fPackageSelection).CreateNewBlock(scriptPubKey, 0, false);
+        for (size_t i = 1; i < pblocktemplate->block.vtx.size(); ++i) {
+            ret.insert(pblocktemplate->block.vtx[i]->GetId());
+        }
+        return ret;
+    };
+
+    // A child paying for its low fee parent goes in with it ahead of two
+    // transactions paying more than the parent but less than the two together.
+    const CTransactionRef parentTx = MakeTx(COutPoint(txFirst[0]->GetId(), 0), 1000 * SATOSHI);
+    const CTransactionRef childTx = MakeTx(COutPoint(parentTx->GetId(), 0), 50000 * SATOSHI);
+    const CTransactionRef mediumTx1 = MakeTx(COutPoint(txFirst[1]->GetId(), 0), 10000 * SATOSHI);
+    const CTransactionRef mediumTx2 = MakeTx(COutPoint(txFirst[2]->GetId(), 0), 9000 * SATOSHI);
+    g_mempool.addUnchecked(entry.Fee(1000 * SATOSHI).SpendsCoinbase(true).FromTx(parentTx));
+    g_mempool.addUnchecked(entry.Fee(50000 * SATOSHI).SpendsCoinbase(false).FromTx(childTx));
+    g_mempool.addUnchecked(entry.Fee(10000 * SATOSHI).SpendsCoinbase(true).FromTx(mediumTx1));
+    g_mempool.addUnchecked(entry.Fee(9000 * SATOSHI).FromTx(mediumTx2));
+
+    BOOST_CHECK((BlockTxIds(2, false) == std::set<TxId>{mediumTx1->GetId(), mediumTx2->GetId()}));
+    BOOST_CHECK((BlockTxIds(2, true) == std::set<TxId>{parentTx->GetId(), childTx->GetId()}));
+    // With room for everything, both give the same block.
+    BOOST_CHECK_EQUAL(BlockTxIds(10, false).size(), 4U);
+    BOOST_CHECK(BlockTxIds(10, true) == BlockTxIds(10, false));
+    g_mempool.clear();
+
+    // A transaction using most of the sigchecks of the block is left out for
+    // several paying less for each of their sigchecks, which fit in together.
+    const int64_t nMaxSigChecks = GetMaxBlockSigChecksCount(ONE_MEGABYTE);
+    const CTransactionRef heavyTx = MakeTx(COutPoint(txFirst[0]->GetId(), 0), 10000 * SATOSHI);
+    g_mempool.addUnchecked(entry.Fee(10000 * SATOSHI).SigChecks(nMaxSigChecks * 8 / 10).FromTx(heavyTx));
+    std::set<TxId> lightTxIds;
+    for (size_t i = 1; i < 4; ++i) {
+        const CTransactionRef lightTx = MakeTx(COutPoint(txFirst[i]->GetId(), 0), 4000 * SATOSHI);
+        g_mempool.addUnchecked(entry.Fee(4000 * SATOSHI).SigChecks(nMaxSigChecks * 8 / 30).FromTx(lightTx));
+        lightTxIds.insert(lightTx->GetId());
+    }
+
+    BOOST_CHECK(BlockTxIds(0, true) == lightTxIds);
+
+    g_mempool.clear();
+}
+
 static void TestCoinbaseMessageEB(uint64_t eb, const std::string &cbmsg) {
     GlobalConfig config;
     config.SetConfiguredMaxBlockSize(eb);
@@ -611,6 +843,10 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity) {
     g_mempool.clear();
 
     TestPackageSelection(config, scriptPubKey, txFirst);
+    g_mempool.clear();
+    TestIncrementalUpdate(config, scriptPubKey, txFirst);
+    TestTemplateValidityCache(config, scriptPubKey, txFirst);
+    TestPackageFeeSelection(config, scriptPubKey, txFirst);
 
     fCheckpointsEnabled = true;
 }
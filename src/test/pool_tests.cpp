@@ -0,0 +1,181 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coins.h>
+#include <memusage.h>
+#include <support/allocators/pool.h>
+
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Access to the internals of PoolResource, for testing.
+ */
+class PoolResourceTester {
+public:
+    /** Number of blocks of the given size in the freelists of the resource */
+    template <typename PoolResource>
+    static size_t FreeListSize(const PoolResource &resource, size_t bytes) {
+        size_t n = 0;
+        for (auto *node =
+                 resource.m_free_lists[resource.NumElemAlignBytes(bytes)];
+             node != nullptr; node = node->m_next) {
+            ++n;
+        }
+        return n;
+    }
+
+    /** Bytes still available in the last chunk of the resource */
+    template <typename PoolResource>
+    static size_t AvailableMemory(const PoolResource &resource) {
+        return resource.m_available_memory_end -
+               resource.m_available_memory_it;
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(pool_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(basic_allocating) {
+    auto resource = PoolResource<8, 8>(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    BOOST_CHECK_EQUAL(resource.ChunkSizeBytes(), 1024U);
+    BOOST_CHECK_EQUAL(PoolResourceTester::AvailableMemory(resource), 1024U);
+
+    // A block that fits is carved out of the chunk, and is given back to the
+    // freelist rather than to the system.
+    void *block = resource.Allocate(8, 8);
+    BOOST_CHECK_EQUAL(PoolResourceTester::AvailableMemory(resource), 1016U);
+    resource.Deallocate(block, 8, 8);
+    BOOST_CHECK_EQUAL(PoolResourceTester::FreeListSize(resource, 8), 1U);
+
+    // The freed block is reused by the next allocation of the same size.
+    void *reused = resource.Allocate(8, 8);
+    BOOST_CHECK_EQUAL(reused, block);
+    BOOST_CHECK_EQUAL(PoolResourceTester::FreeListSize(resource, 8), 0U);
+    BOOST_CHECK_EQUAL(PoolResourceTester::AvailableMemory(resource), 1016U);
+
+    // Blocks too large or too aligned for the pool go to operator new.
+    void *large = resource.Allocate(16, 8);
+    void *aligned = resource.Allocate(8, 16);
+    BOOST_CHECK_EQUAL(PoolResourceTester::AvailableMemory(resource), 1016U);
+    resource.Deallocate(large, 16, 8);
+    resource.Deallocate(aligned, 8, 16);
+    BOOST_CHECK_EQUAL(PoolResourceTester::FreeListSize(resource, 8), 0U);
+
+    // Running out of memory in the chunk allocates a new one.
+    std::vector<void *> blocks;
+    for (size_t i = 0; i < 1016 / 8 + 1; ++i) {
+        blocks.push_back(resource.Allocate(8, 8));
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+    for (void *p : blocks) {
+        resource.Deallocate(p, 8, 8);
+    }
+    resource.Deallocate(reused, 8, 8);
+    BOOST_CHECK_EQUAL(PoolResourceTester::FreeListSize(resource, 8),
+                      blocks.size() + 1);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(random_allocations) {
+    auto resource = PoolResource<128, 8>(65536);
+    struct Allocation {
+        uint8_t *ptr;
+        size_t bytes;
+        uint8_t fill;
+    };
+    std::vector<Allocation> allocations;
+    for (size_t i = 0; i < 10000; ++i) {
+        if (allocations.empty() || InsecureRandRange(3) != 0) {
+            const size_t bytes = 1 + InsecureRandRange(200);
+            auto *ptr = static_cast<uint8_t *>(resource.Allocate(bytes, 8));
+            BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(ptr) % 8, 0U);
+            const uint8_t fill = InsecureRandBits(8);
+            std::fill(ptr, ptr + bytes, fill);
+            allocations.push_back({ptr, bytes, fill});
+        } else {
+            // Free a random allocation, after checking that no other
+            // allocation overwrote it.
+            const size_t idx = InsecureRandRange(allocations.size());
+            const Allocation &a = allocations[idx];
+            for (size_t j = 0; j < a.bytes; ++j) {
+                BOOST_REQUIRE_EQUAL(a.ptr[j], a.fill);
+            }
+            resource.Deallocate(a.ptr, a.bytes, 8);
+            allocations[idx] = allocations.back();
+            allocations.pop_back();
+        }
+    }
+    for (const Allocation &a : allocations) {
+        for (size_t j = 0; j < a.bytes; ++j) {
+            BOOST_REQUIRE_EQUAL(a.ptr[j], a.fill);
+        }
+        resource.Deallocate(a.ptr, a.bytes, 8);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(memusage_test) {
+    auto std_map = std::unordered_map<int, int>{};
+
+    using Map = std::unordered_map<
+        int, int, std::hash<int>, std::equal_to<int>,
+        PoolAllocator<std::pair<const int, int>,
+                      sizeof(std::pair<const int, int>) + sizeof(void *) * 4>>;
+    auto resource = Map::allocator_type::ResourceType(1024);
+
+    {
+        auto resource_map = Map{0, std::hash<int>{}, std::equal_to<int>{},
+                                &resource};
+
+        // Can't have the same resource usage.
+        BOOST_CHECK_NE(memusage::DynamicUsage(std_map),
+                       memusage::DynamicUsage(resource_map));
+
+        for (size_t i = 0; i < 10000; ++i) {
+            std_map[i];
+            resource_map[i];
+        }
+
+        // Eventually the resource_map should have a much lower memory usage
+        // because it has less malloc overhead.
+        BOOST_CHECK_LT(memusage::DynamicUsage(resource_map),
+                       memusage::DynamicUsage(std_map) * 90 / 100);
+
+        // Erasing nodes does not give their memory back to the system, so the
+        // usage does not go down.
+        const size_t usage = memusage::DynamicUsage(resource_map);
+        resource_map.erase(resource_map.begin(), resource_map.end());
+        BOOST_CHECK_EQUAL(memusage::DynamicUsage(resource_map), usage);
+    }
+
+    // The resource has now been used by the map and reclaimed its nodes.
+    BOOST_CHECK_GT(resource.NumAllocatedChunks(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_cache_reallocate) {
+    // Flushing a CCoinsViewCache gives the memory of its nodes back, which
+    // erasing them alone does not.
+    CCoinsView base;
+    CCoinsViewCache cache(&base);
+    const size_t emptyUsage = cache.DynamicMemoryUsage();
+    for (uint32_t i = 0; i < 10000; ++i) {
+        cache.AddCoin(COutPoint(TxId(InsecureRand256()), i),
+                      Coin(CTxOut(1 * SATOSHI, CScript()), 1, false), false);
+    }
+    BOOST_CHECK_GT(cache.DynamicMemoryUsage(), emptyUsage);
+    // CCoinsView::BatchWrite fails, but the cache is emptied all the same.
+    BOOST_CHECK(!cache.Flush());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), emptyUsage);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -116,4 +116,92 @@ BOOST_AUTO_TEST_CASE(sig_pubkey_hash_variations) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(schnorr_batch) {
+    CDataStream stream(
+        ParseHex(
+            "010000000122739e70fbee987a8be1788395a2f2e6ad18ccb7ff611cd798071539"
+            "dde3c38e000000000151ffffffff010000000000000000016a00000000"),
+        SER_NETWORK, PROTOCOL_VERSION);
+    CTransaction dummyTx(deserialize, stream);
+    ScriptExecutionContext limitedContext(0, CTxOut{0 * SATOSHI, {}}, dummyTx);
+    PrecomputedTransactionData txdata(limitedContext);
+    SchnorrBatchVerifier batch;
+    CachingTransactionSignatureChecker checker(limitedContext, true, txdata,
+                                               &batch);
+    CachingTransactionSignatureChecker nobatchchecker(limitedContext, true,
+                                                      txdata);
+
+    TestCachingTransactionSignatureChecker testChecker(checker);
+    TestCachingTransactionSignatureChecker testNoBatchChecker(nobatchchecker);
+
+    CKey key1C = DecodeSecret(strSecret1C);
+    CPubKey pubkey1C = key1C.GetPubKey();
+
+    BOOST_CHECK(CPubKey::VerifySchnorrBatch({}));
+    BOOST_CHECK(batch.Verify());
+
+    // Batches below and above SCHNORR_BATCH_MIN_SIZE, with every signature
+    // valid, then with one of them invalid.
+    for (const size_t nSigs : {size_t{3}, 2 * SCHNORR_BATCH_MIN_SIZE}) {
+        for (const bool withBadSig : {false, true}) {
+            std::vector<std::vector<uint8_t>> sigs(nSigs);
+            std::vector<uint256> hashes(nSigs);
+            std::vector<SchnorrSigCheck> checks(nSigs);
+            for (size_t i = 0; i < nSigs; ++i) {
+                hashes[i] = Hash(strprintf("Schnorr batch %u %u %i: xx", nSigs,
+                                           i, withBadSig));
+                BOOST_CHECK(key1C.SignSchnorr(hashes[i], sigs[i]));
+                BOOST_CHECK_EQUAL(sigs[i].size(), 64U);
+                checks[i].pubkey = pubkey1C;
+                checks[i].hash = hashes[i];
+                std::copy(sigs[i].begin(), sigs[i].end(),
+                          checks[i].sig.begin());
+            }
+            const size_t nBad = nSigs / 2;
+            if (withBadSig) {
+                hashes[nBad] = Hash(std::string("not the signed message"));
+                checks[nBad].hash = hashes[nBad];
+            }
+            BOOST_CHECK_EQUAL(CPubKey::VerifySchnorrBatch(checks), !withBadSig);
+
+            // Deferred signatures look valid until the batch is verified.
+            for (size_t i = 0; i < nSigs; ++i) {
+                BOOST_CHECK(testChecker.VerifyAndStore(sigs[i], pubkey1C,
+                                                       hashes[i]));
+            }
+            BOOST_CHECK_EQUAL(batch.size(), nSigs);
+            for (size_t i = 0; i < nSigs; ++i) {
+                BOOST_CHECK(!testNoBatchChecker.IsCached(sigs[i], pubkey1C,
+                                                         hashes[i]));
+            }
+
+            BOOST_CHECK_EQUAL(batch.Verify(), !withBadSig);
+            BOOST_CHECK_EQUAL(batch.size(), 0U);
+
+            // Valid signatures made it to the cache, the invalid one did not.
+            for (size_t i = 0; i < nSigs; ++i) {
+                const bool isBad = withBadSig && i == nBad;
+                BOOST_CHECK_EQUAL(
+                    testNoBatchChecker.IsCached(sigs[i], pubkey1C, hashes[i]),
+                    !isBad);
+            }
+            // Cached signatures are not deferred again.
+            for (size_t i = 0; i < nSigs; ++i) {
+                testChecker.VerifyAndStore(sigs[i], pubkey1C, hashes[i]);
+            }
+            BOOST_CHECK_EQUAL(batch.size(), withBadSig ? 1U : 0U);
+            batch.Clear();
+        }
+    }
+
+    // ECDSA signatures are never deferred.
+    const uint256 hashMsg = Hash(std::string("Schnorr batch ECDSA"));
+    std::vector<uint8_t> ecdsaSig;
+    BOOST_CHECK(key1C.SignECDSA(hashMsg, ecdsaSig));
+    BOOST_CHECK(!testChecker.VerifyAndStore(
+        ecdsaSig, pubkey1C, Hash(std::string("Schnorr batch other"))));
+    BOOST_CHECK(testChecker.VerifyAndStore(ecdsaSig, pubkey1C, hashMsg));
+    BOOST_CHECK_EQUAL(batch.size(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
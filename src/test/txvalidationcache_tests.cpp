@@ -4,6 +4,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <chain.h>
+#include <chainparams.h>
 #include <config.h>
 #include <consensus/validation.h>
 #include <key.h>
@@ -16,6 +17,7 @@
 #include <script/sighashtype.h>
 #include <script/sign.h>
 #include <script/standard.h>
+#include <txdb.h>
 #include <txmempool.h>
 #include <util/time.h>
 #include <validation.h>
@@ -26,6 +28,8 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <optional>
+
 BOOST_AUTO_TEST_SUITE(txvalidationcache_tests)
 
 static bool ToMemPool(const CMutableTransaction &tx) {
@@ -94,6 +98,449 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_block_doublespend, TestChain100Setup) {
     BOOST_CHECK_EQUAL(g_mempool.size(), 0U);
 }
 
+BOOST_FIXTURE_TEST_CASE(block_inputs_from_disk, TestChain100Setup) {
+    // Blocks spending coins which are only in the coins database must connect
+    // the same way as blocks spending cached coins, with the inputs being read
+    // by the prefetch threads and the scripts set up ahead of time.
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey())
+                                     << OP_CHECKSIG;
+
+    auto sign = [&](CMutableTransaction &mtx, const CTxOut &prevout) {
+        std::vector<uint8_t> vchSig;
+        uint256 hash = SignatureHash(
+            prevout.scriptPubKey, ScriptExecutionContext{0, prevout, mtx},
+            SigHashType().withFork(), nullptr, STANDARD_SCRIPT_VERIFY_FLAGS);
+        BOOST_CHECK(coinbaseKey.SignECDSA(hash, vchSig));
+        vchSig.push_back(uint8_t(SIGHASH_ALL | SIGHASH_FORKID));
+        mtx.vin[0].scriptSig = CScript() << vchSig;
+    };
+    auto flushCoinsCache = [] {
+        LOCK(cs_main);
+        BOOST_CHECK(pcoinsTip->Flush());
+    };
+
+    // A spend of a mature coinbase, and a spend of that spend.
+    std::vector<CMutableTransaction> spends(2);
+    spends[0].vin.resize(1);
+    spends[0].vin[0].prevout = COutPoint(m_coinbase_txns[0]->GetId(), 0);
+    spends[0].vout.resize(1);
+    spends[0].vout[0].nValue = 11 * CENT;
+    spends[0].vout[0].scriptPubKey = scriptPubKey;
+    sign(spends[0], m_coinbase_txns[0]->vout[0]);
+    spends[1].vin.resize(1);
+    spends[1].vin[0].prevout = COutPoint(spends[0].GetId(), 0);
+    spends[1].vout.resize(1);
+    spends[1].vout[0].nValue = 10 * CENT;
+    spends[1].vout[0].scriptPubKey = scriptPubKey;
+    sign(spends[1], spends[0].vout[0]);
+
+    flushCoinsCache();
+    BOOST_CHECK(!WITH_LOCK(cs_main, return pcoinsTip->HaveCoinInCache(
+                                        spends[0].vin[0].prevout)));
+    CBlock block = CreateAndProcessBlock(spends, scriptPubKey);
+    BOOST_CHECK(::ChainActive().Tip()->GetBlockHash() == block.GetHash());
+
+    // Spending the same coinbase again must fail, even though the database
+    // knows nothing about the spend until the cache is flushed.
+    std::vector<CMutableTransaction> doubleSpend(1, spends[0]);
+    doubleSpend[0].vout[0].nValue = 12 * CENT;
+    sign(doubleSpend[0], m_coinbase_txns[0]->vout[0]);
+    block = CreateAndProcessBlock(doubleSpend, scriptPubKey);
+    BOOST_CHECK(::ChainActive().Tip()->GetBlockHash() != block.GetHash());
+
+    doubleSpend[0].vout[0].nValue = 13 * CENT;
+    sign(doubleSpend[0], m_coinbase_txns[0]->vout[0]);
+    flushCoinsCache();
+    block = CreateAndProcessBlock(doubleSpend, scriptPubKey);
+    BOOST_CHECK(::ChainActive().Tip()->GetBlockHash() != block.GetHash());
+
+    // Whereas spending another coinbase from disk is fine.
+    std::vector<CMutableTransaction> otherSpend(1, spends[0]);
+    otherSpend[0].vin[0].prevout = COutPoint(m_coinbase_txns[1]->GetId(), 0);
+    sign(otherSpend[0], m_coinbase_txns[1]->vout[0]);
+    flushCoinsCache();
+    block = CreateAndProcessBlock(otherSpend, scriptPubKey);
+    BOOST_CHECK(::ChainActive().Tip()->GetBlockHash() == block.GetHash());
+}
+
+BOOST_FIXTURE_TEST_CASE(block_inputs_in_tip_cache, TestChain100Setup) {
+    // The coins already cached in pcoinsTip are not copied to the view of a
+    // block by the prefetch. The script checks of the transactions spending
+    // them must still be set up ahead of time, with or without the prefetch.
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey())
+                                     << OP_CHECKSIG;
+
+    const bool fUtxoPrefetchOld = fUtxoPrefetch;
+    for (const bool fPrefetch : {true, false}) {
+        fUtxoPrefetch = fPrefetch;
+        const CTransaction &prevTx = *m_coinbase_txns[fPrefetch ? 0 : 1];
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        mtx.vin[0].prevout = COutPoint(prevTx.GetId(), 0);
+        mtx.vout.resize(1);
+        mtx.vout[0].nValue = 11 * CENT;
+        mtx.vout[0].scriptPubKey = scriptPubKey;
+        std::vector<uint8_t> vchSig;
+        uint256 hash = SignatureHash(
+            prevTx.vout[0].scriptPubKey,
+            ScriptExecutionContext{0, prevTx.vout[0], mtx},
+            SigHashType().withFork(), nullptr, STANDARD_SCRIPT_VERIFY_FLAGS);
+        BOOST_CHECK(coinbaseKey.SignECDSA(hash, vchSig));
+        vchSig.push_back(uint8_t(SIGHASH_ALL | SIGHASH_FORKID));
+        mtx.vin[0].scriptSig = CScript() << vchSig;
+
+        {
+            LOCK(cs_main);
+            BOOST_CHECK(!pcoinsTip->AccessCoin(mtx.vin[0].prevout).IsSpent());
+            BOOST_CHECK(pcoinsTip->HaveCoinInCache(mtx.vin[0].prevout));
+        }
+        const uint64_t nPrecomputedBefore = nBlockTxsPrecomputed;
+        CBlock block = CreateAndProcessBlock({mtx}, scriptPubKey);
+        BOOST_CHECK(::ChainActive().Tip()->GetBlockHash() == block.GetHash());
+        BOOST_CHECK_EQUAL(nBlockTxsPrecomputed - nPrecomputedBefore, 1U);
+    }
+    fUtxoPrefetch = fUtxoPrefetchOld;
+}
+
+BOOST_FIXTURE_TEST_CASE(mempool_precheck, TestChain100Setup) {
+    // The scripts of a batch of transactions about to be accepted to the
+    // mempool are checked in parallel ahead of AcceptToMemoryPool, which then
+    // finds them in the script cache. The checks run on the script check
+    // threads, which do not hold cs_main: in builds with DEBUG_LOCKORDER, the
+    // script cache asserts that they leave it to the calling thread.
+    AssertLockNotHeld(cs_main);
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey())
+                                     << OP_CHECKSIG;
+
+    auto spend = [&](const CTransaction &prevTx, const Amount value) {
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        mtx.vin[0].prevout = COutPoint(prevTx.GetId(), 0);
+        mtx.vout.resize(1);
+        mtx.vout[0].nValue = value;
+        mtx.vout[0].scriptPubKey = scriptPubKey;
+        std::vector<uint8_t> vchSig;
+        uint256 hash = SignatureHash(
+            prevTx.vout[0].scriptPubKey,
+            ScriptExecutionContext{0, prevTx.vout[0], mtx},
+            SigHashType().withFork(), nullptr, STANDARD_SCRIPT_VERIFY_FLAGS);
+        BOOST_CHECK(coinbaseKey.SignECDSA(hash, vchSig));
+        vchSig.push_back(uint8_t(SIGHASH_ALL | SIGHASH_FORKID));
+        mtx.vin[0].scriptSig = CScript() << vchSig;
+        return mtx;
+    };
+
+    // Make the first three coinbases mature for the mempool.
+    for (int i = 0; i < 2; ++i) {
+        CreateAndProcessBlock({}, scriptPubKey);
+    }
+
+    const Consensus::Params &params =
+        GetConfig().GetChainParams().GetConsensus();
+    uint32_t nextBlockFlags;
+    const uint32_t standardFlags = WITH_LOCK(
+        cs_main, return GetMemPoolScriptFlags(params, ::ChainActive().Tip(),
+                                              &nextBlockFlags));
+    auto isCached = [](const CMutableTransaction &mtx, uint32_t flags) {
+        LOCK(cs_main);
+        int nSigChecks;
+        return IsKeyInScriptCache(ScriptCacheKey(CTransaction(mtx), flags),
+                                  false, nSigChecks);
+    };
+
+    const CMutableTransaction spend0 = spend(*m_coinbase_txns[0], 11 * CENT);
+    // Spends the same coin as spend0.
+    const CMutableTransaction doubleSpend =
+        spend(*m_coinbase_txns[0], 12 * CENT);
+    // Spends spend0, which is not in the mempool yet.
+    const CMutableTransaction child = spend(CTransaction(spend0), 10 * CENT);
+    CMutableTransaction badSig = spend(*m_coinbase_txns[1], 11 * CENT);
+    badSig.vout[0].nValue = 13 * CENT;
+    const CMutableTransaction spend2 = spend(*m_coinbase_txns[2], 11 * CENT);
+
+    std::vector<CTransactionRef> txs;
+    for (const auto &mtx : {spend0, doubleSpend, child, badSig, spend2}) {
+        txs.push_back(MakeTransactionRef(mtx));
+    }
+    BOOST_CHECK_EQUAL(
+        PrecheckTransactionsForMempool(GetConfig(), g_mempool, txs), 3U);
+    for (const uint32_t flags : {standardFlags, nextBlockFlags}) {
+        BOOST_CHECK(isCached(spend0, flags));
+        BOOST_CHECK(!isCached(doubleSpend, flags));
+        BOOST_CHECK(!isCached(child, flags));
+        BOOST_CHECK(!isCached(badSig, flags));
+        BOOST_CHECK(isCached(spend2, flags));
+    }
+
+    // AcceptToMemoryPool still makes all of its checks.
+    BOOST_CHECK(ToMemPool(spend0));
+    BOOST_CHECK(!ToMemPool(doubleSpend));
+    BOOST_CHECK(ToMemPool(child));
+    BOOST_CHECK(!ToMemPool(badSig));
+    BOOST_CHECK(ToMemPool(spend2));
+    BOOST_CHECK_EQUAL(g_mempool.size(), 3U);
+
+    // Transactions already in the mempool are not checked again, unlike the
+    // invalid one, whose failure is not remembered.
+    BOOST_CHECK_EQUAL(
+        PrecheckTransactionsForMempool(GetConfig(), g_mempool, txs), 1U);
+}
+
+BOOST_FIXTURE_TEST_CASE(coins_incremental_flush, TestChain100Setup) {
+    // The incremental flush brings the coins database to the tip in small
+    // chunks, following the tip as blocks get connected, and keeps the coins
+    // in the cache.
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey())
+                                     << OP_CHECKSIG;
+
+    auto spend = [&](const CTransaction &prevTx) {
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        mtx.vin[0].prevout = COutPoint(prevTx.GetId(), 0);
+        mtx.vout.resize(1);
+        mtx.vout[0].nValue = prevTx.vout[0].nValue - 1 * CENT;
+        mtx.vout[0].scriptPubKey = scriptPubKey;
+        std::vector<uint8_t> vchSig;
+        uint256 hash = SignatureHash(
+            prevTx.vout[0].scriptPubKey,
+            ScriptExecutionContext{0, prevTx.vout[0], mtx},
+            SigHashType().withFork(), nullptr, STANDARD_SCRIPT_VERIFY_FLAGS);
+        BOOST_CHECK(coinbaseKey.SignECDSA(hash, vchSig));
+        vchSig.push_back(uint8_t(SIGHASH_ALL | SIGHASH_FORKID));
+        mtx.vin[0].scriptSig = CScript() << vchSig;
+        return mtx;
+    };
+    auto tipHash = [] {
+        return WITH_LOCK(cs_main, return ::ChainActive().Tip()->GetBlockHash());
+    };
+    auto dbBestBlock = [] {
+        return WITH_LOCK(cs_main, return pcoinsdbview->GetBestBlock());
+    };
+    auto drain = [] {
+        for (int i = 0; i < 100000; ++i) {
+            if (!IncrementalCoinsFlushStep(1)) {
+                return;
+            }
+        }
+        BOOST_ERROR("incremental flush did not complete");
+    };
+
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(pcoinsTip->Flush());
+    }
+    BOOST_CHECK(!IncrementalCoinsFlushStep(1));
+
+    std::vector<CMutableTransaction> spends;
+    spends.push_back(spend(*m_coinbase_txns[0]));
+    CreateAndProcessBlock({spends.back()}, scriptPubKey);
+
+    // Partway through, the coins database is marked as in transition to the
+    // tip.
+    while (!dbBestBlock().IsNull() && IncrementalCoinsFlushStep(1)) {
+    }
+    BOOST_CHECK(dbBestBlock().IsNull());
+    BOOST_CHECK(WITH_LOCK(cs_main, return pcoinsdbview->GetHeadBlocks())
+                    .size() == 2);
+
+    // Connecting a block meanwhile moves the transition along.
+    spends.push_back(spend(CTransaction(spends.back())));
+    CreateAndProcessBlock({spends.back()}, scriptPubKey);
+    drain();
+    BOOST_CHECK(dbBestBlock() == tipHash());
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(pcoinsdbview->GetHeadBlocks().empty());
+        BOOST_CHECK(!pcoinsdbview->HaveCoin(spends[0].vin[0].prevout));
+        BOOST_CHECK(!pcoinsdbview->HaveCoin(spends[1].vin[0].prevout));
+        const COutPoint last(spends[1].GetId(), 0);
+        BOOST_CHECK(pcoinsdbview->HaveCoin(last));
+        BOOST_CHECK(pcoinsTip->HaveCoinInCache(last));
+    }
+
+    // Disconnecting a block in the middle of a transition first completes it.
+    spends.push_back(spend(CTransaction(spends.back())));
+    CreateAndProcessBlock({spends.back()}, scriptPubKey);
+    const BlockHash hashLast = tipHash();
+    while (!dbBestBlock().IsNull() && IncrementalCoinsFlushStep(1)) {
+    }
+    BOOST_CHECK(dbBestBlock().IsNull());
+    {
+        CValidationState state;
+        CBlockIndex *pindex =
+            WITH_LOCK(cs_main, return LookupBlockIndex(hashLast));
+        BOOST_CHECK(InvalidateBlock(GetConfig(), state, pindex));
+    }
+    BOOST_CHECK(tipHash() != hashLast);
+    BOOST_CHECK(dbBestBlock() == hashLast);
+    drain();
+    BOOST_CHECK(dbBestBlock() == tipHash());
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(pcoinsdbview->HaveCoin(COutPoint(spends[1].GetId(), 0)));
+        BOOST_CHECK(!pcoinsdbview->HaveCoin(COutPoint(spends[2].GetId(), 0)));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(coins_incremental_flush_catch_up, TestChain100Setup) {
+    // While the tip keeps moving, as in the initial block download, the
+    // incremental flush still brings the coins database to it after a while.
+    // A restart before that replays the blocks the coins database is behind.
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey())
+                                     << OP_CHECKSIG;
+
+    auto spend = [&](const CTransaction &prevTx) {
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        mtx.vin[0].prevout = COutPoint(prevTx.GetId(), 0);
+        mtx.vout.resize(1);
+        mtx.vout[0].nValue = prevTx.vout[0].nValue - 1 * CENT;
+        mtx.vout[0].scriptPubKey = scriptPubKey;
+        std::vector<uint8_t> vchSig;
+        uint256 hash = SignatureHash(
+            prevTx.vout[0].scriptPubKey,
+            ScriptExecutionContext{0, prevTx.vout[0], mtx},
+            SigHashType().withFork(), nullptr, STANDARD_SCRIPT_VERIFY_FLAGS);
+        BOOST_CHECK(coinbaseKey.SignECDSA(hash, vchSig));
+        vchSig.push_back(uint8_t(SIGHASH_ALL | SIGHASH_FORKID));
+        mtx.vin[0].scriptSig = CScript() << vchSig;
+        return mtx;
+    };
+    auto tipHash = [] {
+        return WITH_LOCK(cs_main, return ::ChainActive().Tip()->GetBlockHash());
+    };
+    auto dbBestBlock = [] {
+        return WITH_LOCK(cs_main, return pcoinsdbview->GetBestBlock());
+    };
+    auto dbHeadBlocks = [] {
+        return WITH_LOCK(cs_main, return pcoinsdbview->GetHeadBlocks());
+    };
+    // Connect a block with the next spend, and write some of its coins.
+    std::vector<CMutableTransaction> spends;
+    auto connectAndStep = [&] {
+        spends.push_back(spends.empty() ? spend(*m_coinbase_txns[0])
+                                        : spend(CTransaction(spends.back())));
+        CreateAndProcessBlock({spends.back()}, scriptPubKey);
+        const BlockHash hashTip = tipHash();
+        for (int i = 0; i < 100; ++i) {
+            const std::vector<BlockHash> heads = dbHeadBlocks();
+            if (heads.size() == 2 && heads[0] == hashTip) {
+                return;
+            }
+            BOOST_REQUIRE(IncrementalCoinsFlushStep(1));
+        }
+        BOOST_ERROR("incremental flush did not write a chunk");
+    };
+
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(pcoinsTip->Flush());
+    }
+    BOOST_CHECK(!IncrementalCoinsFlushStep(1));
+    const BlockHash hashStart = tipHash();
+
+    // The tip moves on while the transition is under way, and after
+    // COINS_FLUSH_MAX_TRANSITION_TIME the rest is written at once.
+    connectAndStep();
+    connectAndStep();
+    BOOST_CHECK(dbHeadBlocks()[1] == hashStart);
+    SetMockTime(GetTime() + COINS_FLUSH_MAX_TRANSITION_TIME);
+    BOOST_CHECK(!IncrementalCoinsFlushStep(1));
+    SetMockTime(0);
+    BOOST_CHECK(dbBestBlock() == tipHash());
+
+    // Stop partway through a transition which moved on to a second block.
+    const BlockHash hashBefore = tipHash();
+    connectAndStep();
+    connectAndStep();
+    BOOST_CHECK(dbHeadBlocks() ==
+                std::vector<BlockHash>({tipHash(), hashBefore}));
+    {
+        LOCK(cs_main);
+        // Drop the cache, as a restart would, and replay.
+        pcoinsTip = std::make_unique<CCoinsViewCache>(pcoinsdbview.get());
+        BOOST_CHECK(ReplayBlocks(GetConfig().GetChainParams().GetConsensus(),
+                                 pcoinsdbview.get()));
+        pcoinsTip = std::make_unique<CCoinsViewCache>(pcoinsdbview.get());
+        BOOST_CHECK(pcoinsdbview->GetBestBlock() ==
+                    ::ChainActive().Tip()->GetBlockHash());
+        BOOST_CHECK(pcoinsdbview->GetHeadBlocks().empty());
+        for (const CMutableTransaction &mtx : spends) {
+            BOOST_CHECK(!pcoinsdbview->HaveCoin(mtx.vin[0].prevout));
+        }
+        BOOST_CHECK(
+            pcoinsdbview->HaveCoin(COutPoint(spends.back().GetId(), 0)));
+    }
+    BOOST_CHECK(!IncrementalCoinsFlushStep(1));
+}
+
+BOOST_FIXTURE_TEST_CASE(block_schnorr_batch, TestChain100Setup) {
+    // With -schnorrbatchverify, blocks whose Schnorr signatures are all valid
+    // connect, and a single bad signature still gets the block rejected.
+    fSchnorrBatchVerify = true;
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey())
+                                     << OP_CHECKSIG;
+
+    auto sign = [&](CMutableTransaction &mtx, const CTxOut &prevout,
+                    bool bad) {
+        std::vector<uint8_t> vchSig;
+        uint256 hash = SignatureHash(
+            prevout.scriptPubKey, ScriptExecutionContext{0, prevout, mtx},
+            SigHashType().withFork(), nullptr, STANDARD_SCRIPT_VERIFY_FLAGS);
+        if (bad) {
+            // A valid signature, but not for this transaction
+            hash = Hash(std::string("not the signature hash"));
+        }
+        BOOST_CHECK(coinbaseKey.SignSchnorr(hash, vchSig));
+        vchSig.push_back(uint8_t(SIGHASH_ALL | SIGHASH_FORKID));
+        mtx.vin[0].scriptSig = CScript() << vchSig;
+    };
+
+    // Only the first coinbase is mature, so split it into enough outputs for
+    // the blocks below.
+    constexpr size_t nSpends = 20;
+    CMutableTransaction fanout;
+    fanout.vin.resize(1);
+    fanout.vin[0].prevout = COutPoint(m_coinbase_txns[0]->GetId(), 0);
+    fanout.vout.resize(2 * nSpends);
+    for (CTxOut &out : fanout.vout) {
+        out.nValue = 1 * CENT;
+        out.scriptPubKey = scriptPubKey;
+    }
+    sign(fanout, m_coinbase_txns[0]->vout[0], false);
+    CBlock block = CreateAndProcessBlock({fanout}, scriptPubKey);
+    BOOST_CHECK(::ChainActive().Tip()->GetBlockHash() == block.GetHash());
+
+    auto makeSpends = [&](size_t firstOutput,
+                          std::optional<size_t> badSpend) {
+        std::vector<CMutableTransaction> spends(nSpends);
+        for (size_t i = 0; i < nSpends; ++i) {
+            spends[i].vin.resize(1);
+            spends[i].vin[0].prevout =
+                COutPoint(fanout.GetId(), firstOutput + i);
+            spends[i].vout.resize(1);
+            spends[i].vout[0].nValue = 1 * CENT - 1000 * SATOSHI;
+            spends[i].vout[0].scriptPubKey = scriptPubKey;
+            sign(spends[i], fanout.vout[firstOutput + i], badSpend == i);
+        }
+        return spends;
+    };
+
+    block = CreateAndProcessBlock(makeSpends(0, std::nullopt), scriptPubKey);
+    BOOST_CHECK(::ChainActive().Tip()->GetBlockHash() == block.GetHash());
+
+    for (const size_t badSpend : {size_t{0}, nSpends / 2, nSpends - 1}) {
+        block = CreateAndProcessBlock(makeSpends(nSpends, badSpend),
+                                      scriptPubKey);
+        BOOST_CHECK(::ChainActive().Tip()->GetBlockHash() != block.GetHash());
+    }
+
+    block = CreateAndProcessBlock(makeSpends(nSpends, std::nullopt),
+                                  scriptPubKey);
+    BOOST_CHECK(::ChainActive().Tip()->GetBlockHash() == block.GetHash());
+    fSchnorrBatchVerify = DEFAULT_SCHNORR_BATCH_VERIFY;
+}
+
 static inline bool
 CheckInputs(const CTransaction &tx, CValidationState &state,
             const CCoinsViewCache &view, bool fScriptChecks,
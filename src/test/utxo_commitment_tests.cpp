@@ -0,0 +1,247 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <utxo_commitment.h>
+
+#include <chain.h>
+#include <clientversion.h>
+#include <coins.h>
+#include <config.h>
+#include <consensus/validation.h>
+#include <ec_multiset.h>
+#include <interfaces/chain.h>
+#include <node/context.h>
+#include <primitives/block.h>
+#include <rpc/client.h>
+#include <rpc/server.h>
+#include <script/sighashtype.h>
+#include <streams.h>
+#include <txdb.h>
+#include <undo.h>
+#include <validation.h>
+
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+/** The commitment to the UTXO set of the coins database, the slow way */
+UTXOCommitment WalkCoinsDB() {
+    FlushStateToDisk();
+    LOCK(cs_main);
+    ECMultiSet set;
+    uint64_t nTransactionOutputs = 0;
+    uint64_t nBogoSize = 0;
+    Amount nTotalAmount = Amount::zero();
+    std::unique_ptr<CCoinsViewCursor> pcursor(pcoinsdbview->Cursor());
+    for (; pcursor->Valid(); pcursor->Next()) {
+        COutPoint outpoint;
+        Coin coin;
+        BOOST_REQUIRE(pcursor->GetKey(outpoint) && pcursor->GetValue(coin));
+        ApplyCoinHash(set, outpoint, coin);
+        nTransactionOutputs++;
+        nBogoSize += GetBogoSize(coin.GetTxOut().scriptPubKey);
+        nTotalAmount += coin.GetTxOut().nValue;
+    }
+    return UTXOCommitment(set, nTransactionOutputs, nBogoSize, nTotalAmount);
+}
+
+void CheckEqual(const UTXOCommitment &a, const UTXOCommitment &b) {
+    BOOST_CHECK(a.GetHash() == b.GetHash());
+    BOOST_CHECK_EQUAL(a.nTransactionOutputs, b.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(a.nBogoSize, b.nBogoSize);
+    BOOST_CHECK_EQUAL(a.nTotalAmount, b.nTotalAmount);
+}
+
+std::shared_ptr<const UTXOCommitment> TipCommitment() {
+    LOCK(cs_main);
+    return ::ChainActive().Tip()->utxoCommitment;
+}
+
+UniValue CallRPC(const std::string &strMethod,
+                 const std::vector<std::string> &args) {
+    GlobalConfig config;
+    NodeContext node;
+    JSONRPCRequest request;
+    request.context = &node;
+    request.strMethod = strMethod;
+    request.params = RPCConvertValues(strMethod, args);
+    return tableRPC[strMethod]->call(config, request);
+}
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(utxo_commitment_tests, TestChain100Setup)
+
+BOOST_AUTO_TEST_CASE(serialization) {
+    ECMultiSet set;
+    set.Add(MakeUInt8Span(std::vector<uint8_t>{1, 2, 3}));
+    const UTXOCommitment commitment(set, 3, 200, 50 * COIN);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << commitment;
+    UTXOCommitment read;
+    ss >> read;
+    CheckEqual(read, commitment);
+    BOOST_CHECK(read.GetHash() == set.GetHash());
+    BOOST_CHECK(UTXOCommitment().GetHash() == uint256());
+
+    // It is stored with the block index, after the fields of older versions.
+    LOCK(cs_main);
+    CBlockIndex *tip = ::ChainActive().Tip();
+    tip->utxoCommitment = std::make_shared<const UTXOCommitment>(commitment);
+    CDataStream ssIndex(SER_DISK, CLIENT_VERSION);
+    ssIndex << CDiskBlockIndex(tip);
+    tip->utxoCommitment.reset();
+    CDiskBlockIndex diskindex;
+    ssIndex >> diskindex;
+    BOOST_REQUIRE(diskindex.utxoCommitment);
+    CheckEqual(*diskindex.utxoCommitment, commitment);
+    BOOST_CHECK(ssIndex.empty());
+}
+
+BOOST_AUTO_TEST_CASE(rolling_commitment) {
+    const Config &config = GetConfig();
+    fUtxoCommitment = true;
+
+    // The chain was made without -utxocommitment, so the commitment must be
+    // seeded by walking the coins database.
+    BOOST_CHECK(!TipCommitment());
+    const UniValue seeded = CallRPC("gettxoutsetinfo", {"ecmultiset"});
+    BOOST_REQUIRE(TipCommitment());
+    CheckEqual(*TipCommitment(), WalkCoinsDB());
+    BOOST_CHECK_EQUAL(seeded["ecmultiset_hash"].get_str(),
+                      TipCommitment()->GetHash().GetHex());
+    BOOST_CHECK(seeded.locate("hash_serialized") == nullptr);
+
+    const UniValue serialized = CallRPC("gettxoutsetinfo", {});
+    BOOST_CHECK(serialized.locate("ecmultiset_hash") == nullptr);
+    BOOST_CHECK_EQUAL(serialized["txouts"].get_int64(),
+                      seeded["txouts"].get_int64());
+    BOOST_CHECK_EQUAL(serialized["bogosize"].get_int64(),
+                      seeded["bogosize"].get_int64());
+    BOOST_CHECK_EQUAL(serialized["total_amount"].getValStr(),
+                      seeded["total_amount"].getValStr());
+    BOOST_CHECK_THROW(CallRPC("gettxoutsetinfo", {"muhash"}), JSONRPCError);
+
+    // Blocks spending coins, and creating unspendable outputs, are committed
+    // to from then on.
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey())
+                                     << OP_CHECKSIG;
+    for (size_t i = 0; i < 3; i++) {
+        CMutableTransaction spend;
+        spend.vin.resize(1);
+        spend.vin[0].prevout = COutPoint(m_coinbase_txns[i]->GetId(), 0);
+        spend.vout.resize(2);
+        spend.vout[0].nValue = 11 * CENT;
+        spend.vout[0].scriptPubKey = scriptPubKey;
+        spend.vout[1].nValue = Amount::zero();
+        spend.vout[1].scriptPubKey = CScript() << OP_RETURN;
+        const CTxOut &prevout = m_coinbase_txns[i]->vout[0];
+        std::vector<uint8_t> vchSig;
+        const uint256 sighash = SignatureHash(
+            prevout.scriptPubKey, ScriptExecutionContext{0, prevout, spend},
+            SigHashType().withFork(), nullptr, STANDARD_SCRIPT_VERIFY_FLAGS);
+        BOOST_CHECK(coinbaseKey.SignECDSA(sighash, vchSig));
+        vchSig.push_back(uint8_t(SIGHASH_ALL | SIGHASH_FORKID));
+        spend.vin[0].scriptSig = CScript() << vchSig;
+
+        CreateAndProcessBlock({spend}, scriptPubKey);
+        BOOST_REQUIRE(TipCommitment());
+        CheckEqual(*TipCommitment(), WalkCoinsDB());
+    }
+
+    // gettxoutsetinfo now just reads it.
+    const UniValue rolled = CallRPC("gettxoutsetinfo", {"ecmultiset"});
+    BOOST_CHECK_EQUAL(rolled["ecmultiset_hash"].get_str(),
+                      TipCommitment()->GetHash().GetHex());
+    BOOST_CHECK_EQUAL(rolled["height"].get_int(), 103);
+
+    // Disconnecting a block leaves the commitment of its parent, which is
+    // worked out from the undo data if it wasn't known.
+    CBlockIndex *tip;
+    {
+        LOCK(cs_main);
+        tip = ::ChainActive().Tip();
+        tip->pprev->utxoCommitment.reset();
+    }
+    const auto commitmentTip = TipCommitment();
+    {
+        CValidationState state;
+        BOOST_CHECK(InvalidateBlock(config, state, tip));
+    }
+    BOOST_REQUIRE(TipCommitment());
+    CheckEqual(*TipCommitment(), WalkCoinsDB());
+
+    // Reconnecting it gives back the same commitment.
+    {
+        LOCK(cs_main);
+        ResetBlockFailureFlags(tip);
+    }
+    {
+        CValidationState state;
+        BOOST_CHECK(ActivateBestChain(config, state));
+    }
+    BOOST_CHECK(TipCommitment() == commitmentTip);
+    CheckEqual(*TipCommitment(), WalkCoinsDB());
+
+    fUtxoCommitment = DEFAULT_UTXO_COMMITMENT;
+}
+
+BOOST_AUTO_TEST_CASE(parallel_hashing) {
+    // A block with enough coins for their hashing to be split into tasks.
+    const CScript scriptPubKey = CScript() << OP_TRUE;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    for (int64_t i = 1; i <= 3000; ++i) {
+        coinbase.vout.emplace_back(i * SATOSHI, scriptPubKey);
+    }
+    CMutableTransaction spend;
+    CTxUndo txundo;
+    ECMultiSet set;
+    Amount nTotalAmount = Amount::zero();
+    for (uint32_t n = 0; n < 2000; ++n) {
+        spend.vin.emplace_back(COutPoint(TxId(InsecureRand256()), n));
+        txundo.vprevout.emplace_back(CTxOut(COIN, scriptPubKey), 1, false);
+        ApplyCoinHash(set, spend.vin.back().prevout, txundo.vprevout.back());
+        nTotalAmount += COIN;
+    }
+    spend.vout.emplace_back(COIN, scriptPubKey);
+    CBlock block;
+    block.vtx = {MakeTransactionRef(coinbase), MakeTransactionRef(spend)};
+    CBlockUndo blockundo;
+    blockundo.vtxundo.push_back(txundo);
+    const UTXOCommitment prev(set, 2000,
+                              2000 * GetBogoSize(scriptPubKey), nTotalAmount);
+
+    // The tasks may run in any order.
+    size_t nTasks = 0;
+    const UTXOCommitmentTaskRunner runTasks =
+        [&nTasks](std::vector<std::function<void()>> &tasks) {
+            nTasks = tasks.size();
+            std::for_each(tasks.rbegin(), tasks.rend(),
+                          [](const std::function<void()> &task) { task(); });
+        };
+
+    const UTXOCommitment serial =
+        ConnectBlockToUTXOCommitment(prev, block, blockundo, 2, {});
+    const UTXOCommitment parallel =
+        ConnectBlockToUTXOCommitment(prev, block, blockundo, 2, {}, runTasks);
+    BOOST_CHECK_GT(nTasks, 1U);
+    CheckEqual(parallel, serial);
+    BOOST_CHECK_EQUAL(parallel.nTransactionOutputs, 3001U);
+
+    nTasks = 0;
+    CheckEqual(DisconnectBlockFromUTXOCommitment(parallel, block, blockundo, 2,
+                                                 runTasks),
+               prev);
+    BOOST_CHECK_GT(nTasks, 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,240 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/utxo_snapshot.h>
+
+#include <chainparams.h>
+#include <clientversion.h>
+#include <coins.h>
+#include <config.h>
+#include <consensus/validation.h>
+#include <ec_multiset.h>
+#include <interfaces/chain.h>
+#include <node/blockstorage.h>
+#include <node/context.h>
+#include <rpc/client.h>
+#include <rpc/server.h>
+#include <script/sighashtype.h>
+#include <streams.h>
+#include <txdb.h>
+#include <util/system.h>
+#include <utxo_commitment.h>
+#include <validation.h>
+
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+UniValue CallRPC(const std::string &strMethod, const std::string &arg) {
+    GlobalConfig config;
+    NodeContext node;
+    JSONRPCRequest request;
+    request.context = &node;
+    request.strMethod = strMethod;
+    request.params = RPCConvertValues(strMethod, {arg});
+    try {
+        return tableRPC[strMethod]->call(config, request);
+    } catch (const JSONRPCError &error) {
+        throw std::runtime_error(error.message);
+    }
+}
+
+/** Load the snapshot at `path` with the given assumed hash */
+bool LoadSnapshot(const fs::path &path, const uint256 &hash,
+                  CValidationState &state) {
+    CAutoFile afile(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    BOOST_REQUIRE(!afile.IsNull());
+    SnapshotMetadata metadata;
+    afile >> metadata;
+    return LoadUTXOSnapshot(GetConfig(), afile, metadata, AssumeutxoData{hash},
+                            state);
+}
+
+size_t CountCoinsInDB() {
+    std::unique_ptr<CCoinsViewCursor> pcursor(pcoinsdbview->Cursor());
+    size_t n = 0;
+    for (; pcursor->Valid(); pcursor->Next()) {
+        ++n;
+    }
+    return n;
+}
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(utxo_snapshot_tests, TestChain100Setup)
+
+BOOST_AUTO_TEST_CASE(metadata_serialization) {
+    const CChainParams &params = GetConfig().GetChainParams();
+    const SnapshotMetadata metadata(params, BlockHash(InsecureRand256()), 1234,
+                                    std::nullopt);
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << metadata;
+
+    SnapshotMetadata read;
+    CDataStream(ss) >> read;
+    BOOST_CHECK(read.IsForNetwork(params));
+    BOOST_CHECK(read.m_base_blockhash == metadata.m_base_blockhash);
+    BOOST_CHECK_EQUAL(read.m_coins_count, 1234U);
+    BOOST_CHECK(!read.m_abla_state);
+
+    CDataStream bad(ss);
+    bad[0] = 'x';
+    BOOST_CHECK_THROW(bad >> read, std::ios_base::failure);
+    bad = ss;
+    bad[SNAPSHOT_MAGIC_BYTES.size()] = SNAPSHOT_VERSION + 1;
+    BOOST_CHECK_THROW(bad >> read, std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(dump_and_load) {
+    const Config &config = GetConfig();
+    const CChainParams &chainparams = config.GetChainParams();
+
+    const UniValue result = CallRPC("dumptxoutset", "utxo.dat");
+    const fs::path path = GetDataDir() / "utxo.dat";
+    BOOST_CHECK(fs::exists(path));
+    BOOST_CHECK(!fs::exists(path.string() + ".incomplete"));
+    BOOST_CHECK_THROW(CallRPC("dumptxoutset", "utxo.dat"), std::runtime_error);
+
+    const CBlockIndex *pbase = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+    // The block index is unloaded below.
+    const BlockHash hashBase = pbase->GetBlockHash();
+    BOOST_CHECK_EQUAL(result["base_height"].get_int(), pbase->nHeight);
+    BOOST_CHECK_EQUAL(result["base_hash"].get_str(), hashBase.GetHex());
+    BOOST_CHECK_EQUAL(result["coins_written"].get_int(),
+                      WITH_LOCK(cs_main, return CountCoinsInDB()));
+    BOOST_CHECK_EQUAL(result["coins_written"].get_int(), COINBASE_MATURITY);
+
+    ECMultiSet hash;
+    {
+        LOCK(cs_main);
+        std::unique_ptr<CCoinsViewCursor> pcursor(pcoinsdbview->Cursor());
+        for (; pcursor->Valid(); pcursor->Next()) {
+            COutPoint outpoint;
+            Coin coin;
+            BOOST_REQUIRE(pcursor->GetKey(outpoint) &&
+                          pcursor->GetValue(coin));
+            ApplyCoinHash(hash, outpoint, coin);
+        }
+    }
+    const uint256 hashSnapshot = hash.GetHash();
+    BOOST_CHECK_EQUAL(result["txoutset_hash"].get_str(), hashSnapshot.GetHex());
+
+    // A block after the snapshot, spending one of its coins.
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey())
+                                     << OP_CHECKSIG;
+    CMutableTransaction spend;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(m_coinbase_txns[0]->GetId(), 0);
+    spend.vout.resize(1);
+    spend.vout[0].nValue = 11 * CENT;
+    spend.vout[0].scriptPubKey = scriptPubKey;
+    {
+        const CTxOut &prevout = m_coinbase_txns[0]->vout[0];
+        std::vector<uint8_t> vchSig;
+        uint256 sighash = SignatureHash(
+            prevout.scriptPubKey, ScriptExecutionContext{0, prevout, spend},
+            SigHashType().withFork(), nullptr, STANDARD_SCRIPT_VERIFY_FLAGS);
+        BOOST_CHECK(coinbaseKey.SignECDSA(sighash, vchSig));
+        vchSig.push_back(uint8_t(SIGHASH_ALL | SIGHASH_FORKID));
+        spend.vin[0].scriptSig = CScript() << vchSig;
+    }
+    const auto pblockNext = std::make_shared<const CBlock>(
+        CreateAndProcessBlock({spend}, scriptPubKey));
+
+    std::vector<CBlockHeader> headers;
+    {
+        LOCK(cs_main);
+        for (const CBlockIndex *pindex = ::ChainActive().Tip();
+             pindex->pprev != nullptr; pindex = pindex->pprev) {
+            headers.insert(headers.begin(), pindex->GetBlockHeader());
+        }
+    }
+
+    // Start over from a node which only knows the headers.
+    UnloadBlockIndex(config);
+    pcoinsTip.reset();
+    pcoinsdbview.reset(new CCoinsViewDB(1 << 23, true));
+    pcoinsTip.reset(new CCoinsViewCache(pcoinsdbview.get()));
+    pblocktree.reset(new CBlockTreeDB(1 << 20, true));
+    BOOST_REQUIRE(LoadGenesisBlock(chainparams));
+    {
+        CValidationState state;
+        BOOST_REQUIRE(ActivateBestChain(config, state));
+        BOOST_REQUIRE(ProcessNewBlockHeaders(config, headers, state));
+    }
+
+    // Only pruned nodes can do without the blocks below the snapshot.
+    {
+        CValidationState state;
+        BOOST_CHECK(!LoadSnapshot(path, hashSnapshot, state));
+        BOOST_CHECK(state.GetRejectReason().find("-prune") !=
+                    std::string::npos);
+    }
+    fPruneMode = true;
+
+    // A snapshot not matching the assumed hash leaves the node as it was.
+    {
+        CValidationState state;
+        BOOST_CHECK(!LoadSnapshot(path, uint256(), state));
+        BOOST_CHECK(state.GetRejectReason().find("does not match") !=
+                    std::string::npos);
+        LOCK(cs_main);
+        BOOST_CHECK_EQUAL(::ChainActive().Height(), 0);
+        BOOST_CHECK(pcoinsdbview->GetBestBlock() ==
+                    ::ChainActive().Tip()->GetBlockHash());
+        BOOST_CHECK_EQUAL(CountCoinsInDB(), 0U);
+    }
+
+    // The replay at the next start erases the coins of a load interrupted by
+    // a crash, as the blocks below the snapshot cannot be rolled forward.
+    {
+        LOCK(cs_main);
+        const BlockHash hashGenesis = ::ChainActive().Genesis()->GetBlockHash();
+        const std::vector<std::pair<COutPoint, Coin>> coins{
+            {spend.vin[0].prevout,
+             Coin(m_coinbase_txns[0]->vout[0], 1, true)}};
+        BOOST_REQUIRE(pcoinsdbview->WriteCoinsChunk(coins, hashBase, false));
+        BOOST_CHECK_EQUAL(CountCoinsInDB(), 1U);
+        BOOST_CHECK(ReplayBlocks(chainparams.GetConsensus(),
+                                 pcoinsdbview.get()));
+        BOOST_CHECK(pcoinsdbview->GetBestBlock() == hashGenesis);
+        BOOST_CHECK(pcoinsdbview->GetHeadBlocks().empty());
+        BOOST_CHECK_EQUAL(CountCoinsInDB(), 0U);
+    }
+
+    {
+        CValidationState state;
+        BOOST_CHECK(LoadSnapshot(path, hashSnapshot, state));
+        LOCK(cs_main);
+        BOOST_CHECK(::ChainActive().Tip()->GetBlockHash() == hashBase);
+        BOOST_CHECK(pcoinsdbview->GetBestBlock() == hashBase);
+        BOOST_CHECK_EQUAL(CountCoinsInDB(), COINBASE_MATURITY);
+        BOOST_CHECK(pcoinsTip->HaveCoin(spend.vin[0].prevout));
+        BOOST_CHECK(!::ChainActive().Tip()->nStatus.hasData());
+    }
+
+    // The chain goes on from there.
+    BOOST_CHECK(ProcessNewBlock(config, pblockNext, true, nullptr));
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(::ChainActive().Tip()->GetBlockHash() ==
+                    pblockNext->GetHash());
+        BOOST_CHECK(!pcoinsTip->HaveCoin(spend.vin[0].prevout));
+        BOOST_CHECK(pcoinsTip->HaveCoin(COutPoint(spend.GetId(), 0)));
+    }
+
+    // Only once.
+    {
+        CValidationState state;
+        BOOST_CHECK(!LoadSnapshot(path, hashSnapshot, state));
+    }
+    fPruneMode = false;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
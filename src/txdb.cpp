@@ -16,7 +16,9 @@
 #include <util/system.h>
 #include <util/vector.h>
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 
 static const char DB_COIN = 'C';
 static const char DB_COINS = 'c';
@@ -44,10 +46,36 @@ struct CoinEntry {
         SER_READ(obj, *obj.outpoint = COutPoint(id, n));
     }
 };
+/**
+ * Whether the database key of a coin sorts before that of another. Unlike
+ * COutPoint::operator<, which compares txids most significant byte first,
+ * this compares their serialization.
+ */
+bool CoinKeyLess(const COutPoint &a, const COutPoint &b) {
+    const int cmp = std::memcmp(a.GetTxId().begin(), b.GetTxId().begin(),
+                                a.GetTxId().size());
+    // VARINT preserves the order of the output indexes.
+    return cmp < 0 || (cmp == 0 && a.GetN() < b.GetN());
+}
+
+/**
+ * The LevelDB tuning of a database, from -<name>dbwritebuffer and
+ * -<name>dbfilesize (MiB).
+ */
+DBTuning GetDBTuning(const std::string &name) {
+    DBTuning tuning;
+    tuning.write_buffer_size =
+        std::max<int64_t>(gArgs.GetArg("-" + name + "dbwritebuffer", 0), 0)
+        << 20;
+    tuning.max_file_size =
+        std::max<int64_t>(gArgs.GetArg("-" + name + "dbfilesize", 0), 0) << 20;
+    return tuning;
+}
 } // namespace
 
 CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe)
-    : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) {}
+    : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true,
+         GetDBTuning("chainstate")) {}
 
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
     return db.Read(CoinEntry(&outpoint), coin);
@@ -82,15 +110,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const BlockHash &hashBlock) {
     int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
     assert(!hashBlock.IsNull());
 
-    BlockHash old_tip = GetBestBlock();
-    if (old_tip.IsNull()) {
-        // We may be in the middle of replaying.
-        std::vector<BlockHash> old_heads = GetHeadBlocks();
-        if (old_heads.size() == 2) {
-            assert(old_heads[0] == hashBlock);
-            old_tip = old_heads[1];
-        }
-    }
+    const BlockHash old_tip = GetTransitionBase(hashBlock);
 
     // In the first batch, mark the database as being in the middle of a
     // transition from old_tip to hashBlock.
@@ -99,19 +119,33 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const BlockHash &hashBlock) {
     batch.Erase(DB_BEST_BLOCK);
     batch.Write(DB_HEAD_BLOCKS, Vector(hashBlock, old_tip));
 
+    // Write the changes in key order, rather than in the random order of the
+    // hash map. Each partial batch then covers its own range of keys, so the
+    // files LevelDB writes them out to do not overlap, and can mostly be moved
+    // down the levels as they are instead of being merged with each other.
+    std::vector<CCoinsMap::iterator> dirty;
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+        count++;
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            CoinEntry entry(&it->first);
-            if (it->second.coin.IsSpent()) {
-                batch.Erase(entry);
-            } else {
-                batch.Write(entry, it->second.coin);
-            }
-            changed++;
+            dirty.push_back(it++);
+        } else {
+            it = mapCoins.erase(it);
         }
-        count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+    }
+    std::sort(dirty.begin(), dirty.end(),
+              [](const CCoinsMap::iterator &a, const CCoinsMap::iterator &b) {
+                  return CoinKeyLess(a->first, b->first);
+              });
+
+    for (const CCoinsMap::iterator &it : dirty) {
+        CoinEntry entry(&it->first);
+        if (it->second.coin.IsSpent()) {
+            batch.Erase(entry);
+        } else {
+            batch.Write(entry, it->second.coin);
+        }
+        changed++;
+        mapCoins.erase(it);
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n",
                      batch.SizeEstimate() * (1.0 / 1048576.0));
@@ -134,6 +168,9 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const BlockHash &hashBlock) {
     LogPrint(BCLog::COINDB, "Writing final batch of %.2f MiB\n",
              batch.SizeEstimate() * (1.0 / 1048576.0));
     bool ret = db.WriteBatch(batch);
+    if (ret) {
+        m_chunk_head = BlockHash();
+    }
     LogPrint(BCLog::COINDB,
              "Committed %u changed transaction outputs (out of "
              "%u) to coin database...\n",
@@ -141,12 +178,113 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const BlockHash &hashBlock) {
     return ret;
 }
 
+bool CCoinsViewDB::WriteCoinsChunk(
+    const std::vector<std::pair<COutPoint, Coin>> &coins,
+    const BlockHash &hashBlock, bool fFinal) {
+    CDBBatch batch(db);
+    assert(!hashBlock.IsNull());
+
+    const BlockHash old_tip = GetTransitionBase(hashBlock);
+
+    batch.Erase(DB_BEST_BLOCK);
+    batch.Write(DB_HEAD_BLOCKS, Vector(hashBlock, old_tip));
+    // In key order, like BatchWrite.
+    std::vector<const std::pair<COutPoint, Coin> *> sorted;
+    sorted.reserve(coins.size());
+    for (const auto &change : coins) {
+        sorted.push_back(&change);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const auto *a, const auto *b) {
+        return CoinKeyLess(a->first, b->first);
+    });
+    for (const auto *change : sorted) {
+        CoinEntry entry(&change->first);
+        if (change->second.IsSpent()) {
+            batch.Erase(entry);
+        } else {
+            batch.Write(entry, change->second);
+        }
+    }
+    if (fFinal) {
+        batch.Erase(DB_HEAD_BLOCKS);
+        batch.Write(DB_BEST_BLOCK, hashBlock);
+    }
+
+    LogPrint(BCLog::COINDB,
+             "Writing %s chunk of %u changed transaction outputs (%.2f MiB) "
+             "to coin database...\n",
+             fFinal ? "final" : "partial", coins.size(),
+             batch.SizeEstimate() * (1.0 / 1048576.0));
+    if (!db.WriteBatch(batch)) {
+        return false;
+    }
+    m_chunk_head = fFinal ? BlockHash() : hashBlock;
+    return true;
+}
+
+bool CCoinsViewDB::EraseAllCoins(const BlockHash &hashBlock) {
+    CDBBatch batch(db);
+    size_t batch_size =
+        (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
+    assert(!hashBlock.IsNull());
+
+    size_t count = 0;
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator(true));
+    COutPoint outpoint;
+    CoinEntry entry(&outpoint);
+    for (pcursor->Seek(DB_COIN); pcursor->Valid(); pcursor->Next()) {
+        if (!pcursor->GetKey(entry) || entry.key != DB_COIN) {
+            break;
+        }
+        batch.Erase(entry);
+        count++;
+        if (batch.SizeEstimate() > batch_size) {
+            if (!db.WriteBatch(batch)) {
+                return false;
+            }
+            batch.Clear();
+        }
+    }
+    batch.Erase(DB_HEAD_BLOCKS);
+    batch.Write(DB_BEST_BLOCK, hashBlock);
+
+    LogPrint(BCLog::COINDB,
+             "Erasing %u transaction outputs from coin database...\n", count);
+    if (!db.WriteBatch(batch)) {
+        return false;
+    }
+    m_chunk_head = BlockHash();
+    return true;
+}
+
+BlockHash CCoinsViewDB::GetTransitionBase(const BlockHash &hashBlock) const {
+    BlockHash old_tip = GetBestBlock();
+    if (old_tip.IsNull()) {
+        // We may be in the middle of replaying, or of a transition left by
+        // WriteCoinsChunk.
+        std::vector<BlockHash> old_heads = GetHeadBlocks();
+        if (old_heads.size() == 2) {
+            // An interrupted transition can only be completed with the changes
+            // up to the block it was heading to, except the one WriteCoinsChunk
+            // last left, which may move on to a descendant of that block.
+            assert(old_heads[0] == hashBlock || old_heads[0] == m_chunk_head);
+            old_tip = old_heads[1];
+        }
+    }
+    return old_tip;
+}
+
 size_t CCoinsViewDB::EstimateSize() const {
     return db.EstimateSize(DB_COIN, char(DB_COIN + 1));
 }
 
+void CCoinsViewDB::Compact() const {
+    db.CompactFull();
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe)
-    : CDBWrapper(GetIndexDir(), nCacheSize, fMemory, fWipe) {}
+    : CDBWrapper(GetIndexDir(), nCacheSize, fMemory, fWipe, false,
+                 GetDBTuning("blockindex")) {}
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
     return Read(std::make_pair(DB_BLOCK_FILES, nFile), info);
@@ -289,6 +427,7 @@ bool CBlockTreeDB::LoadBlockIndexGuts(
         pindexNew->nStatus = diskindex.nStatus;
         pindexNew->nTx = diskindex.nTx;
         pindexNew->SetAblaStateOpt(diskindex.GetAblaStateOpt());
+        pindexNew->utxoCommitment = diskindex.utxoCommitment;
 
         if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits,
                               params)) {
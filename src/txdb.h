@@ -50,6 +50,13 @@ static const int64_t nMaxCoinsDBCache = 8;
 class CCoinsViewDB final : public CCoinsView {
 protected:
     CDBWrapper db;
+    //! The block the last partial WriteCoinsChunk() left the database heading
+    //! to, which a later write may move on from
+    BlockHash m_chunk_head;
+
+    //! The block the database is consistent with, or in transition from,
+    //! before writing changes up to hashBlock.
+    BlockHash GetTransitionBase(const BlockHash &hashBlock) const;
 
 public:
     explicit CCoinsViewDB(size_t nCacheSize, bool fMemory = false,
@@ -62,10 +69,35 @@ public:
     bool BatchWrite(CCoinsMap &mapCoins, const BlockHash &hashBlock) override;
     CCoinsViewCursor *Cursor(bool snapshot = false) const override;
 
+    /**
+     * Write part of the changes of a transition to hashBlock in a single
+     * atomic batch, leaving the database marked as being in the middle of
+     * that transition, like a partial BatchWrite(). Spent coins are erased.
+     * If fFinal is set, these are the last changes and the database is marked
+     * as consistent with hashBlock again.
+     *
+     * The transition may be moved on to a descendant of the block it was
+     * heading to, but never to another branch, as a replay could then miss
+     * some of the changes.
+     */
+    bool WriteCoinsChunk(const std::vector<std::pair<COutPoint, Coin>> &coins,
+                         const BlockHash &hashBlock, bool fFinal);
+
+    /**
+     * Erase all the coins, in batches of -dbbatchsize, and then mark the
+     * database as consistent with hashBlock, which must have no coins. Whatever
+     * transition the database was in is kept until then, so that an
+     * interrupted erase is done again.
+     */
+    bool EraseAllCoins(const BlockHash &hashBlock);
+
     //! Attempt to update from an older database format.
     //! Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+
+    //! Compact the whole database (see compactchainstate).
+    void Compact() const;
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
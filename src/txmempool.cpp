@@ -80,7 +80,8 @@ void CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         // If we're not searching for parents, we require this to be an entry in
         // the mempool already.
         txiter it = mapTx.iterator_to(entry);
-        parentHashes = GetMemPoolParents(it);
+        const linkedEntries &parents = GetMemPoolParents(it);
+        parentHashes.insert(parents.begin(), parents.end());
     }
 
     while (!parentHashes.empty()) {
@@ -89,7 +90,7 @@ void CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         setAncestors.insert(stageit);
         parentHashes.erase(parentHashes.begin());
 
-        const setEntries &setMemPoolParents = GetMemPoolParents(stageit);
+        const linkedEntries &setMemPoolParents = GetMemPoolParents(stageit);
         for (txiter phash : setMemPoolParents) {
             // If this is a new ancestor, add it.
             if (!algo::contains(setAncestors, phash)) {
@@ -106,24 +107,23 @@ void CTxMemPool::UpdateParentsOf(bool add, txiter it) {
     }
 }
 
-void CTxMemPool::UpdateChildrenForRemoval(txiter it) {
-    const setEntries &setMemPoolChildren = GetMemPoolChildren(it);
-    for (txiter updateIt : setMemPoolChildren) {
-        UpdateParent(updateIt, it, false);
-    }
-}
-
 void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove) {
+    // Sever the links pointing to each transaction being removed from its
+    // in-mempool parents and children. The links between two transactions
+    // which are both being removed go away with their mapLinks entries, so
+    // chains removed together, as when a block confirms them, are not
+    // unlinked one transaction at a time.
     for (txiter removeIt : entriesToRemove) {
-        // Note that UpdateParentsOf severs the child links that point to
-        // removeIt in the mapLinks entries for the parents of removeIt.
-        UpdateParentsOf(false, removeIt);
-    }
-    // After updating all the parent links, we can now sever the link between
-    // each transaction being removed and any mempool children (ie, update
-    // setMemPoolParents for each direct child of a transaction being removed).
-    for (txiter removeIt : entriesToRemove) {
-        UpdateChildrenForRemoval(removeIt);
+        for (txiter piter : GetMemPoolParents(removeIt)) {
+            if (!algo::contains(entriesToRemove, piter)) {
+                UpdateChild(piter, removeIt, false);
+            }
+        }
+        for (txiter citer : GetMemPoolChildren(removeIt)) {
+            if (!algo::contains(entriesToRemove, citer)) {
+                UpdateParent(citer, removeIt, false);
+            }
+        }
     }
 }
 
@@ -148,12 +148,10 @@ bool CTxMemPool::isSpent(const COutPoint &outpoint) const {
 }
 
 unsigned int CTxMemPool::GetTransactionsUpdated() const {
-    LOCK(cs);
     return nTransactionsUpdated;
 }
 
 void CTxMemPool::AddTransactionsUpdated(unsigned int n) {
-    LOCK(cs);
     nTransactionsUpdated += n;
 }
 
@@ -247,7 +245,7 @@ void CTxMemPool::CalculateDescendants(txiter entryit,
         setDescendants.insert(it);
         stage.erase(stage.begin());
 
-        const setEntries &setChildren = GetMemPoolChildren(it);
+        const linkedEntries &setChildren = GetMemPoolChildren(it);
         for (txiter childiter : setChildren) {
             if (!algo::contains(setDescendants, childiter)) {
                 stage.insert(childiter);
@@ -286,24 +284,9 @@ void CTxMemPool::removeRecursive(const CTransaction &origTx,
     RemoveStaged(setAllRemoves, reason);
 }
 
-void CTxMemPool::removeConflicts(const CTransaction &tx) {
-    // Remove transactions which depend on inputs of tx, recursively
-    AssertLockHeld(cs);
-    for (const CTxIn &txin : tx.vin) {
-        auto it = mapNextTx.find(txin.prevout);
-        if (it != mapNextTx.end()) {
-            const CTransaction &txConflict = *it->second;
-            if (txConflict != tx) {
-                ClearPrioritisation(txConflict.GetId());
-                removeRecursive(txConflict, MemPoolRemovalReason::CONFLICT);
-            }
-        }
-    }
-}
-
 /**
- * Called when a block is connected. Removes from mempool and updates the miner
- * fee estimator.
+ * Called when a block is connected. Removes the transactions of the block, and
+ * those conflicting with them, from the mempool.
  */
 void CTxMemPool::removeForBlock(const std::vector<CTransactionRef> &vtx) {
     LOCK(cs);
@@ -314,30 +297,49 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef> &vtx) {
         return;
     }
 
-    DisconnectedBlockTransactions disconnectpool;
-    disconnectpool.addForBlock(vtx);
+    // Remove all the transactions of the block which are in the mempool in one
+    // go. Without ancestor state to maintain, the order in which they are
+    // removed does not matter, and collecting them sorted by entry id builds
+    // the set without rebalancing it.
+    std::vector<txiter> confirmed;
+    confirmed.reserve(std::min(vtx.size(), mapTx.size()));
+    for (const CTransactionRef &tx : vtx) {
+        if (const txiter it = mapTx.find(tx->GetId()); it != mapTx.end()) {
+            confirmed.push_back(it);
+        }
+    }
+    std::sort(confirmed.begin(), confirmed.end(), CompareIteratorByEntryId());
+    RemoveStaged(setEntries(confirmed.begin(), confirmed.end()), MemPoolRemovalReason::BLOCK);
+
+    // Whatever still spends the inputs of the block's transactions conflicts
+    // with them, and is removed along with its descendants, again in one go.
+    setEntries conflicts;
+    for (const CTransactionRef &tx : vtx) {
+        for (const CTxIn &txin : tx->vin) {
+            const auto it = mapNextTx.find(txin.prevout);
+            if (it == mapNextTx.end()) {
+                continue;
+            }
+            const txiter conflictit = mapTx.find(it->second->GetId());
+            assert(conflictit != mapTx.end());
+            if (!algo::contains(conflicts, conflictit)) {
+                mapDeltas.erase(conflictit->GetTx().GetId());
+                CalculateDescendants(conflictit, conflicts);
+            }
+        }
+    }
+    RemoveStaged(conflicts, MemPoolRemovalReason::CONFLICT);
 
-    // iterate in topological order (parents before children)
-    for (const CTransactionRef &tx : reverse_iterate(disconnectpool.GetQueuedTx().get<insertion_order>())) {
-        const txiter it = mapTx.find(tx->GetId());
-        if (it != mapTx.end()) {
-            setEntries stage;
-            stage.insert(it);
-            RemoveStaged(stage, MemPoolRemovalReason::BLOCK);
-        } else {
-            removeConflicts(*tx);
+    // clear prioritisations (mapDeltas); optimized for the common case where
+    // mapDeltas is empty
+    if (!mapDeltas.empty()) {
+        for (const CTransactionRef &tx : vtx) {
+            mapDeltas.erase(tx->GetId());
         }
     }
-    // clear prioritisations (mapDeltas); optmized for the common case where
-    // mapDeltas is empty or much smaller than block.vtx
-    algo::erase_if(mapDeltas, [&disconnectpool](const auto &kv) {
-        return algo::contains(disconnectpool.GetQueuedTx(), kv.first);
-    });
 
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = true;
-
-    disconnectpool.clear();
 }
 
 void CTxMemPool::_clear(bool clearDspOrphans /*= true*/) {
@@ -423,7 +425,9 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const {
             assert(it3->first == &txin.prevout);
             assert(it3->second == &tx);
         }
-        assert(setParentCheck == GetMemPoolParents(it));
+        const linkedEntries &parents = GetMemPoolParents(it);
+        assert(std::equal(setParentCheck.begin(), setParentCheck.end(),
+                          parents.begin(), parents.end()));
         // Verify ancestor state is correct.
         setEntries setAncestors;
         CalculateMemPoolAncestors(*it, setAncestors);
@@ -442,7 +446,9 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const {
             assert(childit != mapTx.end());
             setChildrenCheck.insert(childit);
         }
-        assert(setChildrenCheck == GetMemPoolChildren(it));
+        const linkedEntries &children = GetMemPoolChildren(it);
+        assert(std::equal(setChildrenCheck.begin(), setChildrenCheck.end(),
+                          children.begin(), children.end()));
 
         if (fDependsWait) {
             waitingOnDependants.push_back(&(*it));
@@ -519,6 +525,55 @@ std::vector<TxMempoolInfo> CTxMemPool::infoAll() const {
     return ret;
 }
 
+MempoolSnapshot::Entry CTxMemPool::GetSnapshotEntry(txiter it) const {
+    AssertLockHeld(cs);
+    MempoolSnapshot::Entry entry{GetInfo(it), it->GetFee(), it->GetTxSize(),
+                                 {}, {}};
+    const linkedEntries &parents = GetMemPoolParents(it);
+    entry.parents.reserve(parents.size());
+    for (txiter parentit : parents) {
+        entry.parents.push_back(parentit->GetTx().GetId());
+    }
+    const linkedEntries &children = GetMemPoolChildren(it);
+    entry.children.reserve(children.size());
+    for (txiter childit : children) {
+        entry.children.push_back(childit->GetTx().GetId());
+    }
+    return entry;
+}
+
+std::shared_ptr<const MempoolSnapshot> CTxMemPool::GetSnapshot() const {
+    {
+        LOCK(cs_snapshot);
+        if (m_snapshot &&
+            m_snapshot->nTransactionsUpdated == nTransactionsUpdated) {
+            return m_snapshot;
+        }
+    }
+
+    LOCK(cs);
+    {
+        // Another reader may have made it while we waited for cs.
+        LOCK(cs_snapshot);
+        if (m_snapshot &&
+            m_snapshot->nTransactionsUpdated == nTransactionsUpdated) {
+            return m_snapshot;
+        }
+    }
+
+    auto snapshot = std::make_shared<MempoolSnapshot>();
+    snapshot->nTransactionsUpdated = nTransactionsUpdated;
+    snapshot->entries.reserve(mapTx.size());
+    const auto &index = mapTx.get<entry_id>();
+    for (auto it = index.begin(); it != index.end(); ++it) {
+        snapshot->entries.push_back(GetSnapshotEntry(mapTx.project<0>(it)));
+    }
+
+    LOCK(cs_snapshot);
+    m_snapshot = std::move(snapshot);
+    return m_snapshot;
+}
+
 CTransactionRef CTxMemPool::get(const TxId &txid) const {
     LOCK(cs);
     indexed_transaction_set::const_iterator i = mapTx.find(txid);
@@ -561,6 +616,7 @@ void CTxMemPool::PrioritiseTransaction(const TxId &txid,
         if (it != mapTx.end()) {
             mapTx.modify(it, update_fee_delta(delta));
             ++nTransactionsUpdated;
+            NotifyEntryPrioritised(txid);
         }
     }
     LogPrintf("PrioritiseTransaction: %s fee += %s\n", txid.ToString(),
@@ -688,27 +744,43 @@ void CTxMemPool::LimitSize(size_t limit, unsigned long age) {
     }
 }
 
-// NB: The pointer type is only used for template overload selection and never dereferenced so this is safe.
-inline constexpr size_t setEntriesIncrementalUsage =
-        memusage::IncrementalDynamicUsage(static_cast<CTxMemPool::setEntries *>(nullptr));
+/// Add `it` to, or remove it from, the sorted `links`. Returns false if it
+/// already was, or was not, there.
+static bool UpdateLinks(CTxMemPool::linkedEntries &links, CTxMemPool::txiter it, bool add) {
+    const auto pos = std::lower_bound(links.begin(), links.end(), it, CTxMemPool::CompareIteratorByEntryId());
+    const bool found = pos != links.end() && *pos == it;
+    if (add && !found) {
+        links.insert(pos, it);
+        return true;
+    }
+    if (!add && found) {
+        links.erase(pos);
+        return true;
+    }
+    return false;
+}
 
 void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add) {
-    if (add && mapLinks[entry].children.insert(child).second) {
-        cachedInnerUsage += setEntriesIncrementalUsage;
-    } else if (!add && mapLinks[entry].children.erase(child)) {
-        cachedInnerUsage -= setEntriesIncrementalUsage;
+    linkedEntries &children = mapLinks[entry].children;
+    const size_t usage = memusage::DynamicUsage(children);
+    if (UpdateLinks(children, child, add)) {
+        // The links only take memory of their own once they spill out of the
+        // inline storage.
+        cachedInnerUsage -= usage;
+        cachedInnerUsage += memusage::DynamicUsage(children);
     }
 }
 
 void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add) {
-    if (add && mapLinks[entry].parents.insert(parent).second) {
-        cachedInnerUsage += setEntriesIncrementalUsage;
-    } else if (!add && mapLinks[entry].parents.erase(parent)) {
-        cachedInnerUsage -= setEntriesIncrementalUsage;
+    linkedEntries &parents = mapLinks[entry].parents;
+    const size_t usage = memusage::DynamicUsage(parents);
+    if (UpdateLinks(parents, parent, add)) {
+        cachedInnerUsage -= usage;
+        cachedInnerUsage += memusage::DynamicUsage(parents);
     }
 }
 
-const CTxMemPool::setEntries &
+const CTxMemPool::linkedEntries &
 CTxMemPool::GetMemPoolParents(txiter entry) const {
     assert(entry != mapTx.end());
     auto it = mapLinks.find(entry);
@@ -716,7 +788,7 @@ CTxMemPool::GetMemPoolParents(txiter entry) const {
     return it->second.parents;
 }
 
-const CTxMemPool::setEntries &
+const CTxMemPool::linkedEntries &
 CTxMemPool::GetMemPoolChildren(txiter entry) const {
     assert(entry != mapTx.end());
     auto it = mapLinks.find(entry);
@@ -11,6 +11,7 @@
 #include <core_memusage.h>
 #include <dsproof/dspid.h>
 #include <indirectmap.h>
+#include <prevector.h>
 #include <primitives/transaction.h>
 #include <random.h>
 #include <sync.h>
@@ -22,6 +23,7 @@
 #include <boost/multi_index_container.hpp>
 #include <boost/signals2/signal.hpp>
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <optional>
@@ -220,6 +222,30 @@ struct TxMempoolInfo {
     Amount nFeeDelta;
 };
 
+/**
+ * An immutable copy of the mempool contents, which readers can go through
+ * without holding CTxMemPool::cs (see CTxMemPool::GetSnapshot()).
+ */
+struct MempoolSnapshot {
+    struct Entry {
+        TxMempoolInfo info;
+        /** The fee without the delta */
+        Amount nFee;
+        size_t nTxSize;
+        /** In-mempool parents, by txid */
+        std::vector<TxId> parents;
+        /** In-mempool children, in the order of their entry ids */
+        std::vector<TxId> children;
+
+        Amount GetModifiedFee() const { return nFee + info.nFeeDelta; }
+    };
+
+    /** CTxMemPool::GetTransactionsUpdated() as of the copy */
+    unsigned int nTransactionsUpdated;
+    /** In the order of their entry ids, so parents come before children */
+    std::vector<Entry> entries;
+};
+
 /**
  * Reason why a transaction was removed from the mempool, this is passed to the
  * notification signal.
@@ -295,8 +321,10 @@ class CTxMemPool {
 private:
     //! Value n means that n times in 2^32 we check.
     uint32_t nCheckFrequency GUARDED_BY(cs);
-    //! Used by getblocktemplate to trigger CreateNewBlock() invocation
-    unsigned int nTransactionsUpdated;
+    //! Used by getblocktemplate to trigger CreateNewBlock() invocation, and by
+    //! GetSnapshot() to tell whether its last copy is stale. Changes to the
+    //! mempool contents bump it with cs held; it is read without cs.
+    std::atomic<unsigned int> nTransactionsUpdated;
 
     //! sum of all mempool tx's sizes.
     size_t totalTxSize;
@@ -384,9 +412,17 @@ public:
     };
     using setEntries = std::set<txiter, CompareIteratorByEntryId>;
 
-    const setEntries &GetMemPoolParents(txiter entry) const
+    /**
+     * The in-mempool parents or children of an entry, sorted by entry id like
+     * setEntries. Even in long chains of unconfirmed transactions most entries
+     * only have one or two of them, so they are kept inline rather than in a
+     * tree with a node per link.
+     */
+    using linkedEntries = prevector<2, txiter>;
+
+    const linkedEntries &GetMemPoolParents(txiter entry) const
         EXCLUSIVE_LOCKS_REQUIRED(cs);
-    const setEntries &GetMemPoolChildren(txiter entry) const
+    const linkedEntries &GetMemPoolChildren(txiter entry) const
         EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     /**
@@ -489,8 +525,8 @@ private:
     DspDescendants getDspDescendantsForIter(txiter) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     struct TxLinks {
-        setEntries parents;
-        setEntries children;
+        linkedEntries parents;
+        linkedEntries children;
     };
 
     using txlinksMap = std::map<txiter, TxLinks, CompareIteratorByEntryId>;
@@ -536,7 +572,6 @@ public:
     void removeRecursive(
         const CTransaction &tx,
         MemPoolRemovalReason reason = MemPoolRemovalReason::UNKNOWN);
-    void removeConflicts(const CTransaction &tx) EXCLUSIVE_LOCKS_REQUIRED(cs);
     void removeForBlock(const std::vector<CTransactionRef> &vtx);
 
     void clear(bool clearDspOrphans = true);
@@ -673,6 +708,16 @@ public:
     TxMempoolInfo info(const TxId &txid) const;
     std::vector<TxMempoolInfo> infoAll() const;
 
+    /**
+     * The contents of the mempool as of its last change. The copy is only
+     * made, with cs held, by the first caller after a change; the others share
+     * it without taking cs, so polling readers do not hold up admission.
+     */
+    std::shared_ptr<const MempoolSnapshot> GetSnapshot() const;
+    /** The snapshot entry of `it`, made as GetSnapshot() would */
+    MempoolSnapshot::Entry GetSnapshotEntry(txiter it) const
+        EXCLUSIVE_LOCKS_REQUIRED(cs);
+
     CFeeRate estimateFee() const;
 
     size_t DynamicMemoryUsage() const;
@@ -680,6 +725,8 @@ public:
     boost::signals2::signal<void(CTransactionRef)> NotifyEntryAdded;
     boost::signals2::signal<void(CTransactionRef, MemPoolRemovalReason)>
         NotifyEntryRemoved;
+    /** Fired by PrioritiseTransaction() when the fee delta of an entry changes */
+    boost::signals2::signal<void(const TxId &)> NotifyEntryPrioritised;
 
 private:
     /**
@@ -693,8 +740,6 @@ private:
      */
     void UpdateForRemoveFromMempool(const setEntries &entriesToRemove)
         EXCLUSIVE_LOCKS_REQUIRED(cs);
-    /** Sever link between specified transaction and direct children. */
-    void UpdateChildrenForRemoval(txiter entry) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     /**
      * Before calling removeUnchecked for a given transaction,
@@ -710,6 +755,11 @@ private:
         EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     std::unique_ptr<DoubleSpendProofStorage> m_dspStorage;
+
+    /** Guards m_snapshot; taken after cs, never before */
+    mutable Mutex cs_snapshot;
+    mutable std::shared_ptr<const MempoolSnapshot>
+        m_snapshot GUARDED_BY(cs_snapshot);
 };
 
 /**
@@ -0,0 +1,193 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <utxo_commitment.h>
+
+#include <coins.h>
+#include <ec_multiset.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <streams.h>
+#include <undo.h>
+#include <version.h>
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+/** Number of coins below which hashing them is not worth a task of its own */
+constexpr size_t MIN_COINS_PER_TASK = 512;
+/** Maximum number of tasks the coins of a block are hashed in */
+constexpr size_t MAX_TASKS = 64;
+
+/** A UTXOCommitment being updated with the coins of a block */
+class UTXOCommitmentUpdate {
+    ECMultiSet set;
+    UTXOCommitment result;
+    //! The coins added to and removed from the set, hashed in Finish()
+    std::vector<std::pair<COutPoint, Coin>> added;
+    std::vector<std::pair<COutPoint, Coin>> removed;
+
+    /** Hash the i-th coin, of added and then removed, into `partial` */
+    void Apply(ECMultiSet &partial, size_t i) const {
+        if (i < added.size()) {
+            ApplyCoinHash(partial, added[i].first, added[i].second);
+        } else {
+            const auto &[outpoint, coin] = removed[i - added.size()];
+            RemoveCoinHash(partial, outpoint, coin);
+        }
+    }
+
+public:
+    explicit UTXOCommitmentUpdate(const UTXOCommitment &commitment)
+        : set(commitment.multiset), result(commitment) {}
+
+    void Add(const COutPoint &outpoint, const Coin &coin) {
+        added.emplace_back(outpoint, coin);
+        const CTxOut &txout = coin.GetTxOut();
+        result.nTransactionOutputs++;
+        result.nBogoSize += GetBogoSize(txout.scriptPubKey);
+        result.nTotalAmount += txout.nValue;
+    }
+
+    void Remove(const COutPoint &outpoint, const Coin &coin) {
+        removed.emplace_back(outpoint, coin);
+        const CTxOut &txout = coin.GetTxOut();
+        result.nTransactionOutputs--;
+        result.nBogoSize -= GetBogoSize(txout.scriptPubKey);
+        result.nTotalAmount -= txout.nValue;
+    }
+
+    /** Add (or remove) the spendable outputs created by `block` */
+    void ApplyOutputs(const CBlock &block, int nHeight, bool fAdd) {
+        for (const auto &ptx : block.vtx) {
+            const CTransaction &tx = *ptx;
+            for (size_t o = 0; o < tx.vout.size(); o++) {
+                // Like AddCoin, which does not add them to the UTXO set.
+                if (tx.vout[o].scriptPubKey.IsUnspendable()) {
+                    continue;
+                }
+                const COutPoint outpoint(tx.GetId(), o);
+                const Coin coin(tx.vout[o], nHeight, tx.IsCoinBase());
+                if (fAdd) {
+                    Add(outpoint, coin);
+                } else {
+                    Remove(outpoint, coin);
+                }
+            }
+        }
+    }
+
+    /** Remove (or add back) the coins spent by `block` */
+    void ApplySpent(const CBlock &block, const CBlockUndo &blockundo,
+                    bool fRemove) {
+        assert(blockundo.vtxundo.size() + 1 == block.vtx.size());
+        for (size_t i = 1; i < block.vtx.size(); i++) {
+            const CTransaction &tx = *block.vtx[i];
+            const CTxUndo &txundo = blockundo.vtxundo[i - 1];
+            assert(txundo.vprevout.size() == tx.vin.size());
+            for (size_t j = 0; j < tx.vin.size(); j++) {
+                if (fRemove) {
+                    Remove(tx.vin[j].prevout, txundo.vprevout[j]);
+                } else {
+                    Add(tx.vin[j].prevout, txundo.vprevout[j]);
+                }
+            }
+        }
+    }
+
+    UTXOCommitment Finish(const UTXOCommitmentTaskRunner &runTasks) {
+        // Points on the curve are added and removed in any order, so each
+        // task hashes a range of the coins into a set of its own, and these
+        // sets are then combined.
+        const size_t nCoins = added.size() + removed.size();
+        const size_t nTasks =
+            runTasks ? std::min(nCoins / MIN_COINS_PER_TASK, MAX_TASKS) : 0;
+        if (nTasks < 2) {
+            for (size_t i = 0; i < nCoins; ++i) {
+                Apply(set, i);
+            }
+        } else {
+            std::vector<ECMultiSet> partials(nTasks);
+            std::vector<std::function<void()>> tasks;
+            tasks.reserve(nTasks);
+            for (size_t t = 0; t < nTasks; ++t) {
+                tasks.emplace_back([this, &partials, t, nTasks, nCoins] {
+                    const size_t end = (t + 1) * nCoins / nTasks;
+                    for (size_t i = t * nCoins / nTasks; i < end; ++i) {
+                        Apply(partials[t], i);
+                    }
+                });
+            }
+            runTasks(tasks);
+            for (const ECMultiSet &partial : partials) {
+                set.Combine(partial);
+            }
+        }
+        result.multiset = set.GetPubKeyBytes();
+        return result;
+    }
+};
+} // namespace
+
+CDataStream SerializeCoin(const COutPoint &outpoint, const Coin &coin) {
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << outpoint;
+    ss << uint32_t(coin.GetHeight() * 2 + coin.IsCoinBase());
+    ss << coin.GetTxOut();
+    return ss;
+}
+
+void ApplyCoinHash(ECMultiSet &set, const COutPoint &outpoint,
+                   const Coin &coin) {
+    set.Add(MakeUInt8Span(SerializeCoin(outpoint, coin)));
+}
+
+void RemoveCoinHash(ECMultiSet &set, const COutPoint &outpoint,
+                    const Coin &coin) {
+    set.Remove(MakeUInt8Span(SerializeCoin(outpoint, coin)));
+}
+
+uint64_t GetBogoSize(const CScript &scriptPubKey) {
+    return 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ +
+           8 /* amount */ + 2 /* scriptPubKey len */ +
+           scriptPubKey.size() /* scriptPubKey */;
+}
+
+UTXOCommitment::UTXOCommitment(const ECMultiSet &set,
+                               uint64_t nTransactionOutputsIn,
+                               uint64_t nBogoSizeIn, Amount nTotalAmountIn)
+    : multiset(set.GetPubKeyBytes()),
+      nTransactionOutputs(nTransactionOutputsIn), nBogoSize(nBogoSizeIn),
+      nTotalAmount(nTotalAmountIn) {}
+
+uint256 UTXOCommitment::GetHash() const {
+    return ECMultiSet(multiset).GetHash();
+}
+
+UTXOCommitment ConnectBlockToUTXOCommitment(
+    const UTXOCommitment &prev, const CBlock &block,
+    const CBlockUndo &blockundo, int nHeight,
+    const std::vector<std::pair<COutPoint, Coin>> &overwritten,
+    const UTXOCommitmentTaskRunner &runTasks) {
+    UTXOCommitmentUpdate update(prev);
+    for (const auto &[outpoint, coin] : overwritten) {
+        update.Remove(outpoint, coin);
+    }
+    update.ApplySpent(block, blockundo, true);
+    update.ApplyOutputs(block, nHeight, true);
+    return update.Finish(runTasks);
+}
+
+UTXOCommitment DisconnectBlockFromUTXOCommitment(
+    const UTXOCommitment &commitment, const CBlock &block,
+    const CBlockUndo &blockundo, int nHeight,
+    const UTXOCommitmentTaskRunner &runTasks) {
+    // The coins overwritten by a duplicate coinbase are not restored by
+    // DisconnectBlock either.
+    UTXOCommitmentUpdate update(commitment);
+    update.ApplyOutputs(block, nHeight, false);
+    update.ApplySpent(block, blockundo, false);
+    return update.Finish(runTasks);
+}
@@ -0,0 +1,100 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <amount.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+class CBlock;
+class CBlockUndo;
+class Coin;
+class COutPoint;
+class CScript;
+class CDataStream;
+class ECMultiSet;
+
+/**
+ * The bytes a coin is hashed as into the ECMultiSet of a UTXO set: its
+ * outpoint, its height and coinbase flag, and its output.
+ */
+CDataStream SerializeCoin(const COutPoint &outpoint, const Coin &coin);
+
+/**
+ * Add a coin to the ECMultiSet hash of a UTXO set. The hash of a snapshot,
+ * checked against CChainParams::AssumeutxoForHeight when loading it, is made of
+ * all of its coins this way.
+ */
+void ApplyCoinHash(ECMultiSet &set, const COutPoint &outpoint, const Coin &coin);
+
+/** Remove a coin added with ApplyCoinHash from the hash of a UTXO set */
+void RemoveCoinHash(ECMultiSet &set, const COutPoint &outpoint, const Coin &coin);
+
+/** Database-independent size of a coin, as reported by gettxoutsetinfo */
+uint64_t GetBogoSize(const CScript &scriptPubKey);
+
+/**
+ * Commitment to the UTXO set after connecting a block: the ECMultiSet of its
+ * coins and the statistics gettxoutsetinfo reports about them. With
+ * -utxocommitment, it is maintained from block to block by ConnectBlock and
+ * DisconnectBlock, rather than computed by walking the coins database.
+ */
+struct UTXOCommitment {
+    //! The ECMultiSet of the coins, serialized (all zeroes if there are none)
+    std::array<uint8_t, 33> multiset{};
+    uint64_t nTransactionOutputs = 0;
+    uint64_t nBogoSize = 0;
+    Amount nTotalAmount = Amount::zero();
+
+    UTXOCommitment() = default;
+    UTXOCommitment(const ECMultiSet &set, uint64_t nTransactionOutputsIn,
+                   uint64_t nBogoSizeIn, Amount nTotalAmountIn);
+
+    /** The hash of the ECMultiSet of the coins */
+    uint256 GetHash() const;
+
+    SERIALIZE_METHODS(UTXOCommitment, obj) {
+        READWRITE(obj.multiset, VARINT(obj.nTransactionOutputs),
+                  VARINT(obj.nBogoSize), obj.nTotalAmount);
+    }
+};
+
+/**
+ * Runs the given tasks, which are independent of each other, possibly in
+ * parallel, and returns once all of them are done.
+ */
+using UTXOCommitmentTaskRunner =
+    std::function<void(std::vector<std::function<void()>> &tasks)>;
+
+/**
+ * The commitment after connecting `block` at height `nHeight` to the UTXO set
+ * committed to by `prev`. The coins it spent are in `blockundo`; those its
+ * coinbase replaced without spending them (see BIP30) in `overwritten`.
+ * Hashing the coins is most of the work. If `runTasks` is set, it is given
+ * that work split into tasks, whose results are then combined.
+ */
+UTXOCommitment
+ConnectBlockToUTXOCommitment(
+    const UTXOCommitment &prev, const CBlock &block,
+    const CBlockUndo &blockundo, int nHeight,
+    const std::vector<std::pair<COutPoint, Coin>> &overwritten,
+    const UTXOCommitmentTaskRunner &runTasks = nullptr);
+
+/**
+ * The commitment before connecting `block` at height `nHeight`, given the one
+ * after it. The coins it spent are in `blockundo`. `runTasks` is as for
+ * ConnectBlockToUTXOCommitment.
+ */
+UTXOCommitment
+DisconnectBlockFromUTXOCommitment(
+    const UTXOCommitment &commitment, const CBlock &block,
+    const CBlockUndo &blockundo, int nHeight,
+    const UTXOCommitmentTaskRunner &runTasks = nullptr);
@@ -22,11 +22,13 @@
 #include <consensus/validation.h>
 #include <dsproof/dsproof.h>
 #include <dsproof/storage.h>
+#include <ec_multiset.h>
 #include <flatfile.h>
 #include <fs.h>
 #include <hash.h>
 #include <index/txindex.h>
 #include <node/blockstorage.h>
+#include <node/utxo_snapshot.h>
 #include <policy/fees.h>
 #include <policy/mempool.h>
 #include <policy/policy.h>
@@ -41,7 +43,9 @@
 #include <script/standard.h>
 #include <shutdown.h>
 #include <span.h>
+#include <streams.h>
 #include <timedata.h>
+#include <threadinterrupt.h>
 #include <tinyformat.h>
 #include <txdb.h>
 #include <txmempool.h>
@@ -53,17 +57,21 @@
 #include <util/string.h>
 #include <util/system.h>
 #include <util/time.h>
+#include <utxo_commitment.h>
 #include <validationinterface.h>
 #include <warnings.h>
 
 #include <algorithm>
 #include <atomic>
 #include <deque>
+#include <functional>
 #include <limits>
 #include <list>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <thread>
+#include <unordered_set>
 #include <utility>
 
 #define MICRO 0.000001
@@ -169,7 +177,8 @@ public:
     bool ConnectBlock(const CBlock &block, CValidationState &state,
                       CBlockIndex *pindex, CCoinsViewCache &view,
                       const CChainParams &params,
-                      BlockValidationOptions options, bool fJustCheck = false)
+                      BlockValidationOptions options, bool fJustCheck = false,
+                      BlockTemplateValidityCache *templateCache = nullptr)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Block disconnection on our pcoinsTip:
@@ -197,6 +206,10 @@ public:
 
     bool ReplayBlocks(const Consensus::Params &params, CCoinsView *view);
     bool LoadGenesisBlock(const CChainParams &chainparams);
+    bool LoadUTXOSnapshot(const Config &config, CAutoFile &coins_file,
+                          const SnapshotMetadata &metadata,
+                          const AssumeutxoData &au_data,
+                          CValidationState &state) LOCKS_EXCLUDED(cs_main);
 
     void PruneBlockIndexCandidates();
 
@@ -234,6 +247,8 @@ private:
     void ReceivedBlockTransactions(const CBlock &block, CBlockIndex *pindexNew,
                                    const FlatFilePos &pos)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    void LinkBlockTransactions(CBlockIndex *pindexNew)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     bool RollforwardBlock(const CBlockIndex *pindex, CCoinsViewCache &inputs,
                           const Consensus::Params &params)
@@ -267,6 +282,12 @@ bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
+bool fUtxoPrefetch = DEFAULT_UTXO_PREFETCH;
+bool fTxPrecheck = DEFAULT_TX_PRECHECK;
+bool fUtxoBackgroundFlush = DEFAULT_UTXO_BACKGROUND_FLUSH;
+bool fUtxoCommitment = DEFAULT_UTXO_COMMITMENT;
+bool fSchnorrBatchVerify = DEFAULT_SCHNORR_BATCH_VERIFY;
+std::atomic<uint64_t> nBlockTxsPrecomputed{0};
 size_t nCoinCacheUsage = 5000 * 300;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
 
@@ -1156,12 +1177,17 @@ void UpdateCoins(CCoinsViewCache &view, const CTransaction &tx, int nHeight) {
     AddCoins(view, tx, nHeight);
 }
 
+/** Schnorr signatures deferred by the CScriptChecks run on this thread */
+static thread_local SchnorrBatchVerifier schnorrBatch;
+
 bool CScriptCheck::operator()() {
     assert(bool(context));
     assert(bool(context->tx().constantTx()));
+    assert(!batchSchnorr || (nFlags & SCRIPT_VERIFY_NULLFAIL));
 
     if ( ! VerifyScript(context->scriptSig(), context->coinScriptPubKey(), nFlags,
-                        CachingTransactionSignatureChecker(*context, cacheStore, txdata),
+                        CachingTransactionSignatureChecker(*context, cacheStore, txdata,
+                                                           batchSchnorr ? &schnorrBatch : nullptr),
                         metrics, &error)) {
         return false;
     }
@@ -1178,6 +1204,14 @@ bool CScriptCheck::operator()() {
     return true;
 }
 
+bool FinishScriptCheckBatch(bool fChecksOk) {
+    if (!fChecksOk) {
+        schnorrBatch.Clear();
+        return false;
+    }
+    return schnorrBatch.Verify();
+}
+
 int GetSpendHeight(const CCoinsViewCache &inputs) {
     LOCK(cs_main);
     CBlockIndex *pindexPrev = LookupBlockIndex(inputs.GetBestBlock());
@@ -1190,7 +1224,8 @@ bool CheckInputs(const CTransaction &tx, CValidationState &state,
                  PrecomputedTransactionData &txdata, int &nSigChecksOut,
                  TxSigCheckLimiter &txLimitSigChecks,
                  CheckInputsLimiter *pBlockLimitSigChecks,
-                 std::vector<CScriptCheck> *pvChecks) {
+                 std::vector<CScriptCheck> *pvChecks,
+                 const std::vector<ScriptExecutionContext> *pPrecomputedContexts) {
     AssertLockHeld(cs_main);
     assert(!tx.IsCoinBase());
 
@@ -1224,7 +1259,13 @@ bool CheckInputs(const CTransaction &tx, CValidationState &state,
 
     int nSigChecksTotal = 0;
 
-    auto contextVec = ScriptExecutionContext::createForAllInputs(tx, view);
+    std::vector<ScriptExecutionContext> ownContextVec;
+    if (!pPrecomputedContexts) {
+        ownContextVec = ScriptExecutionContext::createForAllInputs(tx, view);
+    }
+    const auto &contextVec =
+        pPrecomputedContexts ? *pPrecomputedContexts : ownContextVec;
+    assert(contextVec.size() == tx.vin.size());
 
     for (size_t i = 0; i < tx.vin.size(); ++i) {
         assert(!contextVec[i].coin().IsSpent());
@@ -1238,8 +1279,12 @@ bool CheckInputs(const CTransaction &tx, CValidationState &state,
         // additional data in, eg, the coins being spent being checked as a part
         // of CScriptCheck.
 
-        // Verify signature
-        CScriptCheck check(contextVec[i], flags, sigCacheStore, txdata, &txLimitSigChecks, pBlockLimitSigChecks);
+        // Verify signature. Checks deferred to the caller run on the script
+        // check queue, which verifies their Schnorr signatures in batches if
+        // enabled (see FinishScriptCheckBatch).
+        const bool batchSchnorr = pvChecks && fSchnorrBatchVerify && (flags & SCRIPT_VERIFY_NULLFAIL);
+        CScriptCheck check(contextVec[i], flags, sigCacheStore, txdata, &txLimitSigChecks, pBlockLimitSigChecks,
+                           batchSchnorr);
 
         // If pvChecks is not null, defer the check execution to the caller.
         if (pvChecks) {
@@ -1334,6 +1379,8 @@ DisconnectResult UndoCoinSpend(const Coin &undo, CCoinsViewCache &view,
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
+static UTXOCommitmentTaskRunner GetUTXOCommitmentTaskRunner();
+
 /**
  * Undo the effects of this block (with given index) on the UTXO set represented
  * by coins. When FAILED is returned, view is left in an indeterminate state.
@@ -1347,7 +1394,20 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock &block,
         return DISCONNECT_FAILED;
     }
 
-    return ApplyBlockUndo(blockUndo, block, pindex, view);
+    const DisconnectResult res = ApplyBlockUndo(blockUndo, block, pindex, view);
+
+    // The commitment to the UTXO set of the parent may not be known yet, if
+    // the block was connected from a snapshot or from a seeded commitment.
+    if (res == DISCONNECT_OK && fUtxoCommitment && pindex->utxoCommitment &&
+        !pindex->pprev->utxoCommitment) {
+        pindex->pprev->utxoCommitment = std::make_shared<const UTXOCommitment>(
+            DisconnectBlockFromUTXOCommitment(*pindex->utxoCommitment, block,
+                                              blockUndo, pindex->nHeight,
+                                              GetUTXOCommitmentTaskRunner()));
+        setDirtyBlockIndex.insert(pindex->pprev);
+    }
+
+    return res;
 }
 
 DisconnectResult ApplyBlockUndo(const CBlockUndo &blockUndo,
@@ -1411,16 +1471,449 @@ DisconnectResult ApplyBlockUndo(const CBlockUndo &blockUndo,
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+static CCheckQueue<CScriptCheck> scriptcheckqueue(128, "scriptch",
+                                                  FinishScriptCheckBatch);
+
+namespace {
+/**
+ * Closure representing the read of one outpoint from the coins database, on
+ * behalf of a block about to be connected. The result is written to a slot
+ * owned by the caller; a spent (default constructed) Coin is left there if the
+ * coin could not be found.
+ */
+class CCoinsPrefetchCheck {
+    const CCoinsView *db{};
+    const COutPoint *outpoint{};
+    Coin *coin{};
 
-void StartScriptCheckWorkerThreads(int threads_num) {
-    scriptcheckqueue.StartWorkerThreads(threads_num);
+public:
+    CCoinsPrefetchCheck() = default;
+    CCoinsPrefetchCheck(const CCoinsView *dbIn, const COutPoint *outpointIn,
+                        Coin *coinIn)
+        : db(dbIn), outpoint(outpointIn), coin(coinIn) {}
+
+    bool operator()() {
+        try {
+            if (!db->GetCoin(*outpoint, *coin)) {
+                coin->Clear();
+            }
+        } catch (const std::runtime_error &) {
+            // Leave the slot empty. ConnectBlock will fetch this coin again
+            // through the regular path, where database errors are handled.
+            coin->Clear();
+        }
+        // Never abort the other lookups.
+        return true;
+    }
+};
+
+/**
+ * The data CheckInputs needs to check the scripts of a transaction, which only
+ * depends on the transaction and on the coins it spends.
+ */
+struct PrecomputedTxScriptData {
+    //! Empty if the data could not be computed ahead of time.
+    std::vector<ScriptExecutionContext> contexts;
+    PrecomputedTransactionData txdata;
+};
+
+/**
+ * Closure representing the computation of the script execution contexts and
+ * signature hash midstates of one transaction, on behalf of a block about to
+ * be connected. The coins are read from the caches of the block's view and of
+ * the views under it, which must not be modified while the check runs. If some
+ * of them are missing, the result is left empty and the transaction is dealt
+ * with by the regular path.
+ */
+class CTxScriptPrecomputeCheck {
+    const CTransaction *tx{};
+    //! From the block's view down, the first cache knowing a coin has it
+    const std::vector<const CCoinsViewCache *> *caches{};
+    PrecomputedTxScriptData *result{};
+
+public:
+    CTxScriptPrecomputeCheck() = default;
+    CTxScriptPrecomputeCheck(
+        const CTransaction *txIn,
+        const std::vector<const CCoinsViewCache *> *cachesIn,
+        PrecomputedTxScriptData *resultIn)
+        : tx(txIn), caches(cachesIn), result(resultIn) {}
+
+    bool operator()() {
+        std::vector<Coin> coins;
+        coins.reserve(tx->vin.size());
+        for (const CTxIn &txin : tx->vin) {
+            const Coin *coin = nullptr;
+            for (const CCoinsViewCache *cache : *caches) {
+                coin = cache->PeekCoinInCache(txin.prevout);
+                if (coin) {
+                    break;
+                }
+            }
+            if (!coin || coin->IsSpent()) {
+                return true;
+            }
+            coins.push_back(*coin);
+        }
+        result->contexts =
+            ScriptExecutionContext::createForAllInputs(*tx, std::move(coins));
+        result->txdata.PopulateFromContext(result->contexts.front());
+        return true;
+    }
+};
+
+/**
+ * The outcome of the script checks of one transaction against one set of
+ * script flags, as run by CTxMempoolPrecheck.
+ */
+struct MempoolPrecheckResult {
+    uint32_t flags{};
+    //! Set if the scripts still have to be checked against `flags`, cleared if
+    //! they fail.
+    bool pass{};
+    int nSigChecks{};
+};
+
+/**
+ * Closure representing the script checks of one transaction on behalf of
+ * AcceptToMemoryPool (see PrecheckTransactionsForMempool), against each set of
+ * script flags in `results` which is not known to pass yet. It only records
+ * the outcome: the script execution cache may only be accessed with cs_main
+ * held, which the thread waiting for the checks takes to fill it in
+ * afterwards.
+ */
+class CTxMempoolPrecheck {
+    const CTransaction *tx{};
+    //! Moved from when the check runs
+    std::vector<Coin> *coins{};
+    std::vector<MempoolPrecheckResult> *results{};
+
+public:
+    CTxMempoolPrecheck() = default;
+    CTxMempoolPrecheck(const CTransaction *txIn, std::vector<Coin> *coinsIn,
+                       std::vector<MempoolPrecheckResult> *resultsIn)
+        : tx(txIn), coins(coinsIn), results(resultsIn) {}
+
+    bool operator()() {
+        const auto contexts =
+            ScriptExecutionContext::createForAllInputs(*tx, std::move(*coins));
+        PrecomputedTransactionData txdata;
+        txdata.PopulateFromContext(contexts.front());
+        for (MempoolPrecheckResult &result : *results) {
+            TxSigCheckLimiter txLimitSigChecks;
+            for (const ScriptExecutionContext &context : contexts) {
+                CScriptCheck check(context, result.flags, true, txdata,
+                                   &txLimitSigChecks);
+                if (!check()) {
+                    result.pass = false;
+                    break;
+                }
+                result.nSigChecks +=
+                    check.GetScriptExecutionMetrics().nSigChecks;
+            }
+        }
+        // Never abort the other checks.
+        return true;
+    }
+};
+} // namespace
+
+/**
+ * Queue for the work ConnectBlock farms out ahead of its serial input loop:
+ * reading coins from the database and precomputing script data. It also runs
+ * the script checks of PrecheckTransactionsForMempool.
+ */
+static CCheckQueue<std::function<bool()>> blockprepqueue(16, "blockprep");
+static bool fBlockPrepWorkers = false;
+
+void StartScriptCheckWorkerThreads(int threads_num, bool work_stealing) {
+    scriptcheckqueue.StartWorkerThreads(threads_num, work_stealing);
+    blockprepqueue.StartWorkerThreads(threads_num, work_stealing);
+    fBlockPrepWorkers = threads_num > 0;
 }
 
 void StopScriptCheckWorkerThreads() {
+    fBlockPrepWorkers = false;
+    blockprepqueue.StopWorkerThreads();
     scriptcheckqueue.StopWorkerThreads();
 }
 
+/**
+ * Have the coins of a block hashed into its UTXO commitment on blockprepqueue,
+ * if it has workers.
+ */
+static UTXOCommitmentTaskRunner GetUTXOCommitmentTaskRunner() {
+    if (!fBlockPrepWorkers) {
+        return nullptr;
+    }
+    return [](std::vector<std::function<void()>> &tasks) {
+        std::vector<std::function<bool()>> vChecks;
+        vChecks.reserve(tasks.size());
+        for (std::function<void()> &task : tasks) {
+            vChecks.emplace_back([&task] {
+                task();
+                return true;
+            });
+        }
+        CCheckQueueControl<std::function<bool()>> control(&blockprepqueue);
+        control.Add(vChecks);
+        control.Wait();
+    };
+}
+
+size_t PrecheckTransactionsForMempool(const Config &config,
+                                      const CTxMemPool &pool,
+                                      const std::vector<CTransactionRef> &txs) {
+    if (!fBlockPrepWorkers || txs.empty()) {
+        return 0;
+    }
+
+    std::vector<const CTransaction *> vTxs;
+    std::vector<std::vector<Coin>> vCoins;
+    std::vector<std::vector<MempoolPrecheckResult>> vResults;
+    {
+        LOCK2(cs_main, pool.cs);
+        const CBlockIndex *tip = ::ChainActive().Tip();
+        uint32_t nextBlockScriptVerifyFlags;
+        const uint32_t scriptVerifyFlags = GetMemPoolScriptFlags(
+            config.GetChainParams().GetConsensus(), tip,
+            &nextBlockScriptVerifyFlags);
+        const int nSpendHeight = tip->nHeight + 1;
+
+        CCoinsViewMemPool viewMemPool(pcoinsTip.get(), pool);
+        std::unordered_set<COutPoint, SaltedOutpointHasher> spentByBatch;
+        // Leave the coins cache as it was: AcceptToMemoryPool uncaches the
+        // coins of the transactions it rejects, which it could not do for the
+        // ones fetched here.
+        std::vector<COutPoint> coins_to_uncache;
+        for (const CTransactionRef &ptx : txs) {
+            const CTransaction &tx = *ptx;
+            CValidationState state;
+            std::string reason;
+            if (!CheckRegularTransaction(tx, state) ||
+                (fRequireStandard &&
+                 !IsStandardTx(tx, reason, scriptVerifyFlags)) ||
+                pool.exists(tx.GetId())) {
+                continue;
+            }
+
+            std::vector<Coin> coins;
+            coins.reserve(tx.vin.size());
+            Amount nValueIn = Amount::zero();
+            for (const CTxIn &txin : tx.vin) {
+                if (pool.mapNextTx.count(txin.prevout) ||
+                    spentByBatch.count(txin.prevout)) {
+                    break;
+                }
+                if (!pcoinsTip->HaveCoinInCache(txin.prevout)) {
+                    coins_to_uncache.push_back(txin.prevout);
+                }
+                Coin coin;
+                if (!viewMemPool.GetCoin(txin.prevout, coin) ||
+                    coin.IsSpent() ||
+                    (coin.IsCoinBase() &&
+                     nSpendHeight - coin.GetHeight() < COINBASE_MATURITY)) {
+                    break;
+                }
+                nValueIn += coin.GetTxOut().nValue;
+                coins.push_back(std::move(coin));
+            }
+            if (coins.size() != tx.vin.size()) {
+                continue;
+            }
+
+            std::vector<MempoolPrecheckResult> results;
+            for (const uint32_t flags :
+                 {scriptVerifyFlags, nextBlockScriptVerifyFlags}) {
+                int nSigChecksUnused;
+                if (!IsKeyInScriptCache(ScriptCacheKey(tx, flags), false,
+                                        nSigChecksUnused)) {
+                    results.push_back({flags, true, 0});
+                }
+            }
+            if (results.empty()) {
+                continue;
+            }
+
+            // The relay fee is checked before the scripts, don't spend more
+            // on transactions which would not get that far.
+            Amount nModifiedFees = nValueIn - tx.GetValueOut();
+            pool.ApplyDelta(tx.GetId(), nModifiedFees);
+            if (nModifiedFees < minRelayTxFee.GetFee(tx.GetTotalSize())) {
+                continue;
+            }
+
+            for (const CTxIn &txin : tx.vin) {
+                spentByBatch.insert(txin.prevout);
+            }
+            vTxs.push_back(&tx);
+            vCoins.push_back(std::move(coins));
+            vResults.push_back(std::move(results));
+        }
+
+        for (const COutPoint &outpoint : coins_to_uncache) {
+            pcoinsTip->Uncache(outpoint);
+        }
+    }
+
+    // The scripts are checked without holding any lock, so that blocks and
+    // other transactions can be processed meanwhile.
+    {
+        std::vector<std::function<bool()>> vChecks;
+        vChecks.reserve(vTxs.size());
+        for (size_t i = 0; i < vTxs.size(); ++i) {
+            vChecks.emplace_back(
+                CTxMempoolPrecheck(vTxs[i], &vCoins[i], &vResults[i]));
+        }
+        CCheckQueueControl<std::function<bool()>> control(&blockprepqueue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+
+    LOCK(cs_main);
+    for (size_t i = 0; i < vTxs.size(); ++i) {
+        for (const MempoolPrecheckResult &result : vResults[i]) {
+            if (result.pass) {
+                AddKeyInScriptCache(ScriptCacheKey(*vTxs[i], result.flags),
+                                    result.nSigChecks);
+            }
+        }
+    }
+    return vTxs.size();
+}
+
+/**
+ * Warm `view` with the coins spent by `block`, reading the ones that are not
+ * cached anywhere in memory from the coins database in parallel. This way the
+ * serial input processing in ConnectBlock only ever hits memory.
+ *
+ * `view` must be a cache directly on top of pcoinsTip, and there must be no
+ * other caching layer between pcoinsTip and pcoinsdbview: a coin that neither
+ * cache knows about is then guaranteed to be in the state stored in the
+ * database.
+ *
+ * Returns the number of coins that were read from the database.
+ */
+static size_t PrefetchBlockCoins(const CBlock &block, CCoinsViewCache &view)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    AssertLockHeld(cs_main);
+    assert(view.GetBackend() == pcoinsTip.get());
+
+    // Outputs created in this block are added to the view by ConnectBlock,
+    // don't bother looking for them.
+    std::unordered_set<TxId, SaltedTxIdHasher> blockTxIds;
+    blockTxIds.reserve(block.vtx.size());
+    for (const auto &ptx : block.vtx) {
+        blockTxIds.insert(ptx->GetId());
+    }
+
+    std::vector<COutPoint> outpoints;
+    for (const auto &ptx : block.vtx) {
+        if (ptx->IsCoinBase()) {
+            continue;
+        }
+        for (const CTxIn &txin : ptx->vin) {
+            const COutPoint &prevout = txin.prevout;
+            if (blockTxIds.count(prevout.GetTxId()) ||
+                view.PeekCoinInCache(prevout) ||
+                pcoinsTip->PeekCoinInCache(prevout)) {
+                continue;
+            }
+            outpoints.push_back(prevout);
+        }
+    }
+
+    if (outpoints.empty()) {
+        return 0;
+    }
+
+    std::vector<Coin> coins(outpoints.size());
+    {
+        std::vector<std::function<bool()>> vChecks;
+        vChecks.reserve(outpoints.size());
+        for (size_t i = 0; i < outpoints.size(); ++i) {
+            vChecks.emplace_back(CCoinsPrefetchCheck(
+                pcoinsdbview.get(), &outpoints[i], &coins[i]));
+        }
+        CCheckQueueControl<std::function<bool()>> control(&blockprepqueue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+
+    size_t nFetched = 0;
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        if (coins[i].IsSpent()) {
+            // Not in the database: the block is invalid, or the read failed.
+            // Either way, the regular path in ConnectBlock will deal with it.
+            continue;
+        }
+        view.EmplaceFetchedCoin(outpoints[i], std::move(coins[i]));
+        ++nFetched;
+    }
+    return nFetched;
+}
+
+/**
+ * Compute the script execution contexts and signature hash midstates of the
+ * non-coinbase transactions of `block` in parallel. The coins they spend must
+ * already be in the cache of `view`, including the ones created in the block,
+ * or in the caches under it: the coins of `templateCache`, if `view` sits on
+ * them, then pcoinsTip, where PrefetchBlockCoins leaves the coins it already
+ * has.
+ * Transactions whose scripts are in the script execution cache for `flags`, or
+ * which were checked with the last block template, are skipped, since
+ * CheckInputs won't need anything for them.
+ *
+ * The result is indexed like the non-coinbase transactions of the block.
+ * nPrecomputedOut is set to the number of transactions it was computed for.
+ */
+static std::vector<PrecomputedTxScriptData>
+PrecomputeBlockScriptData(const CBlock &block, const CCoinsViewCache &view,
+                          uint32_t flags, size_t &nPrecomputedOut,
+                          const BlockTemplateValidityCache *templateCache)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    AssertLockHeld(cs_main);
+
+    // The view of a block template sits on the coins kept by templateCache,
+    // which the prefetch fills in, over pcoinsTip.
+    std::vector<const CCoinsViewCache *> caches{&view};
+    if (templateCache && templateCache->view &&
+        view.GetBackend() == templateCache->view.get()) {
+        caches.push_back(templateCache->view.get());
+    }
+    if (caches.back()->GetBackend() == pcoinsTip.get()) {
+        caches.push_back(pcoinsTip.get());
+    }
+
+    std::vector<PrecomputedTxScriptData> result(block.vtx.size() - 1);
+    std::vector<std::function<bool()>> vChecks;
+    vChecks.reserve(result.size());
+    for (size_t i = 1; i < block.vtx.size(); ++i) {
+        const CTransaction &tx = *block.vtx[i];
+        if (templateCache && templateCache->checkedTxs.count(tx.GetId())) {
+            continue;
+        }
+        int nSigChecksUnused;
+        if (IsKeyInScriptCache(ScriptCacheKey(tx, flags), false,
+                               nSigChecksUnused)) {
+            continue;
+        }
+        vChecks.emplace_back(
+            CTxScriptPrecomputeCheck(&tx, &caches, &result[i - 1]));
+    }
+
+    CCheckQueueControl<std::function<bool()>> control(&blockprepqueue);
+    control.Add(vChecks);
+    control.Wait();
+
+    nPrecomputedOut = 0;
+    for (const PrecomputedTxScriptData &data : result) {
+        nPrecomputedOut += !data.contexts.empty();
+    }
+    nBlockTxsPrecomputed += nPrecomputedOut;
+    return result;
+}
+
 int32_t ComputeBlockVersion(const CBlockIndex *pindexPrev,
                             const Consensus::Params &params) {
     return VERSIONBITS_TOP_BITS;
@@ -1542,9 +2035,37 @@ static void MaintainAblaState(const Consensus::Params &consensusParams, const CB
     }
 }
 
+/// Maintain the commitment to the UTXO set of `pindex` (see -utxocommitment),
+/// from the commitment of its parent, if that is known.
+/// The coins are hashed on the workers of blockprepqueue, if there are any.
+/// @param overwritten - Coins which the block's coinbase overwrote (see BIP30).
+static void MaintainUTXOCommitment(const CBlock &block, const CBlockUndo &blockundo, CBlockIndex *pindex,
+                                   const std::vector<std::pair<COutPoint, Coin>> &overwritten)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    if (pindex->utxoCommitment) {
+        // Reconnected; the commitment doesn't depend on anything but the chain.
+        return;
+    }
+    if (!pindex->pprev) {
+        // The genesis block doesn't add any coin.
+        pindex->utxoCommitment = std::make_shared<const UTXOCommitment>();
+    } else if (pindex->pprev->utxoCommitment) {
+        pindex->utxoCommitment = std::make_shared<const UTXOCommitment>(
+            ConnectBlockToUTXOCommitment(
+                *pindex->pprev->utxoCommitment, block, blockundo,
+                pindex->nHeight, overwritten, GetUTXOCommitmentTaskRunner()));
+    } else {
+        return;
+    }
+    setDirtyBlockIndex.insert(pindex);
+}
+
 static int64_t nTimeCheck = 0;
 static int64_t nTimeForks = 0;
+static int64_t nTimePrefetch = 0;
+static int64_t nTimePrecompute = 0;
 static int64_t nTimeVerify = 0;
+static int64_t nTimeCommitment = 0;
 static int64_t nTimeConnect = 0;
 static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
@@ -1561,9 +2082,11 @@ bool CChainState::ConnectBlock(const CBlock &block, CValidationState &state,
                                CBlockIndex *pindex, CCoinsViewCache &view,
                                const CChainParams &params,
                                BlockValidationOptions options,
-                               bool fJustCheck) {
+                               bool fJustCheck,
+                               BlockTemplateValidityCache *templateCache) {
     AssertLockHeld(cs_main);
     assert(pindex);
+    assert(!templateCache || fJustCheck);
     assert(*pindex->phashBlock == block.GetHash());
     int64_t nTimeStart = GetTimeMicros();
 
@@ -1617,6 +2140,9 @@ bool CChainState::ConnectBlock(const CBlock &block, CValidationState &state,
             view.SetBestBlock(pindex->GetBlockHash());
             // Ensure ABLA state is updated just in case -upgrade10activationtime=<before genesis>
             MaintainAblaState(consensusParams, block, pindex, __func__, nThisBlockSize);
+            if (fUtxoCommitment) {
+                MaintainUTXOCommitment(block, CBlockUndo(), pindex, {});
+            }
         }
 
         return true;
@@ -1685,6 +2211,20 @@ bool CChainState::ConnectBlock(const CBlock &block, CValidationState &state,
                                 uint256S("0x00000000000743f190a18c5577a3c2d2a1f"
                                          "610ae9601ac046a38084ccb7cd721")));
 
+    // The coinbase of the two blocks above replaces coins of the UTXO set
+    // without spending them, so they don't make it to the undo data.
+    std::vector<std::pair<COutPoint, Coin>> overwrittenCoins;
+    if (!fEnforceBIP30 && fUtxoCommitment && !fJustCheck) {
+        const CTransaction &coinbase = *block.vtx[0];
+        for (size_t o = 0; o < coinbase.vout.size(); o++) {
+            const COutPoint outpoint(coinbase.GetId(), o);
+            const Coin &coin = view.AccessCoin(outpoint);
+            if (!coin.IsSpent()) {
+                overwrittenCoins.emplace_back(outpoint, coin);
+            }
+        }
+    }
+
     // Once BIP34 activated it was not possible to create new duplicate
     // coinbases and thus other than starting with the 2 existing duplicate
     // coinbase pairs, not possible to create overwriting txs. But by the time
@@ -1732,6 +2272,19 @@ bool CChainState::ConnectBlock(const CBlock &block, CValidationState &state,
              MILLI * (nTime2 - nTime1), nTimeForks * MICRO,
              nTimeForks * MILLI / nBlocksTotal);
 
+    // Read the coins spent by this block which aren't cached yet from the
+    // database in parallel, so that the serial loop below doesn't have to.
+    if (fUtxoPrefetch && fBlockPrepWorkers &&
+        view.GetBackend() == pcoinsTip.get()) {
+        const size_t nPrefetched = PrefetchBlockCoins(block, view);
+        const int64_t nTimePrefetched = GetTimeMicros();
+        nTimePrefetch += nTimePrefetched - nTime2;
+        LogPrint(BCLog::BENCH,
+                 "    - Prefetch %u coins: %.2fms [%.2fs (%.2fms/blk)]\n",
+                 nPrefetched, MILLI * (nTimePrefetched - nTime2),
+                 nTimePrefetch * MICRO, nTimePrefetch * MILLI / nBlocksTotal);
+    }
+
     std::vector<int> prevheights;
     Amount nFees = Amount::zero();
     int nInputs = 0;
@@ -1745,6 +2298,8 @@ bool CChainState::ConnectBlock(const CBlock &block, CValidationState &state,
 
     std::vector<TxSigCheckLimiter> nSigChecksTxLimiters;
     nSigChecksTxLimiters.resize(block.vtx.size() - 1);
+    // Transactions of a block template not checked with the last one
+    size_t nNewTemplateTxs = 0;
 
     CBlockUndo blockundo;
     blockundo.vtxundo.resize(block.vtx.size() - 1);
@@ -1780,6 +2335,27 @@ bool CChainState::ConnectBlock(const CBlock &block, CValidationState &state,
         firstTokenBlockHeight = std::numeric_limits<int64_t>::max();
     }
 
+    // All the coins the block spends are now in the caches of the view or of
+    // pcoinsTip, unless the block is invalid or the view is not on pcoinsTip.
+    // Set up the script checks of all transactions in parallel, so that the
+    // loop below is left with checking and spending the inputs in order.
+    std::vector<PrecomputedTxScriptData> vPrecomputed;
+    if (fScriptChecks && fBlockPrepWorkers) {
+        const int64_t nTimePrecomputeStart = GetTimeMicros();
+        size_t nPrecomputed = 0;
+        vPrecomputed =
+            PrecomputeBlockScriptData(block, view, flags, nPrecomputed,
+                                      templateCache);
+        const int64_t nTimePrecomputed = GetTimeMicros();
+        nTimePrecompute += nTimePrecomputed - nTimePrecomputeStart;
+        LogPrint(BCLog::BENCH,
+                 "    - Precompute %u txs: %.2fms [%.2fs (%.2fms/blk)]\n",
+                 nPrecomputed,
+                 MILLI * (nTimePrecomputed - nTimePrecomputeStart),
+                 nTimePrecompute * MICRO,
+                 nTimePrecompute * MILLI / nBlocksTotal);
+    }
+
     size_t txIndex = 0;
     for (const auto &ptx : block.vtx) {
         const CTransaction &tx = *ptx;
@@ -1814,6 +2390,25 @@ bool CChainState::ConnectBlock(const CBlock &block, CValidationState &state,
             continue;
         }
 
+        // A transaction of the last template checked on this tip spends the
+        // same coins as it did then, so its scripts and sequence locks still
+        // pass. Its inputs were checked above, which catches double spends.
+        if (templateCache) {
+            const auto it = templateCache->checkedTxs.find(tx.GetId());
+            if (it != templateCache->checkedTxs.end()) {
+                if (!nSigChecksBlockLimiter.consume_and_check(it->second)) {
+                    return state.DoS(100, false, REJECT_INVALID,
+                                     "blk-bad-inputs", false,
+                                     "CheckInputs exceeded SigChecks limit");
+                }
+                SpendCoins(view, tx, blockundo.vtxundo.at(txIndex),
+                           pindex->nHeight);
+                txIndex++;
+                continue;
+            }
+            ++nNewTemplateTxs;
+        }
+
         // Check that transaction is BIP68 final BIP68 lock checks (as
         // opposed to nLockTime checks) must be in ConnectBlock because they
         // require the UTXO set.
@@ -1846,9 +2441,14 @@ bool CChainState::ConnectBlock(const CBlock &block, CValidationState &state,
         // deferred into vChecks).
         int nSigChecksRet;
         PrecomputedTransactionData txdata; // starts out unpopulated, will be calculated for us in CheckInputs
+        const std::vector<ScriptExecutionContext> *pPrecomputedContexts = nullptr;
+        if (!vPrecomputed.empty() && !vPrecomputed[txIndex].contexts.empty()) {
+            txdata = vPrecomputed[txIndex].txdata;
+            pPrecomputedContexts = &vPrecomputed[txIndex].contexts;
+        }
         if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults,
                          fCacheResults, txdata, nSigChecksRet, nSigChecksTxLimiters[txIndex],
-                         &nSigChecksBlockLimiter, &vChecks)) {
+                         &nSigChecksBlockLimiter, &vChecks, pPrecomputedContexts)) {
             // Parallel CheckInputs shouldn't fail except for this reason, which
             // is banworthy. Use "blk-bad-inputs" to mimic the parallel script
             // check error.
@@ -1861,6 +2461,10 @@ bool CChainState::ConnectBlock(const CBlock &block, CValidationState &state,
         }
 
         control.Add(vChecks);
+        if (pPrecomputedContexts) {
+            // The queued checks hold their own references to the shared data.
+            vPrecomputed[txIndex] = PrecomputedTxScriptData();
+        }
 
         // Note: this must execute in the same iteration as CheckTxInputs (not
         // in a separate loop) in order to detect double spends. However,
@@ -1905,6 +2509,28 @@ bool CChainState::ConnectBlock(const CBlock &block, CValidationState &state,
         nInputs <= 1 ? 0 : MILLI * (nTime4 - nTime2) / (nInputs - 1),
         nTimeVerify * MICRO, nTimeVerify * MILLI / nBlocksTotal);
 
+    if (templateCache) {
+        // Remember the transactions of this template, with the sigchecks
+        // counted by their limiters, for the next one.
+        const int64_t nTxSigChecksLimit =
+            (flags & SCRIPT_ENFORCE_SIGCHECKS)
+                ? TxSigCheckLimiter().get_remaining()
+                : TxSigCheckLimiter::getDisabled().get_remaining();
+        decltype(templateCache->checkedTxs) checkedTxs;
+        checkedTxs.reserve(block.vtx.size() - 1);
+        for (size_t i = 1; i < block.vtx.size(); ++i) {
+            const TxId &txid = block.vtx[i]->GetId();
+            const auto it = templateCache->checkedTxs.find(txid);
+            checkedTxs.emplace(
+                txid, it != templateCache->checkedTxs.end()
+                          ? it->second
+                          : nTxSigChecksLimit -
+                                nSigChecksTxLimiters[i - 1].get_remaining());
+        }
+        templateCache->checkedTxs = std::move(checkedTxs);
+        templateCache->nLastNewTxs = nNewTemplateTxs;
+    }
+
     if (fJustCheck) {
         return true;
     }
@@ -1912,6 +2538,16 @@ bool CChainState::ConnectBlock(const CBlock &block, CValidationState &state,
     // Upgrade10: Update ABLA state upon connection
     MaintainAblaState(consensusParams, block, pindex, __func__, nThisBlockSize);
 
+    if (fUtxoCommitment) {
+        MaintainUTXOCommitment(block, blockundo, pindex, overwrittenCoins);
+        const int64_t nTimeCommitted = GetTimeMicros();
+        nTimeCommitment += nTimeCommitted - nTime4;
+        LogPrint(BCLog::BENCH,
+                 "    - UTXO commitment: %.2fms [%.2fs (%.2fms/blk)]\n",
+                 MILLI * (nTimeCommitted - nTime4), nTimeCommitment * MICRO,
+                 nTimeCommitment * MILLI / nBlocksTotal);
+    }
+
     if (!WriteUndoDataForBlock(blockundo, state, pindex, params)) {
         return false;
     }
@@ -1940,6 +2576,68 @@ bool CChainState::ConnectBlock(const CBlock &block, CValidationState &state,
     return true;
 }
 
+/**
+ * Flush all block and undo data to disk, then write the block file information
+ * and the block index entries which were modified since the last call.
+ */
+static bool WriteBlockIndexToDisk(CValidationState &state)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main, cs_LastBlockFile) {
+    // Depend on nMinDiskSpace to ensure we can write block index
+    if (!CheckDiskSpace(GetBlocksDir())) {
+        return AbortNode(state, "Disk space is low!",
+                         _("Error: Disk space is low!"));
+    }
+
+    // First make sure all block and undo data is flushed to disk.
+    FlushBlockFile();
+    // Then update all block file information (which may refer to block and
+    // undo files).
+    std::vector<std::pair<int, const CBlockFileInfo *>> vFiles;
+    vFiles.reserve(setDirtyFileInfo.size());
+    for (int i : setDirtyFileInfo) {
+        vFiles.push_back(std::make_pair(i, &vinfoBlockFile[i]));
+    }
+
+    setDirtyFileInfo.clear();
+
+    std::vector<const CBlockIndex *> vBlocks;
+    vBlocks.reserve(setDirtyBlockIndex.size());
+    for (const CBlockIndex *cbi : setDirtyBlockIndex) {
+        vBlocks.push_back(cbi);
+    }
+
+    setDirtyBlockIndex.clear();
+
+    if (!pblocktree->WriteBatchSync(vFiles, nLastBlockFile, vBlocks)) {
+        return AbortNode(state, "Failed to write to block index database");
+    }
+    return true;
+}
+
+/**
+ * Serializes the writes to the coins database made by full flushes of
+ * pcoinsTip and by the incremental flush (see IncrementalCoinsFlushStep).
+ * Always acquired with cs_main held, but the incremental flush releases
+ * cs_main first while writing, which the lock order checks of Mutex do not
+ * support, hence a plain std::mutex.
+ */
+static std::mutex g_coinsdb_write_mutex;
+
+/**
+ * Set while the incremental flush left the coins database in the middle of a
+ * transition to the tip of pcoinsTip. The transition can only move forward
+ * along the active chain, so the flush must be completed before a block is
+ * disconnected.
+ */
+static bool g_coins_flush_incomplete GUARDED_BY(cs_main) = false;
+
+/**
+ * Set while LoadUTXOSnapshot writes the coins of a snapshot to the coins
+ * database without holding cs_main. Meanwhile pcoinsTip stays at the genesis
+ * block, so it must not be flushed, and no block may be connected.
+ */
+static std::atomic<bool> g_snapshot_loading{false};
+
 /**
  * Update the on-disk chain state.
  * The caches and indexes are flushed depending on the mode we're called with if
@@ -2011,46 +2709,18 @@ static bool FlushStateToDisk(const CChainParams &chainparams,
                 nNow > nLastWrite + (int64_t)DATABASE_WRITE_INTERVAL * 1000000;
             // It's been very long since we flushed the cache. Do this
             // infrequently, to optimize cache usage.
+            // Not needed when the coins database is kept up to date by the
+            // incremental flush.
             bool fPeriodicFlush =
-                mode == FlushStateMode::PERIODIC &&
+                mode == FlushStateMode::PERIODIC && !fUtxoBackgroundFlush &&
                 nNow > nLastFlush + (int64_t)DATABASE_FLUSH_INTERVAL * 1000000;
             // Combine all conditions that result in a full cache flush.
             fDoFullFlush = (mode == FlushStateMode::ALWAYS) || fCacheLarge ||
                            fCacheCritical || fPeriodicFlush || fFlushForPrune;
             // Write blocks and block index to disk.
             if (fDoFullFlush || fPeriodicWrite) {
-                // Depend on nMinDiskSpace to ensure we can write block index
-                if (!CheckDiskSpace(GetBlocksDir())) {
-                    return AbortNode(state, "Disk space is low!",
-                                     _("Error: Disk space is low!"));
-                }
-
-                // First make sure all block and undo data is flushed to disk.
-                FlushBlockFile();
-                // Then update all block file information (which may refer to
-                // block and undo files).
-                {
-                    std::vector<std::pair<int, const CBlockFileInfo *>> vFiles;
-                    vFiles.reserve(setDirtyFileInfo.size());
-                    for (int i : setDirtyFileInfo) {
-                        vFiles.push_back(std::make_pair(i, &vinfoBlockFile[i]));
-                    }
-
-                    setDirtyFileInfo.clear();
-
-                    std::vector<const CBlockIndex *> vBlocks;
-                    vBlocks.reserve(setDirtyBlockIndex.size());
-                    for (const CBlockIndex *cbi : setDirtyBlockIndex) {
-                        vBlocks.push_back(cbi);
-                    }
-
-                    setDirtyBlockIndex.clear();
-
-                    if (!pblocktree->WriteBatchSync(vFiles, nLastBlockFile,
-                                                    vBlocks)) {
-                        return AbortNode(
-                            state, "Failed to write to block index database");
-                    }
+                if (!WriteBlockIndexToDisk(state)) {
+                    return false;
                 }
 
                 // Finally remove any pruned files
@@ -2061,7 +2731,8 @@ static bool FlushStateToDisk(const CChainParams &chainparams,
             }
             // Flush best chain related state. This can only be done if the
             // blocks / block index write was also done.
-            if (fDoFullFlush && !pcoinsTip->GetBestBlock().IsNull()) {
+            if (fDoFullFlush && !pcoinsTip->GetBestBlock().IsNull() &&
+                !g_snapshot_loading) {
                 // Typical Coin structures on disk are around 48 bytes in size.
                 // Pushing a new one to the database can cause it to be written
                 // twice (once in the log, and once in the tables). This is
@@ -2076,9 +2747,11 @@ static bool FlushStateToDisk(const CChainParams &chainparams,
 
                 // Flush the chainstate (which may refer to block index
                 // entries).
+                std::lock_guard<std::mutex> dbLock(g_coinsdb_write_mutex);
                 if (!pcoinsTip->Flush()) {
                     return AbortNode(state, "Failed to write to coin database");
                 }
+                g_coins_flush_incomplete = false;
                 nLastFlush = nNow;
                 full_flush_completed = true;
             }
@@ -2095,6 +2768,138 @@ static bool FlushStateToDisk(const CChainParams &chainparams,
     return true;
 }
 
+bool IncrementalCoinsFlushStep(size_t maxCoins) {
+    // Where the scan of pcoinsTip left off, and whether the tip stayed the
+    // same during the whole of the current pass over pcoinsTip.
+    static size_t cursor GUARDED_BY(cs_main) = 0;
+    static BlockHash passTip GUARDED_BY(cs_main);
+    static bool passClean GUARDED_BY(cs_main) = false;
+    // When the coins database was left behind the tip, and the number of
+    // passes completed since.
+    static int64_t transitionStart GUARDED_BY(cs_main) = 0;
+    static int nPasses GUARDED_BY(cs_main) = 0;
+    // The last tip the block index was written for
+    static BlockHash indexTip GUARDED_BY(cs_main);
+
+    CValidationState state;
+    std::vector<std::pair<COutPoint, Coin>> coins;
+    BlockHash hashBlock;
+    bool fFinal = false;
+    std::unique_lock<std::mutex> dbLock;
+    {
+        LOCK(cs_main);
+        if (!pcoinsTip || !pcoinsdbview || g_snapshot_loading) {
+            return false;
+        }
+        hashBlock = pcoinsTip->GetBestBlock();
+        if (hashBlock.IsNull() || pcoinsdbview->GetBestBlock() == hashBlock) {
+            // Nothing was changed since the coins database was last flushed.
+            cursor = 0;
+            passClean = false;
+            transitionStart = 0;
+            nPasses = 0;
+            return false;
+        }
+        if (transitionStart == 0) {
+            transitionStart = GetTime();
+        }
+        if (hashBlock != passTip) {
+            passTip = hashBlock;
+            passClean = false;
+        }
+
+        // A replay after a crash needs the blocks up to the one the coins
+        // database is heading to.
+        if (hashBlock != indexTip) {
+            LOCK(cs_LastBlockFile);
+            if (!WriteBlockIndexToDisk(state)) {
+                return false;
+            }
+            indexTip = hashBlock;
+        }
+
+        dbLock = std::unique_lock<std::mutex>(g_coinsdb_write_mutex);
+        const bool fPassDone =
+            pcoinsTip->TakeDirtyCoins(coins, cursor, maxCoins, 16 * maxCoins);
+        if (fPassDone) {
+            ++nPasses;
+        }
+        // If the tip stayed the same during a whole pass, there cannot be
+        // much left to write. Otherwise, when the tip keeps moving, the coins
+        // database would never catch up, and a crash would leave all the
+        // blocks since it was last in the state of a tip to replay: catch up
+        // after a while all the same. Either way, take whatever is left, and
+        // the coins database will then be in the state of the tip.
+        if ((fPassDone && passClean) || nPasses >= COINS_FLUSH_MAX_PASSES ||
+            GetTime() - transitionStart >= COINS_FLUSH_MAX_TRANSITION_TIME) {
+            size_t cursorFinal = 0;
+            fFinal = pcoinsTip->TakeDirtyCoins(
+                coins, cursorFinal, std::numeric_limits<size_t>::max(),
+                std::numeric_limits<size_t>::max());
+            assert(fFinal);
+            cursor = 0;
+            passClean = false;
+            transitionStart = 0;
+            nPasses = 0;
+        } else if (fPassDone) {
+            passClean = true;
+        }
+        if (coins.empty() && !fFinal) {
+            return true;
+        }
+        g_coins_flush_incomplete = !fFinal;
+    }
+
+    if (!pcoinsdbview->WriteCoinsChunk(coins, hashBlock, fFinal)) {
+        AbortNode(state, "Failed to write to coin database");
+        return false;
+    }
+    dbLock.unlock();
+
+    // Spent coins were erased from the database, so they can now be dropped
+    // from the cache unless they were modified again in the meantime.
+    LOCK(cs_main);
+    for (const auto &[outpoint, coin] : coins) {
+        if (coin.IsSpent()) {
+            pcoinsTip->Uncache(outpoint);
+        }
+    }
+    return !fFinal;
+}
+
+static std::thread g_coins_flush_thread;
+static CThreadInterrupt g_coins_flush_interrupt;
+
+static void ThreadCoinsFlush() {
+    while (!g_coins_flush_interrupt) {
+        if (IncrementalCoinsFlushStep(COINS_FLUSH_CHUNK_SIZE)) {
+            // Give other threads waiting for cs_main a chance.
+            if (!g_coins_flush_interrupt.sleep_for(
+                    std::chrono::milliseconds(1))) {
+                break;
+            }
+        } else if (!g_coins_flush_interrupt.sleep_for(
+                       std::chrono::seconds(1))) {
+            break;
+        }
+    }
+}
+
+void StartCoinsFlushThread() {
+    assert(!g_coins_flush_thread.joinable());
+    g_coins_flush_interrupt.reset();
+    g_coins_flush_thread =
+        std::thread(&TraceThread<void (*)()>, "coinsflush", &ThreadCoinsFlush);
+}
+
+void StopCoinsFlushThread() {
+    if (!g_coins_flush_thread.joinable()) {
+        return;
+    }
+    g_coins_flush_interrupt();
+    g_coins_flush_thread.join();
+}
+
 void FlushStateToDisk() {
     CValidationState state;
     const CChainParams &chainparams = Params();
@@ -2201,6 +3006,13 @@ bool CChainState::DisconnectTip(const Config &config,
 
     assert(pindexDelete);
 
+    // The incremental flush can only move the coins database forward along
+    // the active chain, so bring it up to date before going back.
+    if (g_coins_flush_incomplete &&
+        !FlushStateToDisk(params, state, FlushStateMode::ALWAYS)) {
+        return false;
+    }
+
     // Read block from disk.
     std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
     CBlock &block = *pblock;
@@ -2900,6 +3712,11 @@ bool CChainState::ActivateBestChain(const Config &config,
 
     const CChainParams &params = config.GetChainParams();
 
+    // The blocks will be connected once the snapshot is loaded.
+    if (g_snapshot_loading) {
+        return true;
+    }
+
     // BCHN maintains a fair degree of expensive-to-calculate internal state
     // because this function periodically releases cs_main so that it does not
     // lock up other threads for too long during large connects - and to allow
@@ -3421,6 +4238,49 @@ CBlockIndex *CChainState::AddToBlockIndex(const CBlockHeader &block) {
     return pindexNew;
 }
 
+/**
+ * Account for the transactions of a block whose parents all have theirs
+ * (BLOCK_VALID_TRANSACTIONS), and for those of the blocks which were waiting
+ * for it in mapBlocksUnlinked.
+ */
+void CChainState::LinkBlockTransactions(CBlockIndex *pindexNew) {
+    std::deque<CBlockIndex *> queue;
+    queue.push_back(pindexNew);
+
+    // Recursively process any descendant blocks that now may be eligible to
+    // be connected.
+    while (!queue.empty()) {
+        CBlockIndex *pindex = queue.front();
+        queue.pop_front();
+        pindex->nChainTx =
+            (pindex->pprev ? pindex->pprev->nChainTx : 0) + pindex->nTx;
+        if (pindex->nSequenceId == 0) {
+            // We assign a sequence is when transaction are received to
+            // prevent a miner from being able to broadcast a block but not
+            // its content. However, a sequence id may have been set
+            // manually, for instance via PreciousBlock, in which case, we
+            // don't need to assign one.
+            pindex->nSequenceId = nBlockSequenceId++;
+        }
+
+        if (m_chain.Tip() == nullptr ||
+            !setBlockIndexCandidates.value_comp()(pindex, m_chain.Tip())) {
+            setBlockIndexCandidates.insert(pindex);
+        }
+
+        std::pair<std::multimap<CBlockIndex *, CBlockIndex *>::iterator,
+                  std::multimap<CBlockIndex *, CBlockIndex *>::iterator>
+            range = mapBlocksUnlinked.equal_range(pindex);
+        while (range.first != range.second) {
+            std::multimap<CBlockIndex *, CBlockIndex *>::iterator it =
+                range.first;
+            queue.push_back(it->second);
+            range.first++;
+            mapBlocksUnlinked.erase(it);
+        }
+    }
+}
+
 /**
  * Mark a block as having its data received and checked (up to
  * BLOCK_VALID_TRANSACTIONS).
@@ -3440,41 +4300,7 @@ void CChainState::ReceivedBlockTransactions(const CBlock &block,
     if (pindexNew->pprev == nullptr || pindexNew->pprev->HaveTxsDownloaded()) {
         // If pindexNew is the genesis block or all parents are
         // BLOCK_VALID_TRANSACTIONS.
-        std::deque<CBlockIndex *> queue;
-        queue.push_back(pindexNew);
-
-        // Recursively process any descendant blocks that now may be eligible to
-        // be connected.
-        while (!queue.empty()) {
-            CBlockIndex *pindex = queue.front();
-            queue.pop_front();
-            pindex->nChainTx =
-                (pindex->pprev ? pindex->pprev->nChainTx : 0) + pindex->nTx;
-            if (pindex->nSequenceId == 0) {
-                // We assign a sequence is when transaction are received to
-                // prevent a miner from being able to broadcast a block but not
-                // its content. However, a sequence id may have been set
-                // manually, for instance via PreciousBlock, in which case, we
-                // don't need to assign one.
-                pindex->nSequenceId = nBlockSequenceId++;
-            }
-
-            if (m_chain.Tip() == nullptr ||
-                !setBlockIndexCandidates.value_comp()(pindex, m_chain.Tip())) {
-                setBlockIndexCandidates.insert(pindex);
-            }
-
-            std::pair<std::multimap<CBlockIndex *, CBlockIndex *>::iterator,
-                      std::multimap<CBlockIndex *, CBlockIndex *>::iterator>
-                range = mapBlocksUnlinked.equal_range(pindex);
-            while (range.first != range.second) {
-                std::multimap<CBlockIndex *, CBlockIndex *>::iterator it =
-                    range.first;
-                queue.push_back(it->second);
-                range.first++;
-                mapBlocksUnlinked.erase(it);
-            }
-        }
+        LinkBlockTransactions(pindexNew);
     } else if (pindexNew->pprev->IsValid(BlockValidity::TREE)) {
         mapBlocksUnlinked.insert(std::make_pair(pindexNew->pprev, pindexNew));
     }
@@ -4190,10 +5016,36 @@ bool ProcessNewBlock(const Config &config,
 
 bool TestBlockValidity(CValidationState &state, const CChainParams &params,
                        const CBlock &block, CBlockIndex *pindexPrev,
-                       BlockValidationOptions validationOptions) {
+                       BlockValidationOptions validationOptions,
+                       BlockTemplateValidityCache *templateCache) {
     AssertLockHeld(cs_main);
     assert(pindexPrev && pindexPrev == ::ChainActive().Tip());
-    CCoinsViewCache viewNew(pcoinsTip.get());
+    if (templateCache) {
+        size_t nInputs = 0;
+        for (const auto &ptx : block.vtx) {
+            nInputs += ptx->vin.size();
+        }
+        if (templateCache->hashPrevBlock != pindexPrev->GetBlockHash() ||
+            templateCache->pcoinsBase != pcoinsTip.get()) {
+            templateCache->hashPrevBlock = pindexPrev->GetBlockHash();
+            templateCache->pcoinsBase = pcoinsTip.get();
+            templateCache->view.reset();
+            templateCache->checkedTxs.clear();
+        } else if (templateCache->view &&
+                   templateCache->view->GetCacheSize() > 2 * nInputs + 1000) {
+            // Don't hold on to the coins of many templates ago.
+            templateCache->view.reset();
+        }
+        if (!templateCache->view) {
+            templateCache->view =
+                std::make_unique<CCoinsViewCache>(pcoinsTip.get());
+        }
+        if (fUtxoPrefetch && fBlockPrepWorkers) {
+            PrefetchBlockCoins(block, *templateCache->view);
+        }
+    }
+    CCoinsViewCache viewNew(templateCache ? templateCache->view.get()
+                                          : pcoinsTip.get());
     BlockHash block_hash(block.GetHash());
     CBlockIndex indexDummy(block);
     indexDummy.pprev = pindexPrev;
@@ -4219,7 +5071,7 @@ bool TestBlockValidity(CValidationState &state, const CChainParams &params,
     }
 
     if (!g_chainstate.ConnectBlock(block, state, &indexDummy, viewNew, params,
-                                   validationOptions, true)) {
+                                   validationOptions, true, templateCache)) {
         return false;
     }
 
@@ -4582,6 +5434,11 @@ static bool VerifyAblaStateForChain(const Config &config, CChain &chain) EXCLUSI
     }
     const CBlockIndex *pbase = g_upgrade10_block_tracker.GetActivationBlock(ptip, consensus);
     assert(pbase != nullptr);
+    // The blocks below a UTXO snapshot (see LoadUTXOSnapshot) have neither data nor ABLA state, and verification
+    // starts at the snapshot base block, which got its state with the snapshot.
+    while (pbase != ptip && !pbase->nStatus.hasData() && !pbase->GetAblaStateOpt()) {
+        pbase = chain.Next(pbase);
+    }
     LogPrintf("%s: Verifying %i block headers have correct ABLA state ...\n",
               __func__, ptip->nHeight - pbase->nHeight + 1);
     const abla::Config &ablaConfig = consensus.ablaConfig;
@@ -4924,6 +5781,24 @@ bool CChainState::ReplayBlocks(const Consensus::Params &params,
         assert(pindexFork != nullptr);
     }
 
+    // A crash while loading a UTXO snapshot (see LoadUTXOSnapshot) leaves a
+    // transition from the genesis block to the base block of the snapshot,
+    // which cannot be rolled forward, as the blocks in between were never
+    // downloaded. Erase the coins written so far instead, after which the
+    // snapshot can be loaded again.
+    if (pindexOld && pindexOld->nHeight == 0 && pindexNew->nHeight > 0 &&
+        !pindexNew->nStatus.hasData() && view == pcoinsdbview.get()) {
+        LogPrintf("Erasing the coins of an interrupted UTXO snapshot load "
+                  "at block %s\n",
+                  pindexNew->GetBlockHash().ToString());
+        if (!pcoinsdbview->EraseAllCoins(pindexOld->GetBlockHash())) {
+            return error("ReplayBlocks(): failed to erase the coins of an "
+                         "interrupted UTXO snapshot load");
+        }
+        uiInterface.ShowProgress("", 100, false);
+        return true;
+    }
+
     // Rollback along the old branch.
     while (pindexOld != pindexFork) {
         if (pindexOld->nHeight > 0) {
@@ -4978,6 +5853,234 @@ bool ReplayBlocks(const Consensus::Params &params, CCoinsView *view) {
     return g_chainstate.ReplayBlocks(params, view);
 }
 
+/**
+ * Read the coins of a UTXO snapshot and write all but the last chunk of them
+ * to the coins database, as a transition from the genesis block to the base
+ * block of the snapshot, without holding cs_main. The last chunk is left in
+ * lastChunk, to be written once the block index is updated, and the hash of
+ * the coins in commitment. If the coins are bad or do not match au_data,
+ * whatever was written is erased again.
+ */
+static bool ReadUTXOSnapshotCoins(
+    CAutoFile &coins_file, const SnapshotMetadata &metadata,
+    const AssumeutxoData &au_data, int nBaseHeight,
+    const BlockHash &hashGenesis,
+    std::vector<std::pair<COutPoint, Coin>> &lastChunk,
+    std::shared_ptr<const UTXOCommitment> &commitment,
+    CValidationState &state) LOCKS_EXCLUDED(cs_main) {
+    AssertLockNotHeld(cs_main);
+    const BlockHash &hashBase = metadata.m_base_blockhash;
+    std::lock_guard<std::mutex> dbLock(g_coinsdb_write_mutex);
+
+    // Erase whatever was written of the snapshot.
+    auto rollback = [&](const std::string &strError) {
+        if (!pcoinsdbview->EraseAllCoins(hashGenesis)) {
+            return AbortNode(state, "Failed to write to coin database");
+        }
+        return state.Error(strError);
+    };
+
+    ECMultiSet hash;
+    uint64_t nBogoSize = 0;
+    Amount nTotalAmount = Amount::zero();
+    std::vector<std::pair<COutPoint, Coin>> coins;
+    uint64_t nCoins = 0;
+    try {
+        while (nCoins < metadata.m_coins_count) {
+            TxId txid;
+            uint64_t nOutputs;
+            coins_file >> txid >> COMPACTSIZE(nOutputs);
+            if (nOutputs == 0 || nOutputs > metadata.m_coins_count - nCoins) {
+                return rollback("Bad number of outputs in UTXO snapshot");
+            }
+            for (uint64_t i = 0; i < nOutputs; ++i) {
+                uint32_t n;
+                Coin coin;
+                coins_file >> VARINT(n) >> coin;
+                if (coin.IsSpent() ||
+                    coin.GetHeight() > uint32_t(nBaseHeight)) {
+                    return rollback("Bad coin in UTXO snapshot");
+                }
+                const COutPoint outpoint(txid, n);
+                ApplyCoinHash(hash, outpoint, coin);
+                nBogoSize += GetBogoSize(coin.GetTxOut().scriptPubKey);
+                nTotalAmount += coin.GetTxOut().nValue;
+                coins.emplace_back(outpoint, std::move(coin));
+            }
+            nCoins += nOutputs;
+
+            if (coins.size() >= COINS_FLUSH_CHUNK_SIZE) {
+                if (ShutdownRequested()) {
+                    return rollback("Shutdown requested");
+                }
+                if (!pcoinsdbview->WriteCoinsChunk(coins, hashBase, false)) {
+                    return AbortNode(state,
+                                     "Failed to write to coin database");
+                }
+                coins.clear();
+            }
+        }
+    } catch (const std::ios_base::failure &e) {
+        return rollback(
+            strprintf("Failed to read UTXO snapshot: %s", e.what()));
+    }
+    if (std::fgetc(coins_file.Get()) != EOF) {
+        return rollback("Unexpected data after the coins of the UTXO "
+                        "snapshot");
+    }
+    if (hash.GetHash() != au_data.hash_serialized) {
+        return rollback(strprintf(
+            "The hash of the UTXO snapshot %s does not match the assumed "
+            "hash %s",
+            hash.GetHash().ToString(), au_data.hash_serialized.ToString()));
+    }
+
+    lastChunk = std::move(coins);
+    commitment = std::make_shared<const UTXOCommitment>(hash, nCoins, nBogoSize,
+                                                        nTotalAmount);
+    return true;
+}
+
+bool CChainState::LoadUTXOSnapshot(const Config &config, CAutoFile &coins_file,
+                                   const SnapshotMetadata &metadata,
+                                   const AssumeutxoData &au_data,
+                                   CValidationState &state) {
+    AssertLockNotHeld(cs_main);
+    const CChainParams &params = config.GetChainParams();
+    const Consensus::Params &consensusParams = params.GetConsensus();
+
+    // No block may be connected until the snapshot is loaded. Blocks received
+    // in the meantime are connected afterwards (see ActivateBestChain).
+    LOCK(m_cs_chainstate);
+
+    CBlockIndex *pbase;
+    BlockHash hashGenesis;
+    {
+        LOCK(cs_main);
+        if (!fPruneMode) {
+            return state.Error("Loading a UTXO snapshot requires -prune, as "
+                               "the blocks below the snapshot are not "
+                               "downloaded");
+        }
+        if (m_chain.Height() != 0) {
+            return state.Error("Loading a UTXO snapshot requires an empty "
+                               "chainstate, with no blocks after the genesis "
+                               "block");
+        }
+        if (!metadata.IsForNetwork(params)) {
+            return state.Error("The UTXO snapshot is for another network");
+        }
+        pbase = LookupBlockIndex(metadata.m_base_blockhash);
+        if (!pbase) {
+            return state.Error(
+                strprintf("The header of the snapshot base block %s is not "
+                          "known",
+                          metadata.m_base_blockhash.ToString()));
+        }
+        if (pbase->nStatus.isInvalid()) {
+            return state.Error(
+                strprintf("The snapshot base block %s is invalid",
+                          metadata.m_base_blockhash.ToString()));
+        }
+        if (IsUpgrade10Enabled(consensusParams, pbase) &&
+            !(metadata.m_abla_state &&
+              metadata.m_abla_state->IsValid(consensusParams.ablaConfig))) {
+            return state.Error("The UTXO snapshot has no valid ABLA state for "
+                               "its base block");
+        }
+
+        // The coins database now only has the genesis block, which has no
+        // coins.
+        if (!FlushStateToDisk(params, state, FlushStateMode::ALWAYS)) {
+            return false;
+        }
+        hashGenesis = m_chain.Genesis()->GetBlockHash();
+        g_snapshot_loading = true;
+    }
+
+    std::vector<std::pair<COutPoint, Coin>> lastChunk;
+    std::shared_ptr<const UTXOCommitment> commitment;
+    if (!ReadUTXOSnapshotCoins(coins_file, metadata, au_data, pbase->nHeight,
+                               hashGenesis, lastChunk, commitment, state)) {
+        g_snapshot_loading = false;
+        return false;
+    }
+
+    LOCK(cs_main);
+    const BlockHash &hashBase = metadata.m_base_blockhash;
+
+    // The blocks below the base block are considered valid, and their
+    // transactions connected, without being downloaded, as when they are
+    // pruned. Their number of transactions is unknown, so make it 1.
+    std::vector<CBlockIndex *> vChain;
+    for (CBlockIndex *pindex = pbase; pindex->pprev; pindex = pindex->pprev) {
+        vChain.push_back(pindex);
+    }
+    for (auto it = vChain.rbegin(); it != vChain.rend(); ++it) {
+        CBlockIndex *pindex = *it;
+        if (pindex->nTx == 0) {
+            pindex->nTx = 1;
+        }
+        pindex->RaiseValidity(BlockValidity::SCRIPTS);
+        setDirtyBlockIndex.insert(pindex);
+        LinkBlockTransactions(pindex);
+    }
+    if (metadata.m_abla_state) {
+        pbase->SetAblaStateOpt(metadata.m_abla_state);
+    }
+    if (!fHavePruned) {
+        pblocktree->WriteFlag("prunedblockfiles", true);
+        fHavePruned = true;
+    }
+
+    // Write the block index before completing the coins database, so that
+    // after a crash in between, the replay finds a transition to a block it
+    // has no data for, and erases the coins instead (see ReplayBlocks).
+    {
+        LOCK(cs_LastBlockFile);
+        if (!WriteBlockIndexToDisk(state)) {
+            g_snapshot_loading = false;
+            return false;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> dbLock(g_coinsdb_write_mutex);
+        if (!pcoinsdbview->WriteCoinsChunk(lastChunk, hashBase, true)) {
+            g_snapshot_loading = false;
+            return AbortNode(state, "Failed to write to coin database");
+        }
+    }
+    pcoinsTip->SetBestBlock(hashBase);
+    pbase->utxoCommitment = std::move(commitment);
+
+    m_chain.SetTip(pbase);
+    PruneBlockIndexCandidates();
+    UpdateTip(config, pbase);
+    g_snapshot_loading = false;
+    LogPrintf("Loaded %u coins from UTXO snapshot at block %s (%d)\n",
+              metadata.m_coins_count, hashBase.ToString(), pbase->nHeight);
+
+    return FlushStateToDisk(params, state, FlushStateMode::ALWAYS);
+}
+
+bool LoadUTXOSnapshot(const Config &config, CAutoFile &coins_file,
+                      const SnapshotMetadata &metadata,
+                      const AssumeutxoData &au_data, CValidationState &state) {
+    return g_chainstate.LoadUTXOSnapshot(config, coins_file, metadata, au_data,
+                                         state);
+}
+
+void SetUTXOCommitment(const BlockHash &hash,
+                       const UTXOCommitment &commitment) {
+    LOCK(cs_main);
+    CBlockIndex *pindex = LookupBlockIndex(hash);
+    if (pindex && !pindex->utxoCommitment) {
+        pindex->utxoCommitment =
+            std::make_shared<const UTXOCommitment>(commitment);
+        setDirtyBlockIndex.insert(pindex);
+    }
+}
+
 // May NOT be used after any connections are up as much of the peer-processing
 // logic assumes a consistent block index state
 void CChainState::UnloadBlockIndex() {
@@ -5555,7 +6658,18 @@ void CChainState::CheckBlockIndex(const Consensus::Params &consensusParams) {
     assert(nNodes == forward.size());
 }
 
-static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+/**
+ * Version 2 of mempool.dat records the chain tip the mempool was dumped at,
+ * ahead of the transactions, which are in topological order as they always
+ * were. Version 1 files are still loaded.
+ */
+static const uint64_t MEMPOOL_DUMP_VERSION_NO_TIP = 1;
+static const uint64_t MEMPOOL_DUMP_VERSION = 2;
+/**
+ * Number of transactions LoadMempool reads ahead, to check their scripts in
+ * parallel before accepting them one by one
+ */
+static const size_t MEMPOOL_LOAD_BATCH_SIZE = 1000;
 
 bool LoadMempool(const Config &config, CTxMemPool &pool) {
     Tic start;
@@ -5574,36 +6688,72 @@ bool LoadMempool(const Config &config, CTxMemPool &pool) {
     int64_t expired = 0;
     int64_t failed = 0;
     int64_t already_there = 0;
+    size_t prechecked = 0;
     int64_t nNow = GetTime();
 
     try {
         uint64_t version;
         file >> version;
-        if (version != MEMPOOL_DUMP_VERSION) {
+        if (version != MEMPOOL_DUMP_VERSION &&
+            version != MEMPOOL_DUMP_VERSION_NO_TIP) {
             return false;
         }
+        if (version == MEMPOOL_DUMP_VERSION) {
+            BlockHash hashTip;
+            file >> hashTip;
+            // The transactions are checked against the chain as it is now
+            // anyway, but if it moved on, fewer of them will be accepted.
+            const CBlockIndex *tip =
+                WITH_LOCK(cs_main, return ::ChainActive().Tip());
+            if (!tip || hashTip != tip->GetBlockHash()) {
+                LogPrintf("Mempool was dumped at another chain tip (%s)\n",
+                          hashTip.ToString());
+            }
+        }
 
         uint64_t num;
         file >> num;
-        while (num--) {
-            CTransactionRef tx;
-            int64_t nTime;
-            int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
-            file >> nFeeDelta;
-
-            Amount amountdelta = nFeeDelta * SATOSHI;
-            if (amountdelta != Amount::zero()) {
-                pool.PrioritiseTransaction(tx->GetId(), amountdelta);
+        std::vector<std::pair<CTransactionRef, int64_t>> batch;
+        std::vector<CTransactionRef> batchTxs;
+        while (num) {
+            // Read a batch of transactions ahead, and check their scripts in
+            // parallel, so that AcceptToMemoryPoolWithTime then finds them in
+            // the script cache.
+            batch.clear();
+            batchTxs.clear();
+            while (num && batch.size() < MEMPOOL_LOAD_BATCH_SIZE) {
+                --num;
+                CTransactionRef tx;
+                int64_t nTime;
+                int64_t nFeeDelta;
+                file >> tx;
+                file >> nTime;
+                file >> nFeeDelta;
+
+                Amount amountdelta = nFeeDelta * SATOSHI;
+                if (amountdelta != Amount::zero()) {
+                    pool.PrioritiseTransaction(tx->GetId(), amountdelta);
+                }
+                if (nTime + nExpiryTimeout > nNow) {
+                    batchTxs.push_back(tx);
+                    batch.emplace_back(std::move(tx), nTime);
+                } else {
+                    ++expired;
+                }
             }
-            CValidationState state;
-            if (nTime + nExpiryTimeout > nNow) {
-                LOCK(cs_main);
-                AcceptToMemoryPoolWithTime(
-                    config, pool, state, tx, nullptr /* pfMissingInputs */,
-                    nTime, false /* bypass_limits */,
-                    Amount::zero() /* nAbsurdFee */, false /* test_accept */);
+            prechecked +=
+                PrecheckTransactionsForMempool(config, pool, batchTxs);
+
+            for (const auto &[tx, nTime] : batch) {
+                CValidationState state;
+                {
+                    LOCK(cs_main);
+                    AcceptToMemoryPoolWithTime(
+                        config, pool, state, tx, nullptr /* pfMissingInputs */,
+                        nTime, false /* bypass_limits */,
+                        Amount::zero() /* nAbsurdFee */,
+                        false /* test_accept */);
+                }
                 if (state.IsValid()) {
                     ++count;
                 } else {
@@ -5617,12 +6767,10 @@ bool LoadMempool(const Config &config, CTxMemPool &pool) {
                         ++failed;
                     }
                 }
-            } else {
-                ++expired;
-            }
 
-            if (ShutdownRequested()) {
-                return false;
+                if (ShutdownRequested()) {
+                    return false;
+                }
             }
         }
         std::map<TxId, Amount> mapDeltas;
@@ -5639,8 +6787,10 @@ bool LoadMempool(const Config &config, CTxMemPool &pool) {
     }
 
     LogPrintf("Imported mempool transactions from disk: %i succeeded, %i "
-              "failed, %i expired, %i already there, %s msec elapsed\n",
-              count, failed, expired, already_there, start.msecStr());
+              "failed, %i expired, %i already there, %u scripts prechecked, "
+              "%s msec elapsed\n",
+              count, failed, expired, already_there, prechecked,
+              start.msecStr());
     return true;
 }
 
@@ -5649,12 +6799,18 @@ bool DumpMempool(const CTxMemPool &pool) {
 
     std::map<uint256, Amount> mapDeltas;
     std::vector<TxMempoolInfo> vinfo;
+    BlockHash hashTip;
 
     static Mutex dump_mutex;
     LOCK(dump_mutex);
 
     {
-        LOCK(pool.cs);
+        // Only the copy is made under the locks, the file is written without
+        // them.
+        LOCK2(cs_main, pool.cs);
+        if (const CBlockIndex *tip = ::ChainActive().Tip()) {
+            hashTip = tip->GetBlockHash();
+        }
         for (const auto &i : pool.mapDeltas) {
             mapDeltas[i.first] = i.second;
         }
@@ -5674,6 +6830,7 @@ bool DumpMempool(const CTxMemPool &pool) {
 
         uint64_t version = MEMPOOL_DUMP_VERSION;
         file << version;
+        file << hashTip;
 
         file << uint64_t(vinfo.size());
         for (const auto &i : vinfo) {
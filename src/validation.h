@@ -24,6 +24,7 @@
 #include <script/script_execution_context.h>
 #include <script/script_metrics.h>
 #include <sync.h>
+#include <util/saltedhashers.h>
 #include <versionbits.h>
 
 #include <algorithm>
@@ -33,11 +34,13 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 class arith_uint256;
 
+class CAutoFile;
 class CBlockIndex;
 class CBlockTreeDB;
 class CBlockUndo;
@@ -49,11 +52,14 @@ class CScriptCheck;
 class CTxMemPool;
 class CTxUndo;
 class CValidationState;
+class SnapshotMetadata;
 
+struct AssumeutxoData;
 struct FlatFilePos;
 struct ChainTxData;
 struct PrecomputedTransactionData;
 struct LockPoints;
+struct UTXOCommitment;
 
 namespace Consensus {
 struct Params;
@@ -92,6 +98,9 @@ static constexpr int MAX_ADDITIONAL_SCRIPTCHECK_THREADS = 255;
 static constexpr int LEGACY_MAX_ADDITIONAL_SCRIPTCHECK_THREADS = 15;
 /** -par default (number of script-checking threads, 0 = auto) */
 static constexpr int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** -parworkstealing default (script-checking threads steal work from each
+ *  other instead of sharing a single queue) */
+static constexpr bool DEFAULT_SCRIPTCHECK_WORK_STEALING = false;
 /**
  * Number of blocks that can be requested at any given time from a single peer.
  */
@@ -153,6 +162,31 @@ static constexpr unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 
 /** Default for -persistmempool */
 static constexpr bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Default for -utxoprefetch */
+static constexpr bool DEFAULT_UTXO_PREFETCH = true;
+/** Default for -txprecheck */
+static constexpr bool DEFAULT_TX_PRECHECK = true;
+/** Default for -utxobackgroundflush */
+static constexpr bool DEFAULT_UTXO_BACKGROUND_FLUSH = false;
+/**
+ * Maximum number of coins written to the coins database at a time by the
+ * incremental flush (see -utxobackgroundflush)
+ */
+static constexpr size_t COINS_FLUSH_CHUNK_SIZE = 16384;
+/**
+ * Number of passes over pcoinsTip, with the tip moving during each, after
+ * which the incremental flush writes all the remaining coins at once
+ */
+static constexpr int COINS_FLUSH_MAX_PASSES = 4;
+/**
+ * Time in seconds after which the incremental flush writes all the remaining
+ * coins at once, if it has not brought the coins database to the tip yet
+ */
+static constexpr int64_t COINS_FLUSH_MAX_TRANSITION_TIME = 10 * 60;
+/** Default for -utxocommitment */
+static constexpr bool DEFAULT_UTXO_COMMITMENT = false;
+/** Default for -schnorrbatchverify */
+static constexpr bool DEFAULT_SCHNORR_BATCH_VERIFY = false;
 /** Default for using fee filter */
 static constexpr bool DEFAULT_FEEFILTER = true;
 
@@ -200,6 +234,16 @@ extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
+extern bool fUtxoPrefetch;
+extern bool fTxPrecheck;
+extern bool fUtxoBackgroundFlush;
+extern bool fUtxoCommitment;
+extern bool fSchnorrBatchVerify;
+/**
+ * Number of block transactions whose script checks were set up ahead of time
+ * by the worker threads (see StartScriptCheckWorkerThreads)
+ */
+extern std::atomic<uint64_t> nBlockTxsPrecomputed;
 extern size_t nCoinCacheUsage;
 
 /**
@@ -365,11 +409,39 @@ bool LoadChainTip(const Config &config) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
  */
 void UnloadBlockIndex(const Config &config);
 
-/** Run instances of script checking worker threads */
-void StartScriptCheckWorkerThreads(int threads_num);
-/** Stop all of the script checking worker threads */
+/**
+ * Run instances of script checking worker threads, as well as the same number
+ * of threads preparing work for them: ahead of ConnectBlock, reading the block
+ * inputs missing from pcoinsTip from the coins database (see -utxoprefetch)
+ * and setting up the script checks of the block's transactions from the coins
+ * cached in its view or in pcoinsTip, and checking the scripts of transactions
+ * about to be accepted to the mempool (see -txprecheck). If work_stealing is
+ * set, the worker threads use per-thread deques of checks (see CCheckQueue).
+ */
+void StartScriptCheckWorkerThreads(
+    int threads_num, bool work_stealing = DEFAULT_SCRIPTCHECK_WORK_STEALING);
+/** Stop all of the script checking and coins prefetch worker threads */
 void StopScriptCheckWorkerThreads();
 
+/**
+ * Write a chunk of at most maxCoins of the coins modified in pcoinsTip to the
+ * coins database, without holding cs_main during the write. The coins
+ * database is left marked as being in transition to the tip of pcoinsTip
+ * until a pass over pcoinsTip finds the tip unchanged, or the tip kept moving
+ * for COINS_FLUSH_MAX_PASSES passes or COINS_FLUSH_MAX_TRANSITION_TIME
+ * seconds, as during the initial block download. The remaining coins are then
+ * written at once along with the new best block.
+ * Returns whether more coins are left to write.
+ */
+bool IncrementalCoinsFlushStep(size_t maxCoins);
+/**
+ * Run a thread continuously writing the modified coins of pcoinsTip to the
+ * coins database (see -utxobackgroundflush).
+ */
+void StartCoinsFlushThread();
+/** Stop the thread started by StartCoinsFlushThread, if any */
+void StopCoinsFlushThread();
+
 /**
  * Check whether we are doing an initial block download (synchronizing from disk
  * or network)
@@ -435,6 +507,23 @@ AcceptToMemoryPoolWithTime(const Config &config, CTxMemPool &pool,
                            bool test_accept = false)
     EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/**
+ * Check the scripts of transactions about to be passed to AcceptToMemoryPool
+ * one by one, in parallel on the script verification threads, so that
+ * AcceptToMemoryPool then finds the results in the script cache. Only the
+ * transactions AcceptToMemoryPool would get to the script checks of, given the
+ * current chain and mempool, are checked: the ones spending outputs of other
+ * transactions of the batch, or coins already spent in the mempool or by an
+ * earlier transaction of the batch, are left to it. AcceptToMemoryPool still
+ * makes all of its checks, only faster.
+ *
+ * Returns the number of transactions whose scripts were checked.
+ */
+size_t PrecheckTransactionsForMempool(const Config &config,
+                                      const CTxMemPool &pool,
+                                      const std::vector<CTransactionRef> &txs)
+    LOCKS_EXCLUDED(cs_main);
+
 /** Convert CValidationState to a human-readable message for logging */
 std::string FormatStateMessage(const CValidationState &state);
 
@@ -455,6 +544,8 @@ public:
     }
 
     bool check() { return remaining >= 0; }
+
+    int64_t get_remaining() const { return remaining; }
 };
 
 class TxSigCheckLimiter : public CheckInputsLimiter {
@@ -504,6 +595,10 @@ public:
  * break the limit in which case false is returned, OR, each entry in the
  * returned pvChecks must be executed exactly once in order to probe the limit
  * accurately.
+ *
+ * pPrecomputedContexts can be passed if the script execution contexts of all
+ * inputs were already created from the coins in view (see ConnectBlock), in
+ * which case they are used instead of being created again.
  */
 bool CheckInputs(const CTransaction &tx, CValidationState &state,
                  const CCoinsViewCache &view, bool fScriptChecks,
@@ -511,7 +606,8 @@ bool CheckInputs(const CTransaction &tx, CValidationState &state,
                  PrecomputedTransactionData &txdata /* in/out param */, int &nSigChecksOut,
                  TxSigCheckLimiter &txLimitSigChecks,
                  CheckInputsLimiter *pBlockLimitSigChecks,
-                 std::vector<CScriptCheck> *pvChecks)
+                 std::vector<CScriptCheck> *pvChecks,
+                 const std::vector<ScriptExecutionContext> *pPrecomputedContexts = nullptr)
     EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
 /**
@@ -569,6 +665,11 @@ bool CheckSequenceLocks(const CTxMemPool &pool, const CTransaction &tx,
  *
  * Note that if pLimitSigChecks is passed, then failure does not imply that
  * scripts have failed.
+ *
+ * If batchSchnorr is set (only valid with SCRIPT_VERIFY_NULLFAIL), Schnorr
+ * signatures are not verified right away but added to a batch owned by the
+ * current thread. The batch must then be verified with
+ * FinishScriptCheckBatch() on the same thread for the result to be final.
  */
 class CScriptCheck {
     /* Note: For maximum performance, please be sure that all the below types are efficiently move-constructible and
@@ -581,6 +682,7 @@ class CScriptCheck {
     PrecomputedTransactionData txdata{};
     TxSigCheckLimiter *pTxLimitSigChecks{};
     CheckInputsLimiter *pBlockLimitSigChecks{};
+    bool batchSchnorr{};
 
 public:
     CScriptCheck() = default;
@@ -589,11 +691,13 @@ public:
                  uint32_t nFlagsIn, bool cacheIn,
                  const PrecomputedTransactionData &txdataIn,
                  TxSigCheckLimiter *pTxLimitSigChecksIn = nullptr,
-                 CheckInputsLimiter *pBlockLimitSigChecksIn = nullptr)
+                 CheckInputsLimiter *pBlockLimitSigChecksIn = nullptr,
+                 bool batchSchnorrIn = false)
         : context(contextIn), nFlags(nFlagsIn), cacheStore(cacheIn),
           error(ScriptError::UNKNOWN), txdata(txdataIn),
           pTxLimitSigChecks(pTxLimitSigChecksIn),
-          pBlockLimitSigChecks(pBlockLimitSigChecksIn) {}
+          pBlockLimitSigChecks(pBlockLimitSigChecksIn),
+          batchSchnorr(batchSchnorrIn) {}
 
     bool operator()();
 
@@ -602,6 +706,13 @@ public:
     ScriptExecutionMetrics GetScriptExecutionMetrics() const { return metrics; }
 };
 
+/**
+ * Verify the Schnorr signatures deferred by the CScriptChecks run on the
+ * current thread, given whether these checks succeeded otherwise. Returns
+ * whether all of the checks succeeded.
+ */
+bool FinishScriptCheckBatch(bool fChecksOk);
+
 /** Functions for validating blocks and updating the block tree */
 
 /**
@@ -633,13 +744,37 @@ bool ContextualCheckTransactionForCurrentBlock(const Consensus::Params &params,
                                                CValidationState &state,
                                                int flags = -1);
 
+/**
+ * What TestBlockValidity() keeps from checking a block template to check the
+ * next ones on the same tip faster, as the miner does for every template it
+ * makes. The transactions of the last template checked spend the same coins
+ * in the next one, so their scripts and sequence locks are not checked again;
+ * only the new transactions are checked in full, and the block as a whole
+ * (double spends, fees, sigchecks, size, ordering) as before. The coins of the
+ * tip read by the checks are kept too.
+ */
+struct BlockTemplateValidityCache {
+    //! The tip the cache is for
+    BlockHash hashPrevBlock;
+    //! The view of the tip the coins were read from
+    const CCoinsView *pcoinsBase = nullptr;
+    //! Coins of the tip read by the checks
+    std::unique_ptr<CCoinsViewCache> view;
+    //! Transactions of the last template checked, with their sigchecks
+    std::unordered_map<TxId, int64_t, SaltedTxIdHasher> checkedTxs;
+    //! Number of transactions checked in full by the last check
+    size_t nLastNewTxs = 0;
+};
+
 /**
  * Check a block is completely valid from start to finish (only works on top of
- * our current best block)
+ * our current best block). Checks of block templates may pass a
+ * `templateCache`, kept from one check to the next.
  */
 bool TestBlockValidity(CValidationState &state, const CChainParams &params,
                        const CBlock &block, CBlockIndex *pindexPrev,
-                       BlockValidationOptions validationOptions)
+                       BlockValidationOptions validationOptions,
+                       BlockTemplateValidityCache *templateCache = nullptr)
     EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
 /**
@@ -657,6 +792,29 @@ public:
 /** Replay blocks that aren't fully applied to the database. */
 bool ReplayBlocks(const Consensus::Params &params, CCoinsView *view);
 
+/**
+ * Load the coins of a UTXO snapshot (see dumptxoutset) into the empty coins
+ * database of a pruned node, and make the base block of the snapshot, whose
+ * header must be known, the tip of the active chain. The blocks below it are
+ * considered valid without being downloaded. The snapshot is rejected if its
+ * coins do not match the hash in au_data.
+ * cs_main is not held while the coins are written, and blocks received in the
+ * meantime are only connected afterwards. If the node stops before the load
+ * completes, ReplayBlocks erases the coins written at the next start.
+ */
+bool LoadUTXOSnapshot(const Config &config, CAutoFile &coins_file,
+                      const SnapshotMetadata &metadata,
+                      const AssumeutxoData &au_data, CValidationState &state)
+    LOCKS_EXCLUDED(cs_main);
+
+/**
+ * Record the commitment to the UTXO set after connecting the block `hash`,
+ * computed by walking the coins database, so that -utxocommitment maintains it
+ * from there on.
+ */
+void SetUTXOCommitment(const BlockHash &hash, const UTXOCommitment &commitment)
+    LOCKS_EXCLUDED(cs_main);
+
 /** Find the last common block between the parameter chain and a locator. */
 CBlockIndex *FindForkInGlobalIndex(const CChain &chain,
                                    const CBlockLocator &locator)
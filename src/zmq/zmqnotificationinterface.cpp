@@ -44,6 +44,8 @@ CZMQNotificationInterface *CZMQNotificationInterface::Create() {
         CZMQAbstractNotifier::Create<CZMQPublishHashDoubleSpendNotifier>;
     factories["pubrawds"] =
         CZMQAbstractNotifier::Create<CZMQPublishRawDoubleSpendNotifier>;
+    factories["pubblocktemplate"] =
+        CZMQAbstractNotifier::Create<CZMQPublishBlockTemplateNotifier>;
 
     std::list<std::unique_ptr<CZMQAbstractNotifier>> notifiers;
     for (const auto &entry : factories) {
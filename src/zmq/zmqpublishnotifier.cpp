@@ -9,8 +9,10 @@
 #include <node/blockstorage.h>
 #include <primitives/blockhash.h>
 #include <primitives/txid.h>
+#include <rpc/mining.h>
 #include <streams.h>
 #include <util/system.h>
+#include <util/time.h>
 #include <validation.h>
 #include <zmq/zmqpublishnotifier.h>
 #include <zmq/zmqutil.h>
@@ -23,6 +25,7 @@
 #include <map>
 #include <string>
 #include <utility>
+#include <vector>
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier *>
     mapPublishNotifiers;
@@ -33,6 +36,7 @@ inline constexpr auto MSG_RAWBLOCK = "rawblock";
 inline constexpr auto MSG_RAWTX = "rawtx";
 inline constexpr auto MSG_HASHDS = "hashds";
 inline constexpr auto MSG_RAWDS = "rawds";
+inline constexpr auto MSG_BLOCKTEMPLATE = "blocktemplate";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void *data, size_t size, ...) {
@@ -182,7 +186,7 @@ bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex) {
              pindex->GetBlockHash().GetHex());
 
     const Config &config = GetConfig();
-    std::vector<uint8_t> rawBlock;
+    RawBlock rawBlock;
     {
         LOCK(cs_main);
         if (!ReadRawBlockFromDisk(rawBlock, pindex,
@@ -191,7 +195,7 @@ bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex) {
             return false;
         }
     }
-    return SendZmqMessage(MSG_RAWBLOCK, rawBlock.data(), rawBlock.size());
+    return SendZmqMessage(MSG_RAWBLOCK, rawBlock.data().data(), rawBlock.size());
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(
@@ -217,3 +221,49 @@ bool CZMQPublishRawDoubleSpendNotifier::NotifyDoubleSpend(const CTransaction &tr
     ss << transaction;
     return SendZmqMessage(MSG_RAWDS, &*ss.begin(), ss.size());
 }
+
+bool CZMQPublishBlockTemplateNotifier::Publish() {
+    gbtl::LightTemplate tmpl;
+    try {
+        tmpl = gbtl::GetLightTemplate(GetConfig());
+    } catch (const UniValue &objError) {
+        // E.g. during the initial block download: there is no template to publish yet.
+        LogPrint(BCLog::ZMQ, "zmq: No blocktemplate to publish: %s\n", objError["message"].getValStr());
+        return true;
+    } catch (const std::exception &e) {
+        LogPrint(BCLog::ZMQ, "zmq: No blocktemplate to publish: %s\n", e.what());
+        return true;
+    }
+
+    const Amount nFeeDelta =
+        gArgs.GetArg("-zmqpubblocktemplatefeedelta", DEFAULT_ZMQ_BLOCKTEMPLATE_FEE_DELTA) * SATOSHI;
+    if (tmpl.hashPrevBlock == hashLastPrevBlock &&
+        tmpl.coinbaseValue < nLastCoinbaseValue + nFeeDelta) {
+        return true;
+    }
+    hashLastPrevBlock = tmpl.hashPrevBlock;
+    nLastCoinbaseValue = tmpl.coinbaseValue;
+
+    LogPrint(BCLog::ZMQ, "zmq: Publish blocktemplate %s on %s\n", tmpl.jobId.GetHex(),
+             tmpl.hashPrevBlock.GetHex());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << tmpl.jobId << tmpl.hashPrevBlock << tmpl.nHeight << tmpl.nVersion << tmpl.nBits << tmpl.nTime
+       << tmpl.coinbaseValue << tmpl.merkle;
+    return SendZmqMessage(MSG_BLOCKTEMPLATE, &*ss.begin(), ss.size());
+}
+
+bool CZMQPublishBlockTemplateNotifier::NotifyBlock(const CBlockIndex *) {
+    nLastCheckMicros = GetTimeMicros();
+    return Publish();
+}
+
+bool CZMQPublishBlockTemplateNotifier::NotifyTransaction(const CTransaction &) {
+    const int64_t nNow = GetTimeMicros();
+    const int64_t nInterval =
+        gArgs.GetArg("-zmqpubblocktemplateinterval", DEFAULT_ZMQ_BLOCKTEMPLATE_INTERVAL) * 1000;
+    if (nNow - nLastCheckMicros < nInterval) {
+        return true;
+    }
+    nLastCheckMicros = nNow;
+    return Publish();
+}
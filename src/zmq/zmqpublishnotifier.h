@@ -5,10 +5,19 @@
 
 #pragma once
 
+#include <amount.h>
+#include <primitives/blockhash.h>
 #include <zmq/zmqabstractnotifier.h>
 
+#include <cstdint>
+
 class CBlockIndex;
 
+/** Default for -zmqpubblocktemplatefeedelta, in satoshis */
+static constexpr int64_t DEFAULT_ZMQ_BLOCKTEMPLATE_FEE_DELTA = 1000;
+/** Default for -zmqpubblocktemplateinterval, in milliseconds */
+static constexpr int64_t DEFAULT_ZMQ_BLOCKTEMPLATE_INTERVAL = 100;
+
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier {
 private:
     //! upcounting per message sequence number
@@ -57,3 +66,25 @@ class CZMQPublishRawDoubleSpendNotifier : public CZMQAbstractPublishNotifier {
 public:
     bool NotifyDoubleSpend(const CTransaction &transaction) override;
 };
+
+/**
+ * Publishes the light block template of getblocktemplatelight, in short, on
+ * each new tip, and again whenever the fees it collects grew by at least
+ * -zmqpubblocktemplatefeedelta since it was last published for the tip. The mempool is
+ * looked at for this at most every -zmqpubblocktemplateinterval milliseconds,
+ * as transactions come in. The job of each template published is kept for
+ * submitblocklight like those returned by getblocktemplatelight.
+ */
+class CZMQPublishBlockTemplateNotifier : public CZMQAbstractPublishNotifier {
+    //! The tip and coinbase value of the last template published
+    BlockHash hashLastPrevBlock;
+    Amount nLastCoinbaseValue = Amount::zero();
+    //! When the mempool was last looked at
+    int64_t nLastCheckMicros = 0;
+
+    bool Publish();
+
+public:
+    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyTransaction(const CTransaction &transaction) override;
+};
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+# Copyright (c) 2026 The Bitcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test loading a UTXO snapshot with loadtxoutset.
+
+node0 mines a chain up to the height for which regtest knows the UTXO set
+hash, with fixed block times so that the chain is always the same, and dumps
+its UTXO set with dumptxoutset. node1, pruned, only gets the headers, loads
+the snapshot and then syncs the blocks after it from node0.
+"""
+import os
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    connect_nodes,
+    set_node_times,
+)
+
+# The height of the regtest UTXO set hash in CRegTestParams
+SNAPSHOT_BASE_HEIGHT = 110
+# 2014-01-01, like the cached chains
+START_TIME = 1388534400
+
+
+class AssumeutxoTest(BitcoinTestFramework):
+
+    def set_test_params(self):
+        self.num_nodes = 2
+        self.setup_clean_chain = True
+        self.extra_args = [[], ['-prune=1']]
+
+    def setup_network(self):
+        # node1 must not get the blocks before the snapshot is loaded.
+        self.setup_nodes()
+
+    def run_test(self):
+        node0, node1 = self.nodes
+        address = node0.get_deterministic_priv_key().address
+
+        self.log.info("Mine the chain up to the snapshot height")
+        block_time = START_TIME
+        for _ in range(SNAPSHOT_BASE_HEIGHT):
+            set_node_times(self.nodes, block_time)
+            self.generatetoaddress(node0, 1, address)
+            block_time += 10 * 60
+
+        self.log.info("Dump the UTXO set")
+        dump = node0.dumptxoutset('utxo.dat')
+        assert_equal(dump['base_height'], SNAPSHOT_BASE_HEIGHT)
+        assert_equal(dump['base_hash'], node0.getbestblockhash())
+        assert_equal(dump['coins_written'], SNAPSHOT_BASE_HEIGHT)
+        assert_equal(
+            dump['txoutset_hash'],
+            node0.gettxoutsetinfo('ecmultiset')['ecmultiset_hash'])
+        path = dump['path']
+        assert os.path.exists(path)
+
+        self.log.info("Give node1 the headers only")
+        assert_raises_rpc_error(
+            -5, "is not known yet", node1.loadtxoutset, path)
+        for height in range(1, SNAPSHOT_BASE_HEIGHT + 1):
+            blockhash = node0.getblockhash(height)
+            node1.submitheader(node0.getblockheader(blockhash, False))
+        assert_equal(node1.getblockcount(), 0)
+
+        self.log.info("Load the snapshot")
+        loaded = node1.loadtxoutset(path)
+        assert_equal(loaded['coins_loaded'], dump['coins_written'])
+        assert_equal(loaded['base_hash'], dump['base_hash'])
+        assert_equal(loaded['base_height'], SNAPSHOT_BASE_HEIGHT)
+        assert_equal(node1.getbestblockhash(), dump['base_hash'])
+        assert_equal(
+            node1.gettxoutsetinfo('ecmultiset')['ecmultiset_hash'],
+            dump['txoutset_hash'])
+        assert_raises_rpc_error(
+            -1, "no blocks after the genesis block", node1.loadtxoutset, path)
+
+        self.log.info("Sync the blocks after the snapshot")
+        set_node_times(self.nodes, block_time)
+        self.generatetoaddress(node0, 10, address)
+        connect_nodes(node0, node1)
+        self.sync_blocks()
+        assert_equal(node1.getblockcount(), SNAPSHOT_BASE_HEIGHT + 10)
+        assert_equal(node1.gettxoutsetinfo()['hash_serialized'],
+                     node0.gettxoutsetinfo()['hash_serialized'])
+
+        self.log.info("The snapshot survives a restart")
+        self.restart_node(1, ['-prune=1'])
+        assert_equal(node1.getblockcount(), SNAPSHOT_BASE_HEIGHT + 10)
+
+
+if __name__ == '__main__':
+    AssumeutxoTest().main()
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+# Copyright (c) 2026 The Bitcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the blocktemplate ZMQ notification.
+
+It publishes the light block template in short on each new tip, and again
+when the fees of the template grew by -zmqpubblocktemplatefeedelta.
+"""
+import struct
+from io import BytesIO
+
+from test_framework.messages import deser_uint256, deser_uint256_vector
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_greater_than
+
+ADDRESS = "tcp://127.0.0.1:28333"
+
+
+def parse_template(body):
+    f = BytesIO(body)
+    job_id = f.read(20)[::-1].hex()
+    prevhash = "{:064x}".format(deser_uint256(f))
+    height, version, bits, curtime, coinbasevalue = struct.unpack(
+        "<iiIqq", f.read(28))
+    merkle = ["{:064x}".format(h) for h in deser_uint256_vector(f)]
+    assert_equal(f.read(), b"")
+    return {
+        "job_id": job_id,
+        "previousblockhash": prevhash,
+        "height": height,
+        "version": version,
+        "bits": "{:08x}".format(bits),
+        "curtime": curtime,
+        "coinbasevalue": coinbasevalue,
+        "merkle": merkle,
+    }
+
+
+class ZMQBlockTemplateTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_py3_zmq()
+        self.skip_if_no_bitcoind_zmq()
+        self.skip_if_no_wallet()
+
+    def setup_nodes(self):
+        import zmq
+
+        self.zmq_context = zmq.Context()
+        self.socket = self.zmq_context.socket(zmq.SUB)
+        self.socket.set(zmq.RCVTIMEO, 60000)
+        self.socket.connect(ADDRESS)
+        self.socket.setsockopt(zmq.SUBSCRIBE, b"blocktemplate")
+        self.sequence = 0
+
+        self.extra_args = [[
+            "-zmqpubblocktemplate={}".format(ADDRESS),
+            "-zmqpubblocktemplatefeedelta=1",
+            "-zmqpubblocktemplateinterval=0",
+            "-allowunconnectedmining=1",
+        ]]
+        self.add_nodes(self.num_nodes, self.extra_args)
+        self.start_nodes()
+
+    def receive(self):
+        topic, body, seq = self.socket.recv_multipart()
+        assert_equal(topic, b"blocktemplate")
+        assert_equal(struct.unpack('<I', seq)[-1], self.sequence)
+        self.sequence += 1
+        return parse_template(body)
+
+    def run_test(self):
+        try:
+            self._zmq_test()
+        finally:
+            self.log.debug("Destroying ZMQ context")
+            self.zmq_context.destroy(linger=None)
+
+    def check_template(self, tmpl):
+        node = self.nodes[0]
+        gbt = node.getblocktemplatelight()
+        for key in ("job_id", "previousblockhash", "height", "version",
+                    "bits", "coinbasevalue", "merkle"):
+            assert_equal(tmpl[key], gbt[key])
+
+    def _zmq_test(self):
+        node = self.nodes[0]
+
+        self.log.info("A template is published on a new tip")
+        blockhash = self.generate(node, 1)[0]
+        tmpl = self.receive()
+        assert_equal(tmpl["previousblockhash"], blockhash)
+        assert_equal(tmpl["height"], node.getblockcount() + 1)
+        assert_equal(tmpl["merkle"], [])
+        self.check_template(tmpl)
+
+        self.log.info("A template is published when its fees grew")
+        coinbasevalue = tmpl["coinbasevalue"]
+        txid = node.sendtoaddress(node.getnewaddress(), 1.0)
+        tmpl = self.receive()
+        assert_equal(tmpl["previousblockhash"], blockhash)
+        assert_greater_than(tmpl["coinbasevalue"], coinbasevalue)
+        assert_equal(tmpl["merkle"], [txid])
+        self.check_template(tmpl)
+
+        self.log.info("The template of the next tip has none of them")
+        assert_equal(node.getrawmempool(), [txid])
+        blockhash = self.generate(node, 1)[0]
+        assert_equal(node.getrawmempool(), [])
+        tmpl = self.receive()
+        assert_equal(tmpl["previousblockhash"], blockhash)
+        assert_equal(tmpl["merkle"], [])
+
+
+if __name__ == '__main__':
+    ZMQBlockTemplateTest().main()